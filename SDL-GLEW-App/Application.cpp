@@ -13,7 +13,7 @@
 namespace Fox {
     
     GLfloat Time::deltaTime = 0;
-    
+
 /**
  * Quits this application
  */
@@ -24,6 +24,8 @@ namespace Fox {
     void Application::startApplication(){
         
         Uint32 time = 0;
+        Uint32 statisticsTime = SDL_GetTicks();
+        GLuint frames = 0;
         
         // update until the application is closed
         while (!m_Quit)
@@ -31,12 +33,24 @@ namespace Fox {
             
             Time::deltaTime = 0.001f*(SDL_GetTicks() - time);
             time = SDL_GetTicks();
-        
+            
             // handle input
             m_InputManager->handleInput(this);
             
+            // upload textures decoded in the background
+            TextureManager::Instance()->update();
+            
             // draw the entire scene
             drawScene();
+            frames++;
+            
+            // counters of the latest frame, once in a while since GPU counts are read back
+            if(SDL_GetTicks() - statisticsTime >= STATISTICS_INTERVAL){
+                printFrameStatistics(frames * 1000.0f / (SDL_GetTicks() - statisticsTime));
+                statisticsTime = SDL_GetTicks();
+                frames = 0;
+            }
+            
             // swap buffers
             m_glContext->swapBuffers();
             
@@ -47,13 +61,40 @@ namespace Fox {
         
     }
     
+    void Application::printFrameStatistics(GLfloat framesPerSecond){
+        
+        const RenderQueue::Statistics& queue = m_RenderQueue.getStatistics();
+        const GLContext::StateStatistics& state = m_glContext->getStateStatistics();
+        OcclusionCuller::Statistics occlusion = getOcclusionStatistics();
+        
+        std::cout << framesPerSecond << " fps, " << queue.m_DrawCalls << " draw calls, " << queue.m_ShaderChanges << " shader changes, "
+                  << state.m_Issued << " state changes issued, " << state.m_Suppressed << " suppressed, "
+                  << occlusion.m_Visible << " trees visible, " << occlusion.m_Occluded << " occluded by the terrain" << std::endl;
+    }
+    
     void Application::drawScene(){
         // clear the screen at first
         clearScreen();
         
+        // texture uploads and constructors bind objects behind the state cache
+        m_glContext->invalidateState();
+        
+        // state change counters are per frame
+        m_RenderQueue.resetStatistics();
+        m_OcclusionCuller.resetStatistics();
+        m_glContext->resetStateStatistics();
+        
+        if(m_glContext->supportsIndirectDraw()){
+            m_SphereCuller.resetStatistics();
+            m_CylinderCuller.resetStatistics();
+        }
+        
         // draw all render contexts
         for(int i = 0; i < m_glContext->getNumberOfRenderContexts(); i++) {
             
+            // per frame data shared by all shaders, uploaded once per render context
+            updateFrameUniforms();
+            
             // draw the scene to depth buffer
          /*   m_ShadowMap->renderToDepthBuffer(m_glContext);
             renderSceneToDepthBuffer();
@@ -61,12 +102,12 @@ namespace Fox {
             m_ShadowMap->switchToBackBuffer();
             
             // Reset viewport
-            glViewport(0, 0, m_ScreenWidth, m_ScreenHeight);
+            m_glContext->viewport(0, 0, m_ScreenWidth, m_ScreenHeight);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             m_ShadowMap->visualizeDepthBuffer(m_glContext);*/
             
             renderScene();
-
+            
             m_glContext->nextRenderContext();
         }
         
@@ -77,37 +118,39 @@ namespace Fox {
     void Application::renderSceneToDepthBuffer(){
         
         glEnable(GL_DEPTH_TEST);
-
-        
+     
+     
      /*   std::vector<glm::vec3> positions;
         positions.push_back(glm::vec3(0.0f, 1.5f, 0.0));
         positions.push_back(glm::vec3(2.0f, 0.0f, 1.0));
         positions.push_back(glm::vec3(-1.0f, 0.0f, 2.0));*/
         
-        // DRAW TREES
-        m_Cylinder.drawToDepthBuffer(m_glContext, m_CylinderPositions);
-        m_Sphere.drawToDepthBuffer(m_glContext, m_SpherePositions);
+        // depth only pass, front to back from the light
+        m_RenderQueue.begin(RenderQueue::SORT_FRONT_TO_BACK, m_ShadowMap->getLightSpaceMatrix());
         
-        glm::mat4 model;
-        model = glm::mat4();
-        m_glContext->setMatrix4fUniform(model, "model");
-        // DRAW GROUND
-        m_Plane.drawToDepthBuffer(m_glContext);
+        // DRAW TREES culled against the light frustum with the instanced depth shader
+        submitTrees(m_ShadowMap->getFrustum(), m_Lighting.getShader(m_glContext, ShaderVariants::DEPTH_ONLY | ShaderVariants::INSTANCED));
+        
+        // DRAW GROUND with the terrain depth shader
+        GLuint terrainDepth = m_Lighting.getShader(m_glContext, ShaderVariants::DEPTH_ONLY | ShaderVariants::TERRAIN);
+        m_Terrain.submit(m_RenderQueue, terrainDepth, m_glContext->getCurrentRenderContext().m_Camera.m_Position, &m_ShadowMap->getFrustum());
+        
+        m_RenderQueue.execute(m_glContext);
         
         // Cubes
     /*    model = glm::mat4();
         model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
-        m_glContext->setMatrix4fUniform(model, "model");
+        m_glContext->setMatrix4fUniform(model, UNIFORM_MODEL);
         m_Cube.drawToDepthBuffer(m_glContext);
         model = glm::mat4();
         model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
-        m_glContext->setMatrix4fUniform(model, "model");
+        m_glContext->setMatrix4fUniform(model, UNIFORM_MODEL);
         m_Cube.drawToDepthBuffer(m_glContext);
         model = glm::mat4();
         model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
         model = glm::rotate(model, 60.0f, glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
        // model = glm::scale(model, glm::vec3(0.5));
-        m_glContext->setMatrix4fUniform(model, "model");
+        m_glContext->setMatrix4fUniform(model, UNIFORM_MODEL);
         m_Cube.drawToDepthBuffer(m_glContext);
       */
         
@@ -118,128 +161,142 @@ namespace Fox {
         /*
         glm::mat4 model;
         model = glm::mat4();
-        m_glContext->setMatrix4fUniform(model, "model");
+        m_glContext->setMatrix4fUniform(model, UNIFORM_MODEL);
         // DRAW GROUND
-        m_Plane.drawToDepthBuffer(m_glContext);*/
-        
+        m_Terrain.drawToDepthBuffer(m_glContext);*/
+      
       //  model = glm::mat4();
       //  model = glm::rotate(model, (GLfloat)SDL_GetTicks()* 0.00001f * 50.0f, glm::vec3(0.0f, 1.0f, 0.0f));
       //  model = glm::scale(model, glm::vec3(5.0f, 5.0f, 5.0f));
-      //  m_glContext->setMatrix4fUniform(model, "model");
+      //  m_glContext->setMatrix4fUniform(model, UNIFORM_MODEL);
      //   m_Nano.draw(m_glContext);
-    
+        
     }
     
-    void Application::renderScene(){
-    
-        m_glContext->setViewPort();
+    void Application::submitTrees(const Frustum& frustum, GLuint shader, bool occlusion){
         
-        glEnable(GL_DEPTH_TEST);
+        if(m_glContext->supportsIndirectDraw()){
+            
+            // the visible instances stay on the GPU, the CPU cost does not grow with the trees
+            const OcclusionCuller* occluders = occlusion ? &m_OcclusionCuller : nullptr;
+            m_SphereCuller.cull(m_glContext, frustum, occluders, m_OcclusionDepth);
+            m_CylinderCuller.cull(m_glContext, frustum, occluders, m_OcclusionDepth);
+            
+            m_Sphere.submit(m_RenderQueue, shader, m_SphereCuller);
+            m_Cylinder.submit(m_RenderQueue, shader, m_CylinderCuller);
+            return;
+        }
         
-        // use lighting shader (diffuse specular)
-        m_glContext->useShader(3);
+        m_SphereTree.cull(frustum, m_VisibleSpheres);
+        m_CylinderTree.cull(frustum, m_VisibleCylinders);
         
-        m_glContext->setCameraPosition("viewPos");
+        // trees in the frustum can still be behind hills, shadow casters are kept
+        if(occlusion){
+            m_OcclusionCuller.cull(m_SpherePositions, m_Sphere.m_BoundingSphere, m_VisibleSpheres);
+            m_OcclusionCuller.cull(m_CylinderPositions, m_Cylinder.m_BoundingSphere, m_VisibleCylinders);
+        }
         
-        // define directional light
-        m_glContext->setVec3(glm::vec3(0.0f, 0.0f, 0.05f), "dirLight.ambient");
-        m_glContext->setVec3(glm::vec3(1.0f, 0.95f, 0.65f), "dirLight.diffuse");
-        m_glContext->setVec3(glm::vec3(1.0f, 1.0f, 1.0f), "dirLight.specular");
-        //  m_glContext->setVec3(m_glContext->getCurrentRenderContext().m_Camera.m_Front, "dirLight.direction");
-        m_glContext->setVec3(glm::vec3(2.0f, -3.0f, 3.0f), "dirLight.direction");
-        //  m_glContext->setVec3(glm::vec3(1.0f, -1.0f, -10.0f), "dirLight.direction");
+        m_Sphere.submit(m_glContext, m_RenderQueue, shader, m_SpherePositions, m_VisibleSpheres);
+        m_Cylinder.submit(m_glContext, m_RenderQueue, shader, m_CylinderPositions, m_VisibleCylinders);
+    }
+    
+    void Application::updateFrameUniforms(){
         
+        RenderContext& rc = m_glContext->getCurrentRenderContext();
         
-        // define spot light
-        m_glContext->setVec3(glm::vec3(0.2f, 0.2f, 0.2f), "spotLight.ambient");
-        m_glContext->setVec3(glm::vec3(0.5f, 0.5f, 0.5f), "spotLight.diffuse");
-        m_glContext->setVec3(glm::vec3(1.0f, 1.0f, 1.0f), "spotLight.specular");
+        // camera and shadow data
+        m_ShadowMap->updateLightSpaceMatrix(m_glContext);
+        m_glContext->updateFrameUniforms(m_ShadowMap->getLightSpaceMatrix());
         
-        m_glContext->setFloat(1.0f, "spotLight.constant");
-        m_glContext->setFloat(0.09f, "spotLight.linear");
-        m_glContext->setFloat(0.032f, "spotLight.quadratic");
+        LightUniforms lights = LightUniforms();
         
-        m_glContext->setFloat(glm::cos(glm::radians(12.5f)), "spotLight.cutOff");
-        m_glContext->setFloat(glm::cos(glm::radians(17.5f)), "spotLight.outerCutOff");
+        // define directional light
+        lights.m_DirLight.m_Ambient = glm::vec3(0.0f, 0.0f, 0.05f);
+        lights.m_DirLight.m_Diffuse = glm::vec3(1.0f, 0.95f, 0.65f);
+        lights.m_DirLight.m_Specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        //  lights.m_DirLight.m_Direction = rc.m_Camera.m_Front;
+        lights.m_DirLight.m_Direction = glm::vec3(2.0f, -3.0f, 3.0f);
+        //  lights.m_DirLight.m_Direction = glm::vec3(1.0f, -1.0f, -10.0f);
         
-        m_glContext->setVec3(m_glContext->getCurrentRenderContext().m_Camera.m_Position, "spotLight.position");
-        m_glContext->setVec3(m_glContext->getCurrentRenderContext().m_Camera.m_Front, "spotLight.direction");
         
-        m_glContext->setViewUniform("view");
-        m_glContext->setProjectionUniform("projection");
+        // define spot light
+        lights.m_SpotLight.m_Ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+        lights.m_SpotLight.m_Diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+        lights.m_SpotLight.m_Specular = glm::vec3(1.0f, 1.0f, 1.0f);
         
-        // DRAW TREES
-        m_Sphere.draw(m_glContext, m_SpherePositions.size(), m_SpherePositions);
-        m_Cylinder.draw(m_glContext, m_CylinderPositions.size(), m_CylinderPositions);
+        lights.m_SpotLight.m_Constant = 1.0f;
+        lights.m_SpotLight.m_Linear = 0.09f;
+        lights.m_SpotLight.m_Quadratic = 0.032f;
         
-        glm::mat4 model;
+        lights.m_SpotLight.m_CutOff = glm::cos(glm::radians(12.5f));
+        lights.m_SpotLight.m_OuterCutOff = glm::cos(glm::radians(17.5f));
         
-        model = glm::mat4();
-        m_glContext->setMatrix4fUniform(model, "model");
+        lights.m_SpotLight.m_Position = rc.m_Camera.m_Position;
+        lights.m_SpotLight.m_Direction = rc.m_Camera.m_Front;
         
-        // DRAW GROUND
-        m_Plane.draw(m_glContext);
-        //  m_Plane.drawWireframe(m_glContext);
+        m_glContext->updateLightUniforms(lights);
+    }
+    
+    void Application::renderScene(){
         
-        // use lighting shader (bumped diffuse specular)
-        m_glContext->useShader(0);
+        m_glContext->setViewPort();
         
-        m_glContext->setCameraPosition("viewPos");
+        glEnable(GL_DEPTH_TEST);
         
-        // define directional light
-        m_glContext->setVec3(glm::vec3(0.0f, 0.0f, 0.05f), "dirLight.ambient");
-        m_glContext->setVec3(glm::vec3(1.0f, 0.95f, 0.65f), "dirLight.diffuse");
-        m_glContext->setVec3(glm::vec3(1.0f, 1.0f, 1.0f), "dirLight.specular");
-        m_glContext->setVec3(glm::vec3(2.0f, -3.0f, 3.0f), "dirLight.direction");
+        // view frustum and terrain depth of this frame for culling
+        RenderContext& rc = m_glContext->getCurrentRenderContext();
+        rc.updateFrustum();
         
+        m_OcclusionCuller.render(rc.m_Projection * rc.m_Camera.view());
         
-        // define spot light
-        m_glContext->setVec3(glm::vec3(0.2f, 0.2f, 0.2f), "spotLight.ambient");
-        m_glContext->setVec3(glm::vec3(0.5f, 0.5f, 0.5f), "spotLight.diffuse");
-        m_glContext->setVec3(glm::vec3(1.0f, 1.0f, 1.0f), "spotLight.specular");
+        // the compute shader reads the depth from a texture
+        if(m_glContext->supportsIndirectDraw())
+            InstanceCuller::uploadDepth(m_glContext, m_OcclusionDepth, m_OcclusionCuller);
         
-        m_glContext->setFloat(1.0f, "spotLight.constant");
-        m_glContext->setFloat(0.09f, "spotLight.linear");
-        m_glContext->setFloat(0.032f, "spotLight.quadratic");
+        // opaque pass sorted by state
+        m_RenderQueue.begin(RenderQueue::SORT_BY_STATE, rc.m_Projection * rc.m_Camera.view());
         
-        m_glContext->setFloat(glm::cos(glm::radians(12.5f)), "spotLight.cutOff");
-        m_glContext->setFloat(glm::cos(glm::radians(17.5f)), "spotLight.outerCutOff");
+        // shadows are sampled from the depth map of this frame
+        if(m_SceneFeatures & ShaderVariants::SHADOWS)
+            m_glContext->bindTexture2D(SHADOW_MAP_UNIT, m_ShadowMap->getDepthMap());
         
-        m_glContext->setVec3(m_glContext->getCurrentRenderContext().m_Camera.m_Position, "spotLight.position");
-        m_glContext->setVec3(m_glContext->getCurrentRenderContext().m_Camera.m_Front, "spotLight.direction");
+        // DRAW TREES with the instanced lighting shader, spheres and cylinders share one vertex format
+        submitTrees(rc.m_Frustum, m_Lighting.getShader(m_glContext, m_SceneFeatures | ShaderVariants::INSTANCED | m_Sphere.getFeatures()), true);
         
-        m_glContext->setViewUniform("view");
-        m_glContext->setProjectionUniform("projection");
+        // DRAW GROUND with the terrain lighting shader (diffuse specular)
+        m_Terrain.submit(m_RenderQueue, m_Lighting.getShader(m_glContext, m_SceneFeatures | ShaderVariants::TERRAIN), rc.m_Camera.m_Position, &rc.m_Frustum);
         
-        model = glm::mat4();
+        // lighting shader, normal mapped where the mesh has tangents and a normal map
+        glm::mat4 model;
         model = glm::rotate(model, (GLfloat)SDL_GetTicks()* 0.00001f * 50.0f, glm::vec3(0.0f, 1.0f, 0.0f));
         // model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f));
         model = glm::scale(model, glm::vec3(5.0f, 5.0f, 5.0f));
-        m_glContext->setMatrix4fUniform(model, "model");
-        m_Nano.draw(m_glContext);
+        m_Nano.submit(m_glContext, m_RenderQueue, m_Lighting, m_SceneFeatures, model);
+        
+        m_RenderQueue.execute(m_glContext);
         //  m_Nano.drawWireframe(m_glContext);
         
         /*   // use lamp shader
-         m_glContext->useShader(1);
+         m_glContext->useShader(0);
          
          model = glm::mat4();
          model = glm::translate(model, m_lightPos);
          model = glm::scale(model, glm::vec3(0.2f));
          
-         m_glContext->setMatrix4fUniform(model, "model");
-         m_glContext->setViewUniform("view");
-         m_glContext->setProjectionUniform("projection");
+         m_glContext->setMatrix4fUniform(model, UNIFORM_MODEL);
+         m_glContext->setViewUniform(UNIFORM_VIEW);
+         m_glContext->setProjectionUniform(UNIFORM_PROJECTION);
          
          m_CubeLamp.draw(m_glContext);
          */
         
         m_Skybox.draw(m_glContext);
-    
-    
+        
+        
     }
     
     void Application::clearScreen(){
-    
+        
         glClearColor(0.3f, 0.7f, 1.0f, 1.0f);
        // glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
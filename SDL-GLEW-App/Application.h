@@ -32,6 +32,8 @@
 #include "Matrix.hpp"
 #include "Ray.hpp"
 #include "Mesh.h"
+#include "ObjectMap.h"
+#include "OcclusionCuller.h"
 #include "cubeData.h"
 #include "Time.h"
 
@@ -40,12 +42,16 @@
 #include "Model.h"
 #include "Skybox.h"
 #include "ShadowMap.h"
+#include "QuadTree.h"
+#include "Terrain.h"
+#include "RenderQueue.h"
+#include "ShaderVariants.h"
 
 namespace Fox {
-    
+
 class InputManager;
-    
-    
+
+
 /**
  * Application for OpenGL rendering
  */
@@ -53,6 +59,8 @@ class Application {
 
 public:
     
+    static const Uint32 STATISTICS_INTERVAL = 1000; ///< milliseconds between printed frame statistics
+    
     /**
      * Creates an OpenGL application with window width and height
      *
@@ -66,10 +74,10 @@ public:
         // initialize SDL
         SDL_Init(SDL_INIT_EVERYTHING);
         
-        // use OpenGL version 4.1
+        // use OpenGL version 4.3 for GPU culling, GLContext falls back to 4.1 e.g. on macOS
         SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
         SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
         SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
         // multisamping
         SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
@@ -91,6 +99,9 @@ public:
         m_ScreenWidth = width;
         m_ScreenHeight = height;
         
+        // created with the GPU culling, stays 0 on the OpenGL 4.1 fallback
+        m_OcclusionDepth = 0;
+        
         // load support for the JPG and PNG image formats
         int flags = IMG_INIT_JPG | IMG_INIT_PNG;
         int initted = IMG_Init(flags);
@@ -107,9 +118,9 @@ public:
         // add render contexts
         m_glContext->addRenderContext(0, 0, (GLfloat)m_ScreenWidth, (GLfloat) m_ScreenHeight, 45.0f, 0.1f, 5000.0f);
     //    m_glContext->addRenderContext((GLfloat)m_ScreenWidth/(GLfloat)2, (GLfloat)m_ScreenWidth/(GLfloat)2, (GLfloat)m_ScreenWidth/(GLfloat)2, (GLfloat)m_ScreenHeight/(GLfloat)2, 45.0f, 0.1f, 100.0f);
-        
+     
      //   m_glContext->addRenderContext(0, (GLfloat)m_ScreenWidth/(GLfloat)2, (GLfloat)m_ScreenWidth/(GLfloat)2, (GLfloat)m_ScreenHeight/(GLfloat)2, 45.0f, 0.1f, 100.0f);
-        
+     
      //   m_glContext->addRenderContext((GLfloat)m_ScreenWidth/(GLfloat)2, 0, (GLfloat)m_ScreenWidth/(GLfloat)2, (GLfloat)m_ScreenHeight, 45.0f, 0.1f, 100.0f);
         
         // starts the program
@@ -123,6 +134,9 @@ public:
         // init shadow map
         m_ShadowMap = new ShadowMap;
         
+        // the depth pass is disabled, so the scene is not shadowed
+        m_SceneFeatures = ShaderVariants::SPOT_LIGHT;
+        
         start();
         
     }
@@ -134,6 +148,13 @@ public:
         
         // delete texture manager
         delete TextureManager::Instance();
+        // delete the meshes of the model while the context is alive
+        m_Nano.release();
+        // delete the buffers and the depth texture of the GPU culling
+        m_SphereCuller.release();
+        m_CylinderCuller.release();
+        if(m_OcclusionDepth != 0)
+            glDeleteTextures(1, &m_OcclusionDepth);
         // delete gl context
         delete m_glContext;
         
@@ -198,7 +219,7 @@ public:
         textureManager->loadTexture("Textures/black.png", Texture::Specular);
         textureManager->loadTexture("Textures/darkgreen.png", Texture::Diffuse);
         textureManager->loadTexture("Textures/red.png", Texture::Diffuse);
-
+        
         
         m_Cube = createCube<Vertex>();
         
@@ -216,152 +237,142 @@ public:
         m_Cylinder = createCylinder<Vertex>(32, 4.0f, 0.25f);
         m_Cylinder.addTexture(textureManager->getTexture("Textures/tree.png"));
         
-        m_Plane = createGround<Vertex>("Textures/height.png");
+        m_Cylinder.computeBoundingSphere(m_Cylinder.m_Vertices);
+        
+        // the height map is decoded once for the terrain and the object placement
+        m_HeightField.load("Textures/height.png");
+        m_Terrain = Terrain(m_HeightField);
+        m_OcclusionCuller.setOccluders(m_HeightField);
         
         // map objects to the ground plane
-        mapObjects();
+        m_ObjectMap.load("Textures/objectmap.png");
+        
+        GLint halfWidth = (GLint) m_ObjectMap.getWidth() / 2;
+        GLint halfDepth = (GLint) m_ObjectMap.getDepth() / 2;
         
-        for(int x = -500; x < 500; x++){
+        m_SpherePositions.reserve(m_ObjectMap.getObjects().size());
+        m_CylinderPositions.reserve(m_ObjectMap.getObjects().size());
+        
+        for(const ObjectCell& cell : m_ObjectMap.getObjects()){
+            
+            GLfloat x = (GLfloat) ((GLint) cell.m_X - halfWidth);
+            GLfloat z = (GLfloat) ((GLint) cell.m_Z - halfDepth);
+            GLfloat height = m_HeightField.sampleHeight(x, z);
             
-            for(int y = -500; y < 500; y++){
-                
-                if (m_TreeArray[x+500][y+500] == 1) {
-                    
-                    m_SpherePositions.push_back(glm::vec3(x, m_HeightArray[x+500][y+500]*10 + 1.9f, y));
-                    m_CylinderPositions.push_back(glm::vec3(x, m_HeightArray[x+500][y+500]*10 + 0.5f, y));
-                    
-                }
-            }
+            m_SpherePositions.push_back(glm::vec3(x, height + 1.9f, z));
+            m_CylinderPositions.push_back(glm::vec3(x, height + 0.5f, z));
         }
         
+        // spatial index over world space bounds of the trees for culling
+        BoundingSphereSet sphereBounds, cylinderBounds;
         
-        m_Plane.addTexture(textureManager->getTexture("Textures/grassplain.png"));
-        m_Plane.addTexture(textureManager->getTexture("Textures/black.png"));
-
+        for(const glm::vec3& position : m_SpherePositions){
+            sphereBounds.add(position + m_Sphere.m_BoundingSphere.m_Center, m_Sphere.m_BoundingSphere.m_Radius);
+        }
+        
+        for(const glm::vec3& position : m_CylinderPositions){
+            cylinderBounds.add(position + m_Cylinder.m_BoundingSphere.m_Center, m_Cylinder.m_BoundingSphere.m_Radius);
+        }
+        
+        m_SphereTree.build(sphereBounds);
+        m_CylinderTree.build(cylinderBounds);
+        
+        
+        m_Terrain.addTexture(textureManager->getTexture("Textures/grassplain.png"));
+        m_Terrain.addTexture(textureManager->getTexture("Textures/black.png"));
+      
       //  m_Nano = Model("Models/house/Farmhouse OBJ.obj", true);
       //  m_Nano = Model("Models/throne/Duke_Throne.obj", true);
       //  m_Nano.addTexture(textureManager->getTexture("Textures/grassplain.png"));
        // m_Nano.addTexture(textureManager->getTexture("Textures/black.png"));
-        
+      
       //  m_Nano = Model("Models/NanosuitMale/Nanosuit_Male.obj", true);
-        
+       
        // textureManager->printAll(Texture::Normal);
           m_Nano = Model("Models/nanosuit/nanosuit.obj", true);
-        
+       
        // m_Nano.addTexture(textureManager->getTexture("Models/nanosuit/arm_showroom_ddn.png"));
       //  m_Nano.addTexture(textureManager->getTexture("Textures/red.png"));
       //  m_Nano.addTexture(textureManager->getTexture("Textures/grassplain.png"));
       //  m_Nano.addTexture(textureManager->getTexture("Textures/black.png"));
-    
-        // define spotlight shader
-     //   m_glContext->addShaderProgram("Shaders/phong-diffuse-specular.vert", "Shaders/spotLight.frag");
-     //   m_glContext->addShaderProgram("Shaders/phong-diffuse-specular.vert", "Shaders/directional.frag");
-       
-       // m_glContext->addShaderProgram("Shaders/phong-diffuse-specular.vert", "Shaders/scenelighting.frag");
         
-       // m_glContext->addShaderProgram("Shaders/phong-diffuse-specular.vert", "Shaders/scene-blinn.frag");
-        
-        m_glContext->addShaderProgram("Shaders/bumpedDiffuseSpecular.vert", "Shaders/bumpedDiffuseSpecular.frag");
-
-        
-        
-        m_glContext->addUniform("viewPos");
-        
-        // setup spot light
-        m_glContext->addUniform("spotLight.position");
-        m_glContext->addUniform("spotLight.direction");
-        m_glContext->addUniform("spotLight.ambient");
-        m_glContext->addUniform("spotLight.diffuse");
-        m_glContext->addUniform("spotLight.specular");
-        m_glContext->addUniform("spotLight.constant");
-        m_glContext->addUniform("spotLight.linear");
-        m_glContext->addUniform("spotLight.quadratic");
-        m_glContext->addUniform("spotLight.cutOff");
-        m_glContext->addUniform("spotLight.outerCutOff");
-        
-        // setup directional light
-        m_glContext->addUniform("dirLight.direction");
-        m_glContext->addUniform("dirLight.ambient");
-        m_glContext->addUniform("dirLight.diffuse");
-        m_glContext->addUniform("dirLight.specular");
-        
-        
-        // setup material
-        m_glContext->addUniform("material.diffuse");
-        m_glContext->addUniform("material.specular");
-        m_glContext->addUniform("material.shininess");
-        m_glContext->addUniform("material.normalMap");
-        
-        m_glContext->addUniform("model");
-        m_glContext->addUniform("view");
-        m_glContext->addUniform("projection");
+        // compile all programs at once, active uniforms of each program are found at link time
+        m_glContext->beginShaderPrograms();
         
         // define lamp shader
         m_glContext->addShaderProgram("Shaders/transform3d-simplified.vert", "Shaders/white.frag");
-        m_glContext->setCurrentShader(1);
-        m_glContext->addUniform("model");
-        m_glContext->addUniform("view");
-        m_glContext->addUniform("projection");
         
         m_glContext->addShaderProgram("Shaders/skybox.vert", "Shaders/skybox.frag");
-        m_glContext->setCurrentShader(2);
-        m_Skybox.m_SkyboxShaderIndex = 2;
-        m_glContext->addUniform("skybox");
-        m_glContext->addUniform("view");
-        m_glContext->addUniform("projection");
-        
-        
-        m_glContext->addShaderProgram("Shaders/phong-diffuse-specular.vert", "Shaders/scene-blinn.frag");
-        m_glContext->setCurrentShader(3);
+        m_Skybox.m_SkyboxShaderIndex = 1;
         
-        m_glContext->addUniform("viewPos");
-        
-        // setup spot light
-        m_glContext->addUniform("spotLight.position");
-        m_glContext->addUniform("spotLight.direction");
-        m_glContext->addUniform("spotLight.ambient");
-        m_glContext->addUniform("spotLight.diffuse");
-        m_glContext->addUniform("spotLight.specular");
-        m_glContext->addUniform("spotLight.constant");
-        m_glContext->addUniform("spotLight.linear");
-        m_glContext->addUniform("spotLight.quadratic");
-        m_glContext->addUniform("spotLight.cutOff");
-        m_glContext->addUniform("spotLight.outerCutOff");
-        
-        // setup directional light
-        m_glContext->addUniform("dirLight.direction");
-        m_glContext->addUniform("dirLight.ambient");
-        m_glContext->addUniform("dirLight.diffuse");
-        m_glContext->addUniform("dirLight.specular");
-        
-        
-        // setup material
-        m_glContext->addUniform("material.diffuse");
-        m_glContext->addUniform("material.specular");
-        m_glContext->addUniform("material.shininess");
-        m_glContext->addUniform("material.normalMap");
+        m_glContext->addShaderProgram("Shaders/visualDepthMap.vert", "Shaders/visualDepthMap.frag");
+        m_ShadowMap->m_VisualizeShaderIndex = 2;
         
-        m_glContext->addUniform("model");
-        m_glContext->addUniform("view");
-        m_glContext->addUniform("projection");
+        // lighting and depth map shaders are variants of the uber shader, compiled on first use.
+        // Variants of the first frame are requested here so that they join the batch
+        m_Lighting.load("Shaders/uber.vert", "Shaders/uber.frag");
         
-        m_glContext->addShaderProgram("Shaders/shadowMapDepth.vert", "Shaders/shadowMapDepth.frag");
-        m_glContext->setCurrentShader(4);
+        m_Lighting.getShader(m_glContext, m_SceneFeatures | ShaderVariants::INSTANCED);
+        m_Lighting.getShader(m_glContext, m_SceneFeatures | ShaderVariants::TERRAIN);
+        m_Lighting.getShader(m_glContext, m_SceneFeatures);
+        m_Lighting.getShader(m_glContext, m_SceneFeatures | ShaderVariants::NORMAL_MAP);
+        m_Lighting.getShader(m_glContext, ShaderVariants::DEPTH_ONLY | ShaderVariants::INSTANCED);
+        m_Lighting.getShader(m_glContext, ShaderVariants::DEPTH_ONLY | ShaderVariants::TERRAIN);
         
-        m_glContext->addUniform("model");
-        m_glContext->addUniform("lightSpaceMatrix");
+        m_glContext->finishShaderPrograms();
+        m_glContext->printShaderStatistics();
         
-        m_glContext->addShaderProgram("Shaders/visualDepthMap.vert", "Shaders/visualDepthMap.frag");
-        m_glContext->setCurrentShader(5);
+        // with OpenGL 4.3 the trees are culled on the GPU, otherwise by the quad trees
+        if(m_glContext->supportsIndirectDraw()){
+            
+            GLuint cullInstances = m_glContext->addComputeProgram("Shaders/cullInstances.comp");
+            
+            m_SphereCuller.create(cullInstances, m_Sphere.getIndirectCommand(0), m_Sphere.m_BoundingSphere, m_Sphere.m_Dequantize, m_SpherePositions);
+            m_CylinderCuller.create(cullInstances, m_Cylinder.getIndirectCommand(0), m_Cylinder.m_BoundingSphere, m_Cylinder.m_Dequantize, m_CylinderPositions);
+            m_OcclusionDepth = InstanceCuller::createDepthTexture(m_glContext);
+        }
         
-        m_glContext->addUniform("depthMap");
-     
     }
     
     void renderScene();
     
     void renderSceneToDepthBuffer();
     
+    /**
+     * Culls the trees against a frustum and submits the visible ones as instanced packets,
+     * on the GPU when the context supports indirect draws
+     *
+     * @param frustum Frustum of the pass
+     * @param shader Instanced shader index in GLContext
+     * @param occlusion Drop trees hidden by the terrain in the latest occlusion render
+     */
+    void submitTrees(const Frustum& frustum, GLuint shader, bool occlusion = false);
+    
+    /**
+     * Prints the counters of the latest frame
+     *
+     * @param framesPerSecond Frame rate since the previous print
+     */
+    void printFrameStatistics(GLfloat framesPerSecond);
+    
+    /**
+     * Returns counts of trees kept and dropped by occlusion culling since the frame began.
+     * The counts of GPU culling are read back, which waits for the culls of the frame
+     */
+    inline OcclusionCuller::Statistics getOcclusionStatistics() const {
+        
+        OcclusionCuller::Statistics statistics = m_OcclusionCuller.getStatistics();
+        m_SphereCuller.readStatistics(statistics);
+        m_CylinderCuller.readStatistics(statistics);
+        
+        return statistics;
+    }
+    
+    /**
+     * Uploads camera, shadow and light data of the current render context to the uniform buffers
+     */
+    void updateFrameUniforms();
+    
     void SetContainerPositionToMousePosition(){
         
         //m_p = m_glContext->getCurrentRenderContext().castRay(m_InputManager->m_MouseX, m_ScreenHeight - m_InputManager->m_MouseY);
@@ -410,64 +421,36 @@ public:
     GLContext* getGLContext(){
         return m_glContext;
     }
-    
-    void mapObjects(){
-        
-        SDL_Surface* image = Texture::readTexture("Textures/objectmap.png");
-        SDL_Surface* imageHeight = Texture::readTexture("Textures/height.png");
-        
-        Uint32* p = (Uint32*) image->pixels;
-        Uint32* p2 = (Uint32*) imageHeight->pixels;
-        
-        for(int x = 0; x < image->w; x++){
-            
-            for(int y = 0; y < image->h; y++){
-                
-                
-                Uint8 r,g,b;
-                SDL_GetRGB(p[y*image->w + x], image->format, &r, &g, &b);
-                GLint value = (GLint)(0.21f * r + 0.72f * g + 0.07f * b);
-                
-                
-                if(g==255){
-                    m_TreeArray[x][y] = 1;
-                    // std::cout << "x: " << x << " y: " << y << " " <<  treeArray[x][y] << std::endl;
-                } else {
-                    m_TreeArray[x][y] = 0;
-                }
-             
-                
-                SDL_GetRGB(p2[y*imageHeight->w + x], imageHeight->format, &r, &g, &b);
-                
-                GLint heightMap = (GLint)(0.21f * r + 0.72f * g + 0.07f * b);
-                GLfloat h = (GLfloat)(heightMap/255.0f) * 10.0f - 10.0f;
-                m_HeightArray[x][y] = h;
-            }
-        }
-        
-        
-        SDL_FreeSurface(image);
-        SDL_FreeSurface(imageHeight);
-        
-    }
-    
+
 private:
     
     Skybox m_Skybox;
     ShadowMap* m_ShadowMap;
+    ShaderVariants m_Lighting; ///< permutations of the uber lighting shader
+    GLuint m_SceneFeatures; ///< lights and shadows of the scene, see ShaderVariants::Feature
+    RenderQueue m_RenderQueue;
     
     FMesh<Vertex> m_Cube;
     FMesh<VertexP> m_CubeLamp;
-    Mesh<Vertex> m_Plane;
+    HeightField m_HeightField; ///< heights of the ground, shared by the terrain and the object placement
+    Terrain m_Terrain;
     Mesh<Vertex> m_Cylinder;
     Mesh<Vertex> m_Sphere;
     
-    int m_TreeArray[1000][1000];
-    GLfloat m_HeightArray[1000][1000];
+    ObjectMap m_ObjectMap; ///< cells of the ground holding trees
     
     std::vector<glm::vec3> m_SpherePositions;
     std::vector<glm::vec3> m_CylinderPositions;
     
+    QuadTree m_SphereTree; ///< spatial index of sphere trees
+    QuadTree m_CylinderTree; ///< spatial index of cylinder trees
+    std::vector<GLuint> m_VisibleSpheres; ///< sphere trees that passed culling in the current pass
+    std::vector<GLuint> m_VisibleCylinders; ///< cylinder trees that passed culling in the current pass
+    InstanceCuller m_SphereCuller; ///< GPU culling of sphere trees, used instead of the quad tree with OpenGL 4.3
+    InstanceCuller m_CylinderCuller; ///< GPU culling of cylinder trees
+    OcclusionCuller m_OcclusionCuller; ///< hides trees behind the terrain in the camera passes
+    GLuint m_OcclusionDepth; ///< depth of m_OcclusionCuller for the GPU culling
+    
     Model m_Nano;
     
     bool m_IsFullScreen; ///< tells if this application is in full screen mode
@@ -479,7 +462,7 @@ private:
     InputManager* m_InputManager; ///< manager for input handling
     ResourceManager m_ResourceManager; ///< manager for resource handling
 };
-
-}
     
+}
+
 #endif /* Application_h */
@@ -11,20 +11,24 @@
 
 #include <GL/glew.h>
 
+#include <vector>
+
 #include "glm/glm.hpp"
 
+#include "Vertex.h"
+
 namespace Fox {
 
 class BoundingSphere {
 
 public:
     
-    BoundingSphere(){}
+    BoundingSphere() : m_Center(0.0f), m_Radius(0.0f) {}
     
     /**
      * Constructs the bounding sphere based on vertex data
      */
-    BoundingSphere(const std::vector<Vertex>& vertices){
+    template<class V> BoundingSphere(const std::vector<V>& vertices){
         
         computeBoundingSphere(vertices);
     
@@ -35,12 +39,12 @@ public:
      * 
      * @param vertices Vertices of the mesh
      **/
-    void computeBoundingSphere(const std::vector<Vertex>& vertices){
+    template<class V> void computeBoundingSphere(const std::vector<V>& vertices){
     
         glm::vec3 sum = glm::vec3(0,0,0);
         
         // compute center of the sphere
-        for(Vertex v : vertices) {
+        for(const V& v : vertices) {
         
             sum += v.m_Position;
         }
@@ -49,7 +53,7 @@ public:
         m_Radius = 0.0f;
         
         // compute radius
-        for(Vertex v : vertices){
+        for(const V& v : vertices){
         
             GLfloat r = glm::length(v.m_Position - m_Center);
             // if we have a bigger radius, update radius
@@ -65,6 +69,62 @@ public:
     
 
 
+};
+    
+/**
+ * Bounding spheres stored as separate coordinate arrays so that several spheres can be tested at once
+ */
+class BoundingSphereSet {
+    
+public:
+    
+    static const GLuint PADDING = 8; ///< arrays are padded to a multiple of the widest SIMD batch
+    
+    BoundingSphereSet() : m_Count(0) {}
+    
+    /**
+     * Adds a sphere to the set
+     *
+     * @param center Center of the sphere
+     * @param radius Radius of the sphere
+     */
+    void add(const glm::vec3& center, GLfloat radius){
+        
+        // grow arrays a full batch at a time
+        if(m_Count == m_X.size()){
+            GLuint size = m_Count + PADDING;
+            m_X.resize(size, 0.0f);
+            m_Y.resize(size, 0.0f);
+            m_Z.resize(size, 0.0f);
+            m_Radius.resize(size, 0.0f);
+        }
+        
+        m_X[m_Count] = center.x;
+        m_Y[m_Count] = center.y;
+        m_Z[m_Count] = center.z;
+        m_Radius[m_Count] = radius;
+        m_Count++;
+    }
+    
+    /**
+     * Removes all spheres, keeps the allocated memory
+     */
+    void clear(){
+        m_Count = 0;
+    }
+    
+    /**
+     * Returns number of spheres in the set
+     */
+    inline GLuint size() const {
+        return m_Count;
+    }
+    
+    std::vector<GLfloat> m_X, m_Y, m_Z; ///< sphere centers
+    std::vector<GLfloat> m_Radius; ///< sphere radii
+    
+private:
+    GLuint m_Count; ///< number of spheres
 };
 
 }
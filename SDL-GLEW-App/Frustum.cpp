@@ -9,11 +9,19 @@
 #include "Frustum.h"
 #include "Matrix.hpp"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
 namespace Fox {
     
     void Frustum::updateFrustum(glm::mat4& projection, glm::mat4 view, glm::mat4 model) {
-        
-        glm::mat4 clip = projection * view * model;
+        updateFrustum(projection * view * model);
+    }
+    
+    void Frustum::updateFrustum(const glm::mat4& clip) {
         
         // right plane
      /*   m_Frustum[RIGHT][A] = clip[3][0] - clip[0][0];
@@ -185,4 +193,151 @@ namespace Fox {
         return true;
     }
     
+    
+    void Frustum::cullSpheres(const BoundingSphereSet& spheres, std::vector<GLuint>& visible) const {
+        
+        visible.clear();
+        cullSpheres(spheres, 0, spheres.size(), visible);
+    }
+    
+    void Frustum::cullSpheres(const BoundingSphereSet& spheres, GLuint begin, GLuint end, std::vector<GLuint>& visible) const {
+        
+        const GLfloat* xs = spheres.m_X.data();
+        const GLfloat* ys = spheres.m_Y.data();
+        const GLfloat* zs = spheres.m_Z.data();
+        const GLfloat* rs = spheres.m_Radius.data();
+        
+#if defined(__AVX__)
+        
+        // broadcast planes once
+        __m256 a[6], b[6], c[6], d[6];
+        for(GLuint p = 0; p < 6; p++){
+            a[p] = _mm256_set1_ps(m_Frustum[p][A]);
+            b[p] = _mm256_set1_ps(m_Frustum[p][B]);
+            c[p] = _mm256_set1_ps(m_Frustum[p][C]);
+            d[p] = _mm256_set1_ps(m_Frustum[p][D]);
+        }
+        
+        const __m256 zero = _mm256_setzero_ps();
+        
+        // test 8 spheres at a time, start from an aligned batch so that loads stay inside the padded arrays
+        for(GLuint i = begin & ~7u; i < end; i += 8){
+            
+            __m256 x = _mm256_loadu_ps(xs + i);
+            __m256 y = _mm256_loadu_ps(ys + i);
+            __m256 z = _mm256_loadu_ps(zs + i);
+            __m256 negRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(rs + i));
+            
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            
+            for(GLuint p = 0; p < 6; p++){
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[p], x), _mm256_mul_ps(b[p], y)),
+                                                _mm256_add_ps(_mm256_mul_ps(c[p], z), d[p]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GT_OQ));
+            }
+            
+            GLuint mask = (GLuint) _mm256_movemask_ps(inside);
+            
+            // ignore lanes outside the range
+            if(i < begin)
+                mask &= ~((1u << (begin - i)) - 1);
+            if(end - i < 8)
+                mask &= (1u << (end - i)) - 1;
+            
+            // write indices of visible spheres
+            while(mask){
+                visible.push_back(i + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+        
+#elif defined(__SSE__)
+        
+        // broadcast planes once
+        __m128 a[6], b[6], c[6], d[6];
+        for(GLuint p = 0; p < 6; p++){
+            a[p] = _mm_set1_ps(m_Frustum[p][A]);
+            b[p] = _mm_set1_ps(m_Frustum[p][B]);
+            c[p] = _mm_set1_ps(m_Frustum[p][C]);
+            d[p] = _mm_set1_ps(m_Frustum[p][D]);
+        }
+        
+        const __m128 zero = _mm_setzero_ps();
+        
+        // test 4 spheres at a time, start from an aligned batch so that loads stay inside the padded arrays
+        for(GLuint i = begin & ~3u; i < end; i += 4){
+            
+            __m128 x = _mm_loadu_ps(xs + i);
+            __m128 y = _mm_loadu_ps(ys + i);
+            __m128 z = _mm_loadu_ps(zs + i);
+            __m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(rs + i));
+            
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+            
+            for(GLuint p = 0; p < 6; p++){
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[p], x), _mm_mul_ps(b[p], y)),
+                                             _mm_add_ps(_mm_mul_ps(c[p], z), d[p]));
+                inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negRadius));
+            }
+            
+            GLuint mask = (GLuint) _mm_movemask_ps(inside);
+            
+            // ignore lanes outside the range
+            if(i < begin)
+                mask &= ~((1u << (begin - i)) - 1);
+            if(end - i < 4)
+                mask &= (1u << (end - i)) - 1;
+            
+            // write indices of visible spheres
+            while(mask){
+                visible.push_back(i + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+        
+#else
+        
+        for(GLuint i = begin; i < end; i++){
+            
+            bool inside = true;
+            
+            for(GLuint p = 0; p < 6 && inside; p++){
+                inside = m_Frustum[p][A] * xs[i] + m_Frustum[p][B] * ys[i] + m_Frustum[p][C] * zs[i] + m_Frustum[p][D] > -rs[i];
+            }
+            
+            if(inside)
+                visible.push_back(i);
+        }
+        
+#endif
+    }
+    
+    
+    Frustum::Containment Frustum::classifyBox(const glm::vec3& min, const glm::vec3& max) const {
+        
+        Containment result = INSIDE;
+        
+        // check all planes
+        for(GLuint i = 0; i < 6; i++)
+        {
+            // corners furthest along and against the plane normal
+            glm::vec3 positive = glm::vec3(m_Frustum[i][A] >= 0 ? max.x : min.x,
+                                           m_Frustum[i][B] >= 0 ? max.y : min.y,
+                                           m_Frustum[i][C] >= 0 ? max.z : min.z);
+            glm::vec3 negative = glm::vec3(m_Frustum[i][A] >= 0 ? min.x : max.x,
+                                           m_Frustum[i][B] >= 0 ? min.y : max.y,
+                                           m_Frustum[i][C] >= 0 ? min.z : max.z);
+            
+            // whole box behind the plane
+            if(m_Frustum[i][A] * positive.x + m_Frustum[i][B] * positive.y + m_Frustum[i][C] * positive.z + m_Frustum[i][D] <= 0)
+                return OUTSIDE;
+            
+            // box crosses the plane
+            if(m_Frustum[i][A] * negative.x + m_Frustum[i][B] * negative.y + m_Frustum[i][C] * negative.z + m_Frustum[i][D] <= 0)
+                result = INTERSECTS;
+        }
+        
+        return result;
+    }
+    
 }
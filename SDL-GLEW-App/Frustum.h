@@ -12,16 +12,19 @@
 #include <GL/glew.h>
 
 #include <iostream>
+#include <vector>
 
 #include "glm/glm.hpp"
 
+#include "BoundingVolume.h"
+
 namespace Fox {
 
 /**
  * Frustum used for frustum culling
  */
 class Frustum {
-    
+
 public:
     
     enum FrustumSide
@@ -42,11 +45,26 @@ public:
         D = 3				// The distance that the plane is from the origin
     };
     
+    enum Containment
+    {
+        OUTSIDE     = 0,    // Completely outside the frustum
+        INTERSECTS  = 1,    // Partly inside the frustum
+        INSIDE      = 2     // Completely inside the frustum
+    };
+    
     /**
      * Updates the frustum. Should be called every time camera moves
      */
     void updateFrustum(glm::mat4& projection, glm::mat4 view, glm::mat4 model);
-   
+    
+    /**
+     * Extracts the frustum planes from a combined clip matrix. With projection * view
+     * the planes are in world space and can be used for all objects of a frame
+     *
+     * @param clip Clip matrix
+     */
+    void updateFrustum(const glm::mat4& clip);
+    
     /**
      * Checks if a 3d point is inside frustum
      *
@@ -80,6 +98,40 @@ public:
      */
     bool boxIsInsideFrustum(const glm::vec3& center, const glm::vec3 size);
     
+    /**
+     * Tests a set of spheres against the frustum several spheres at a time
+     *
+     * @param spheres Spheres to be tested, in the same space as the frustum planes
+     * @param visible Receives indices of the spheres inside the frustum in increasing order
+     */
+    void cullSpheres(const BoundingSphereSet& spheres, std::vector<GLuint>& visible) const;
+    
+    /**
+     * Tests a range of spheres against the frustum several spheres at a time
+     *
+     * @param spheres Spheres to be tested, in the same space as the frustum planes
+     * @param begin Index of the first sphere to test
+     * @param end Index one past the last sphere to test
+     * @param visible Indices of the spheres inside the frustum are appended to this in increasing order
+     */
+    void cullSpheres(const BoundingSphereSet& spheres, GLuint begin, GLuint end, std::vector<GLuint>& visible) const;
+    
+    /**
+     * Classifies an axis aligned box against the frustum
+     *
+     * @param min Minimum corner of the box
+     * @param max Maximum corner of the box
+     * @return whether the box is outside, intersects or is inside the frustum
+     */
+    Containment classifyBox(const glm::vec3& min, const glm::vec3& max) const;
+    
+    /**
+     * Returns the A, B, C, D values of the six planes, e.g. for a vec4 array uniform
+     */
+    inline const GLfloat* getPlanes() const {
+        return &m_Frustum[0][0];
+    }
+    
     
     /**
      * Normalizes the frustum
@@ -98,8 +150,8 @@ public:
         frustum[side][C] /= magnitude;
         frustum[side][D] /= magnitude;
     }
-    
-    
+
+
 private:
     
     GLfloat m_Frustum[6][4]; ///< A, B, C, D values of a plane for each side of the frustum
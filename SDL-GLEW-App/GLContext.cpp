@@ -6,19 +6,159 @@
 //  Copyright © 2017 Olli Kettunen. All rights reserved.
 //
 
+#include <chrono>
+
 #include "GLContext.h"
 
-namespace Fox {
+// GL_KHR_parallel_shader_compile, missing from older GLEW headers
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
-    void GLContext::addShaderProgram(char* vertexShaderFile, char* fragmentShaderFile) {
+namespace Fox {
+    
+    typedef void (APIENTRY *MaxShaderCompilerThreadsFunc)(GLuint count);
+    
+    void GLContext::beginShaderPrograms() {
+        
+        m_BatchingShaders = true;
+        
+        m_ParallelShaderCompile = SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile") == SDL_TRUE;
+        
+        // let the driver pick the number of compiler threads
+        if(m_ParallelShaderCompile){
+            MaxShaderCompilerThreadsFunc maxShaderCompilerThreads = (MaxShaderCompilerThreadsFunc) SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR");
+            if(maxShaderCompilerThreads != nullptr)
+                maxShaderCompilerThreads(0xFFFFFFFF);
+        }
+    }
     
+    void GLContext::addShaderProgram(char* vertexShaderFile, char* fragmentShaderFile) {
+        
         GLint vertexShaderFileSize;
         char* vertexShaderData = ResourceManager::loadFile(vertexShaderFile, vertexShaderFileSize);
         
         GLint fragmentShaderFileSize;
         char* fragmentShaderData = ResourceManager::loadFile(fragmentShaderFile, fragmentShaderFileSize);
         
-        m_Shaders.push_back(new ShaderProgram(vertexShaderData, vertexShaderFileSize, fragmentShaderData, fragmentShaderFileSize));
+        addShaderProgram(vertexShaderData, vertexShaderFileSize, fragmentShaderData, fragmentShaderFileSize, vertexShaderFile);
+        
+        delete[] vertexShaderData;
+        delete[] fragmentShaderData;
     }
-
+    
+    GLuint GLContext::addComputeProgram(char* computeShaderFile) {
+        
+        GLint computeShaderFileSize;
+        char* computeShaderData = ResourceManager::loadFile(computeShaderFile, computeShaderFileSize);
+        
+        ShaderProgram* program = new ShaderProgram(computeShaderData, computeShaderFileSize);
+        
+        delete[] computeShaderData;
+        
+        m_Shaders.push_back(program);
+        
+        return (GLuint) m_Shaders.size() - 1;
+    }
+    
+    GLuint GLContext::addShaderProgram(const GLchar* vertexShaderData, GLint vertexShaderSize, const GLchar* fragmentShaderData, GLint fragmentShaderSize, const std::string& name) {
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        
+        // try the binary of an earlier run first
+        const GLchar* sources[] = {vertexShaderData, fragmentShaderData};
+        GLint sizes[] = {vertexShaderSize, fragmentShaderSize};
+        uint64_t key = m_ShaderCache.key(sources, sizes, 2);
+        
+        ShaderProgram* program = m_ShaderCache.load(key);
+        
+        if(program != nullptr){
+            
+            bindUniformBlocks(program);
+            
+            m_ShaderStatistics.m_Cached++;
+            m_ShaderStatistics.m_CachedTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        } else {
+            
+            // only submit compile and link, the index of the program is valid right away
+            program = new ShaderProgram(vertexShaderData, vertexShaderSize, fragmentShaderData, fragmentShaderSize, true);
+            
+            PendingShaderProgram pending;
+            pending.m_Program = program;
+            pending.m_Key = key;
+            pending.m_Name = name;
+            m_PendingShaders.push_back(pending);
+            
+            m_ShaderStatistics.m_Compiled++;
+            m_ShaderStatistics.m_CompiledTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        
+        m_Shaders.push_back(program);
+        
+        if(!m_BatchingShaders)
+            finishShaderPrograms();
+        
+        return (GLuint) m_Shaders.size() - 1;
+    }
+    
+    void GLContext::finishShaderPrograms() {
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        
+        while(!m_PendingShaders.empty()){
+            
+            // with parallel compile finish whichever programs are done, otherwise wait in order
+            GLuint finished = 0;
+            
+            for(GLuint i = 0; i < m_PendingShaders.size(); ){
+                
+                PendingShaderProgram& pending = m_PendingShaders[i];
+                
+                GLint complete = GL_TRUE;
+                if(m_ParallelShaderCompile)
+                    glGetProgramiv(pending.m_Program->m_Id, GL_COMPLETION_STATUS_KHR, &complete);
+                
+                if(complete != GL_TRUE){
+                    i++;
+                    continue;
+                }
+                
+                finishShaderProgram(pending);
+                
+                m_PendingShaders.erase(m_PendingShaders.begin() + i);
+                finished++;
+            }
+            
+            if(finished == 0)
+                SDL_Delay(1);
+        }
+        
+        m_BatchingShaders = false;
+        
+        m_ShaderStatistics.m_CompiledTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    
+    void GLContext::finishShaderProgram(const PendingShaderProgram& pending) {
+        
+        ShaderProgram* program = pending.m_Program;
+        
+        if(program->finish() && !m_ShaderCache.store(pending.m_Key, program))
+            std::cout << "Could not cache program binary of " << pending.m_Name << std::endl;
+        
+        bindUniformBlocks(program);
+    }
+    
+    void GLContext::bindUniformBlocks(ShaderProgram* program) {
+        
+        // shared per frame and per material data comes from the uniform buffers
+        program->bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+        program->bindUniformBlock("LightUniforms", LIGHT_UNIFORMS_BINDING);
+        program->bindUniformBlock("MaterialUniforms", MATERIAL_UNIFORMS_BINDING);
+    }
+    
+    void GLContext::printShaderStatistics() const {
+        std::cout << m_ShaderStatistics.m_Compiled << " shader programs compiled in " << m_ShaderStatistics.m_CompiledTime << " ms, "
+                  << m_ShaderStatistics.m_Cached << " loaded from cache in " << m_ShaderStatistics.m_CachedTime << " ms" << std::endl;
+    }
+    
 }
@@ -11,6 +11,9 @@
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <string>
 
 #include <SDL2/SDL.h>
 
@@ -25,6 +28,8 @@
 #include "ResourceManager.h"
 #include "ShaderProgram.hpp"
 #include "RenderContext.h"
+#include "UniformBuffer.h"
+#include "ShaderCache.h"
 
 /**
  * OpenGL context
@@ -36,6 +41,39 @@ class GLContext {
 
 public:
     
+    static const GLuint MAX_TEXTURE_UNITS = 16; ///< texture units tracked by the state cache
+    
+    /**
+     * Counters of state changes sent to the driver and dropped as redundant
+     */
+    class StateStatistics {
+    public:
+        
+        StateStatistics() : m_Issued(0), m_Suppressed(0) {}
+        
+        void reset() {
+            m_Issued = 0;
+            m_Suppressed = 0;
+        }
+        
+        GLuint m_Issued; ///< calls that reached GL
+        GLuint m_Suppressed; ///< calls that would not have changed anything
+    };
+    
+    /**
+     * Shader programs created from source and from the binary cache, with the time spent on each
+     */
+    class ShaderStatistics {
+    public:
+        
+        ShaderStatistics() : m_Compiled(0), m_Cached(0), m_CompiledTime(0.0), m_CachedTime(0.0) {}
+        
+        GLuint m_Compiled; ///< programs compiled and linked from source
+        GLuint m_Cached; ///< programs loaded from the binary cache
+        GLdouble m_CompiledTime; ///< milliseconds spent on compiled programs
+        GLdouble m_CachedTime; ///< milliseconds spent on cached programs
+    };
+    
     GLContext(){}
     
     /**
@@ -44,10 +82,15 @@ public:
      * @param window Window to render
      */
     GLContext(SDL_Window* window, const ResourceManager& resourceManager) : m_ResourceManager(resourceManager){
-    
-        // create OpenGL context
+        
+        // create OpenGL context, drivers without the requested version get a 4.1 context
         m_Context = SDL_GL_CreateContext(window);
         
+        if(m_Context == nullptr){
+            SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+            m_Context = SDL_GL_CreateContext(window);
+        }
+        
         glewExperimental = true;
         
         // initialize GLEW
@@ -56,9 +99,17 @@ public:
             
         }
         
+        // compute shaders, storage buffers and multi draw indirect are core in 4.3
+        m_IndirectDraw = GLEW_VERSION_4_3 == GL_TRUE;
+        
         m_CurrentShader = 0;
         m_Window = window;
         m_CurrentRenderContext = 0;
+        m_BatchingShaders = false;
+        m_ParallelShaderCompile = false;
+        
+        invalidateState();
+        createUniformBuffers();
     }
     
     /**
@@ -76,7 +127,7 @@ public:
         
         // delete OpenGL context
         SDL_GL_DeleteContext(m_Context);
-    
+        
     }
     
     /**
@@ -84,7 +135,7 @@ public:
      *
      */
     void addRenderContext(GLfloat x, GLfloat y, GLfloat width, GLfloat height, GLfloat fov, GLfloat near, GLfloat far) {
-    
+      
       //  m_RenderContext = RenderContext(x, y, width, height, fov, near, far);
         m_RenderContexts.push_back(RenderContext(x, y, width, height, fov, near, far));
     }
@@ -92,29 +143,29 @@ public:
     /**
      * Sends projection matrix uniform of current render context to shader
      *
-     * @param projectionName Name of the uniform in shader
+     * @param projectionUniform Identifier of the uniform in shader, see uniformId
      */
-    void setProjectionUniform(const GLchar* projectionName){
-        setMatrix4fUniform(m_RenderContexts[m_CurrentRenderContext].m_Projection, projectionName);
+    void setProjectionUniform(UniformId projectionUniform){
+        setMatrix4fUniform(m_RenderContexts[m_CurrentRenderContext].m_Projection, projectionUniform);
     }
     
     
     /**
      * Sends view matrix uniform of current render context to shader
      *
-     * @param viewName Name of the uniform in shader
+     * @param viewUniform Identifier of the uniform in shader, see uniformId
      */
-    void setViewUniform(const GLchar* viewName){
-        setMatrix4fUniform(m_RenderContexts[m_CurrentRenderContext].m_Camera.view(), viewName);
+    void setViewUniform(UniformId viewUniform){
+        setMatrix4fUniform(m_RenderContexts[m_CurrentRenderContext].m_Camera.view(), viewUniform);
     }
     
-    void setViewUniformForSkybox(const GLchar* viewName){
+    void setViewUniformForSkybox(UniformId viewUniform){
         // remove translation component from view matrix
-        setMatrix4fUniform(glm::mat4(glm::mat3(m_RenderContexts[m_CurrentRenderContext].m_Camera.view())), viewName);
+        setMatrix4fUniform(glm::mat4(glm::mat3(m_RenderContexts[m_CurrentRenderContext].m_Camera.view())), viewUniform);
     }
     
-    void setCameraPosition(const GLchar* uniformName) {
-        setVec3(m_RenderContexts[m_CurrentRenderContext].m_Camera.m_Position, uniformName);
+    void setCameraPosition(UniformId uniform) {
+        setVec3(m_RenderContexts[m_CurrentRenderContext].m_Camera.m_Position, uniform);
     }
     
     /**
@@ -122,7 +173,7 @@ public:
      */
     void setViewPort(){
         RenderContext& rc = m_RenderContexts[m_CurrentRenderContext];
-        glViewport(rc.m_ViewPortX, rc.m_ViewPortY, rc.m_ViewPortWidth, rc.m_ViewPortHeight);
+        viewport(rc.m_ViewPortX, rc.m_ViewPortY, rc.m_ViewPortWidth, rc.m_ViewPortHeight);
     }
     
     /**
@@ -141,6 +192,18 @@ public:
      */
     void addShaderProgram(char* vertexShaderFile, char* fragmentShaderFile);
     
+    /**
+     * Adds a shader program to shaders using given sources
+     *
+     * @param vertexShaderData Vertex shader source
+     * @param vertexShaderSize Size of the vertex shader source
+     * @param fragmentShaderData Fragment shader source
+     * @param fragmentShaderSize Size of the fragment shader source
+     * @param name Name of the program in messages
+     * @return index of the program for useShader
+     */
+    GLuint addShaderProgram(const GLchar* vertexShaderData, GLint vertexShaderSize, const GLchar* fragmentShaderData, GLint fragmentShaderSize, const std::string& name);
+    
     
     /**
      * Adds a shader program to shaders using given source files
@@ -151,47 +214,108 @@ public:
      */
     void addShaderProgram(char* vertexShaderFile, char* geometryShaderFile, char* fragmentShaderFile);
     
+    /**
+     * Adds a compute program to shaders, needs supportsIndirectDraw. Compute programs are
+     * compiled right away and are not stored in the shader cache
+     *
+     * @param computeShaderFile File containing compute shader source
+     * @return index of the program for useShader
+     */
+    GLuint addComputeProgram(char* computeShaderFile);
+    
+    /**
+     * Returns true if the context has compute shaders, shader storage buffers and
+     * glMultiDrawElementsIndirect, i.e. OpenGL 4.3
+     */
+    inline bool supportsIndirectDraw() const {
+        return m_IndirectDraw;
+    }
+    
+    /**
+     * Starts a batch of shader programs. Programs added until finishShaderPrograms only submit
+     * their compile and link, so the driver can work on all of them at once, in parallel with
+     * GL_KHR_parallel_shader_compile
+     */
+    void beginShaderPrograms();
+    
+    /**
+     * Waits for all submitted programs, checks their status and ends the batch
+     */
+    void finishShaderPrograms();
+    
+    inline const ShaderStatistics& getShaderStatistics() const {
+        return m_ShaderStatistics;
+    }
+    
+    /**
+     * Prints how many programs came from source and from the binary cache and how long each took
+     */
+    void printShaderStatistics() const;
+    
     /**
      * Use a given shader for rendering
      */
     void useShader() {
         m_CurrentShader = 0;
-        glUseProgram(m_Shaders[0]->m_Id);
+        useProgram(m_Shaders[0]->m_Id);
     }
     
     void useShader(GLuint index){
         m_CurrentShader = index;
-        glUseProgram(m_Shaders[index]->m_Id);
+        useProgram(m_Shaders[index]->m_Id);
     }
     
     GLuint GetShaderId(){
         return m_Shaders[0]->m_Id;
     }
     
-    void setVec3(const glm::vec3& vector, const GLchar* uniformName){
-        glUniform3f(m_Shaders[m_CurrentShader]->getLocation(uniformName), vector.x, vector.y, vector.z);
+    void setVec3(const glm::vec3& vector, UniformId uniform){
+        glUniform3f(m_Shaders[m_CurrentShader]->getLocation(uniform), vector.x, vector.y, vector.z);
+    }
+    
+    void setVec2(const glm::vec2& vector, UniformId uniform){
+        glUniform2f(m_Shaders[m_CurrentShader]->getLocation(uniform), vector.x, vector.y);
     }
     
-    void setFloat(GLfloat value, const GLchar* uniformName){
-        glUniform1f(m_Shaders[m_CurrentShader]->getLocation(uniformName), value);
+    void setFloat(GLfloat value, UniformId uniform){
+        glUniform1f(m_Shaders[m_CurrentShader]->getLocation(uniform), value);
+    }
+    
+    void setUint(GLuint value, UniformId uniform){
+        glUniform1ui(m_Shaders[m_CurrentShader]->getLocation(uniform), value);
+    }
+    
+    void setVec4(const glm::vec4& vector, UniformId uniform){
+        glUniform4f(m_Shaders[m_CurrentShader]->getLocation(uniform), vector.x, vector.y, vector.z, vector.w);
+    }
+    
+    /**
+     * Sets a vec4 array uniform of the current shader
+     *
+     * @param vectors Components of the vectors, four per vector
+     * @param count Number of vectors
+     * @param uniform Identifier of the array uniform in shader, see uniformId
+     */
+    void setVec4Array(const GLfloat* vectors, GLsizei count, UniformId uniform){
+        glUniform4fv(m_Shaders[m_CurrentShader]->getLocation(uniform), count, vectors);
     }
     
     /**
      * Sets texture unit to sampler2D for current shader
      **/
-    void setUniformSampler2D(GLint textureUnit, const GLchar* sampler2Dname){
-        glUniform1i(m_Shaders[m_CurrentShader]->getLocation(sampler2Dname), textureUnit);
-
+    void setUniformSampler2D(GLint textureUnit, UniformId sampler){
+        glUniform1i(m_Shaders[m_CurrentShader]->getLocation(sampler), textureUnit);
+        
     }
     
     /**
      * Sends a given matrix to shader with given uniform name
      *
      * @param matrix Matrix to be sent to shader
-     * @param uniformName Name of the uniform in shader
+     * @param uniform Identifier of the uniform in shader, see uniformId
      */
-    void setMatrix4fUniform(const glm::mat4& matrix, const GLchar* uniformName){
-        glUniformMatrix4fv(m_Shaders[m_CurrentShader]->getLocation(uniformName), 1, GL_FALSE, glm::value_ptr(matrix));
+    void setMatrix4fUniform(const glm::mat4& matrix, UniformId uniform){
+        glUniformMatrix4fv(m_Shaders[m_CurrentShader]->getLocation(uniform), 1, GL_FALSE, glm::value_ptr(matrix));
     }
     
     /**
@@ -199,22 +323,257 @@ public:
      *
      * @param texture Texture id to be bound
      * @param textureUnit Texture unit to bind
-     * @param sampler2Dname Name of the sampler uniform in shader
+     * @param sampler Identifier of the sampler uniform in shader, see uniformId
      * @param value What index should be bound
      */
-    void bindTexture(GLuint texture, GLenum textureUnit, const GLchar* sampler2Dname, GLint value){
-        glActiveTexture(textureUnit);
+    void bindTexture(GLuint texture, GLenum textureUnit, UniformId sampler, GLint value){
+        bindTexture2D(textureUnit - GL_TEXTURE0, texture);
+        setUniformSampler2D(value, sampler);
+    }
+    
+    /**
+     * Forgets the tracked state so that the next calls reach GL. Call after code that
+     * changes the state directly, e.g. resource loading
+     */
+    void invalidateState(){
+        m_BoundProgram = UNKNOWN_STATE;
+        m_BoundVertexArray = UNKNOWN_STATE;
+        m_ActiveTextureUnit = UNKNOWN_STATE;
+        m_DepthFunc = UNKNOWN_STATE;
+        m_PolygonMode = UNKNOWN_STATE;
+        m_BoundMaterial = UNKNOWN_STATE;
+        
+        for(GLuint i = 0; i < MAX_TEXTURE_UNITS; i++){
+            m_BoundTextures[i] = UNKNOWN_STATE;
+        }
+        
+        for(GLuint i = 0; i < 4; i++){
+            m_Viewport[i] = UNKNOWN_STATE;
+        }
+    }
+    
+    /**
+     * Takes a program into use unless it is in use already
+     *
+     * @return true if the call reached GL
+     */
+    bool useProgram(GLuint program){
+        if(!changeState(m_BoundProgram, program))
+            return false;
+        glUseProgram(program);
+        return true;
+    }
+    
+    /**
+     * Binds a vertex array unless it is bound already
+     *
+     * @return true if the call reached GL
+     */
+    bool bindVertexArray(GLuint vertexArray){
+        if(!changeState(m_BoundVertexArray, vertexArray))
+            return false;
+        glBindVertexArray(vertexArray);
+        return true;
+    }
+    
+    /**
+     * Selects the active texture unit unless it is active already
+     *
+     * @param unit Texture unit index, 0 for GL_TEXTURE0
+     * @return true if the call reached GL
+     */
+    bool activeTexture(GLuint unit){
+        if(!changeState(m_ActiveTextureUnit, unit))
+            return false;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        return true;
+    }
+    
+    /**
+     * Binds a 2D texture to a texture unit unless it is bound already
+     *
+     * @param unit Texture unit index, 0 for GL_TEXTURE0
+     * @param texture Texture id, 0 to unbind
+     * @return true if the call reached GL
+     */
+    bool bindTexture2D(GLuint unit, GLuint texture){
+        
+        // untracked units always go through
+        if(unit >= MAX_TEXTURE_UNITS){
+            activeTexture(unit);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            m_StateStatistics.m_Issued++;
+            return true;
+        }
+        
+        if(!changeState(m_BoundTextures[unit], texture))
+            return false;
+        
+        activeTexture(unit);
         glBindTexture(GL_TEXTURE_2D, texture);
-        setUniformSampler2D(value, sampler2Dname);
+        return true;
     }
     
     /**
-     * Adds an uniform with given name to current shader
-     * 
-     * @param uniformName Name of the uniform to be added to the shader
+     * Sets the depth comparison unless it is set already
+     *
+     * @return true if the call reached GL
+     */
+    bool depthFunc(GLenum func){
+        if(!changeState(m_DepthFunc, func))
+            return false;
+        glDepthFunc(func);
+        return true;
+    }
+    
+    /**
+     * Sets the polygon mode of both faces unless it is set already
+     *
+     * @return true if the call reached GL
+     */
+    bool polygonMode(GLenum mode){
+        if(!changeState(m_PolygonMode, mode))
+            return false;
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+        return true;
+    }
+    
+    /**
+     * Sets the viewport unless it is set already
+     *
+     * @return true if the call reached GL
+     */
+    bool viewport(GLint x, GLint y, GLsizei width, GLsizei height){
+        
+        if(m_Viewport[0] == (GLuint) x && m_Viewport[1] == (GLuint) y && m_Viewport[2] == (GLuint) width && m_Viewport[3] == (GLuint) height){
+            m_StateStatistics.m_Suppressed++;
+            return false;
+        }
+        
+        m_Viewport[0] = x;
+        m_Viewport[1] = y;
+        m_Viewport[2] = width;
+        m_Viewport[3] = height;
+        
+        glViewport(x, y, width, height);
+        m_StateStatistics.m_Issued++;
+        return true;
+    }
+    
+    inline const StateStatistics& getStateStatistics() const {
+        return m_StateStatistics;
+    }
+    
+    inline void resetStateStatistics(){
+        m_StateStatistics.reset();
+    }
+    
+    /**
+     * Creates the uniform buffers shared by all shader programs
      */
-    void addUniform(const GLchar* uniformName){
-        m_Shaders[m_CurrentShader]->addUniform(uniformName);
+    void createUniformBuffers(){
+        
+        m_FrameUniforms.create(sizeof(FrameUniforms), FRAME_UNIFORMS_BINDING);
+        m_LightUniforms.create(sizeof(LightUniforms), LIGHT_UNIFORMS_BINDING);
+        
+        // material slots are bound with glBindBufferRange, so they start at aligned offsets
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        m_MaterialStride = ((GLuint) sizeof(MaterialUniforms) + alignment - 1) / alignment * alignment;
+        
+        glGenBuffers(1, &m_MaterialBuffer);
+        m_MaterialCapacity = 0;
+        m_BoundMaterial = UNKNOWN_STATE;
+    }
+    
+    /**
+     * Uploads camera and shadow data of the frame
+     *
+     * @param frame Frame uniforms
+     */
+    void updateFrameUniforms(const FrameUniforms& frame){
+        m_FrameUniforms.update(&frame);
+    }
+    
+    /**
+     * Fills camera data from the current render context and uploads the frame uniforms
+     *
+     * @param lightSpaceMatrix Matrix of the shadow casting light
+     */
+    void updateFrameUniforms(const glm::mat4& lightSpaceMatrix){
+        
+        RenderContext& rc = m_RenderContexts[m_CurrentRenderContext];
+        
+        FrameUniforms frame;
+        frame.m_View = rc.m_Camera.view();
+        frame.m_Projection = rc.m_Projection;
+        frame.m_LightSpaceMatrix = lightSpaceMatrix;
+        frame.m_ViewPos = rc.m_Camera.m_Position;
+        frame.m_Padding = 0.0f;
+        
+        updateFrameUniforms(frame);
+    }
+    
+    /**
+     * Uploads the lights of the frame
+     *
+     * @param lights Light uniforms
+     */
+    void updateLightUniforms(const LightUniforms& lights){
+        m_LightUniforms.update(&lights);
+    }
+    
+    /**
+     * Returns the slot of material constants in the material buffer, equal constants share a slot
+     *
+     * @param material Material constants
+     * @return slot for bindMaterialUniforms
+     */
+    GLuint addMaterialUniforms(const MaterialUniforms& material){
+        
+        for(GLuint i = 0; i < m_Materials.size(); i++){
+            if(m_Materials[i].m_Shininess == material.m_Shininess)
+                return i;
+        }
+        
+        m_Materials.push_back(material);
+        
+        // grow the buffer and upload all slots again
+        if(m_Materials.size() > m_MaterialCapacity){
+            
+            m_MaterialCapacity = std::max<GLuint>(16, 2 * m_MaterialCapacity);
+            
+            std::vector<GLubyte> data(m_MaterialCapacity * m_MaterialStride, 0);
+            for(GLuint i = 0; i < m_Materials.size(); i++){
+                memcpy(&data[i * m_MaterialStride], &m_Materials[i], sizeof(MaterialUniforms));
+            }
+            
+            glBindBuffer(GL_UNIFORM_BUFFER, m_MaterialBuffer);
+            glBufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+            
+            // the old range binding refers to the previous storage
+            m_BoundMaterial = UNKNOWN_STATE;
+        } else {
+            glBindBuffer(GL_UNIFORM_BUFFER, m_MaterialBuffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, (m_Materials.size() - 1) * m_MaterialStride, sizeof(MaterialUniforms), &material);
+        }
+        
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        
+        return (GLuint) m_Materials.size() - 1;
+    }
+    
+    /**
+     * Attaches a material slot to the material binding point unless it is attached already
+     *
+     * @param slot Slot returned by addMaterialUniforms
+     * @return true if the call reached GL
+     */
+    bool bindMaterialUniforms(GLuint slot){
+        if(!changeState(m_BoundMaterial, slot))
+            return false;
+        glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_UNIFORMS_BINDING, m_MaterialBuffer, slot * m_MaterialStride, sizeof(MaterialUniforms));
+        return true;
     }
     
     void setCurrentShader(GLint index){
@@ -230,6 +589,13 @@ public:
         return m_RenderContexts[m_CurrentRenderContext];
     }
     
+    /**
+     * Returns the index of the current render context
+     */
+    inline GLuint getCurrentRenderContextIndex() const {
+        return m_CurrentRenderContext;
+    }
+    
     /**
      * Returns render context of certain index 
      * 
@@ -264,9 +630,46 @@ public:
     inline ShaderProgram* getCurrentShader(){
         return m_Shaders[m_CurrentShader];
     }
+
+
+private:
     
+    static const GLuint UNKNOWN_STATE = 0xFFFFFFFF; ///< state not known to the cache
     
-private:
+    /**
+     * Program whose compile and link have been submitted but not checked
+     */
+    class PendingShaderProgram {
+    public:
+        ShaderProgram* m_Program;
+        uint64_t m_Key; ///< shader cache key
+        std::string m_Name; ///< vertex shader file or variant for messages
+    };
+    
+    /**
+     * Checks a submitted program, stores its binary in the shader cache and binds its uniform blocks
+     */
+    void finishShaderProgram(const PendingShaderProgram& pending);
+    
+    /**
+     * Attaches the shared uniform blocks of a program to their binding points
+     */
+    void bindUniformBlocks(ShaderProgram* program);
+    
+    /**
+     * Updates a tracked value and counts the call
+     *
+     * @return false if the value was already current
+     */
+    inline bool changeState(GLuint& current, GLuint value){
+        if(current == value){
+            m_StateStatistics.m_Suppressed++;
+            return false;
+        }
+        current = value;
+        m_StateStatistics.m_Issued++;
+        return true;
+    }
     
     SDL_GLContext m_Context; ///< SDL GL context
     SDL_Window* m_Window; // window for rendering
@@ -278,10 +681,34 @@ private:
     ResourceManager m_ResourceManager; ///< resource managing
     
     std::vector<ShaderProgram*> m_Shaders; ///< shaders
+    ShaderCache m_ShaderCache; ///< program binaries of earlier runs
+    ShaderStatistics m_ShaderStatistics; ///< cold and warm setup times
+    std::vector<PendingShaderProgram> m_PendingShaders; ///< programs submitted in the current batch
+    GLboolean m_BatchingShaders; ///< true between beginShaderPrograms and finishShaderPrograms
+    GLboolean m_ParallelShaderCompile; ///< GL_KHR_parallel_shader_compile is available
+    GLboolean m_IndirectDraw; ///< compute culling and indirect draws are available
     GLuint m_CurrentShader; ///< current shader index
-
+    
+    // shadow copy of the GL state
+    GLuint m_BoundProgram; ///< program in use
+    GLuint m_BoundVertexArray; ///< bound vertex array
+    GLuint m_ActiveTextureUnit; ///< active texture unit index
+    GLuint m_BoundTextures[MAX_TEXTURE_UNITS]; ///< 2D texture of each unit
+    GLuint m_DepthFunc; ///< depth comparison
+    GLuint m_PolygonMode; ///< polygon mode of both faces
+    GLuint m_Viewport[4]; ///< viewport x, y, width and height
+    StateStatistics m_StateStatistics; ///< issued and suppressed state changes
+    
+    UniformBuffer m_FrameUniforms; ///< camera and shadow data
+    UniformBuffer m_LightUniforms; ///< lights
+    GLuint m_MaterialBuffer; ///< material constants, one aligned slot per distinct material
+    GLuint m_MaterialStride; ///< bytes between material slots
+    GLuint m_MaterialCapacity; ///< slots allocated in the material buffer
+    GLuint m_BoundMaterial; ///< slot attached to the material binding point
+    std::vector<MaterialUniforms> m_Materials; ///< contents of the material slots
+    
 };
-
-}
     
+}
+
 #endif /* GLContext_h */
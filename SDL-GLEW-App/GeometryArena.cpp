@@ -0,0 +1,153 @@
+//
+//  GeometryArena.cpp
+//  SDL-GLEW-App
+//
+
+#include <algorithm>
+
+#include "GeometryArena.h"
+
+namespace Fox {
+    
+    void GeometryArena::allocate(const GLvoid* vertices, GLuint vertexCount, const GLvoid* indices, GLuint indexBytes, Allocation& allocation){
+        
+        GLuint indexSize = (indexBytes + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+        
+        GLint page = -1;
+        GLuint vertexOffset = 0;
+        GLuint indexOffset = 0;
+        
+        for(GLuint i = 0; i < m_Pages.size() && page < 0; i++){
+            
+            if(!take(m_Pages[i].m_FreeVertices, vertexCount, vertexOffset))
+                continue;
+            
+            if(!take(m_Pages[i].m_FreeIndices, indexSize, indexOffset)){
+                give(m_Pages[i].m_FreeVertices, vertexOffset, vertexCount);
+                continue;
+            }
+            
+            page = (GLint) i;
+        }
+        
+        if(page < 0){
+            
+            page = (GLint) addPage(std::max(vertexCount, PAGE_VERTICES), std::max(indexSize, PAGE_INDEX_BYTES));
+            
+            take(m_Pages[page].m_FreeVertices, vertexCount, vertexOffset);
+            take(m_Pages[page].m_FreeIndices, indexSize, indexOffset);
+        }
+        
+        allocation.m_Page = page;
+        allocation.m_BaseVertex = vertexOffset;
+        allocation.m_VertexCount = vertexCount;
+        allocation.m_IndexOffset = indexOffset;
+        allocation.m_IndexBytes = indexSize;
+        
+        // the copy target leaves the array buffer and the element buffer of the bound vertex array alone
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Pages[page].m_Vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr) vertexOffset * m_VertexSize, (GLsizeiptr) vertexCount * m_VertexSize, vertices);
+        
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Pages[page].m_Ibo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr) indexOffset, (GLsizeiptr) indexBytes, indices);
+        
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    
+    void GeometryArena::free(Allocation& allocation){
+        
+        if(allocation.m_Page < 0)
+            return;
+        
+        Page& page = m_Pages[allocation.m_Page];
+        
+        give(page.m_FreeVertices, allocation.m_BaseVertex, allocation.m_VertexCount);
+        give(page.m_FreeIndices, allocation.m_IndexOffset, allocation.m_IndexBytes);
+        
+        allocation = Allocation();
+    }
+    
+    bool GeometryArena::take(std::vector<Range>& freeList, GLuint size, GLuint& offset){
+        
+        for(GLuint i = 0; i < freeList.size(); i++){
+            
+            Range& range = freeList[i];
+            
+            if(range.m_Size < size)
+                continue;
+            
+            offset = range.m_Offset;
+            range.m_Offset += size;
+            range.m_Size -= size;
+            
+            if(range.m_Size == 0)
+                freeList.erase(freeList.begin() + i);
+            
+            return true;
+        }
+        
+        return false;
+    }
+    
+    void GeometryArena::give(std::vector<Range>& freeList, GLuint offset, GLuint size){
+        
+        if(size == 0)
+            return;
+        
+        auto next = std::lower_bound(freeList.begin(), freeList.end(), offset, [](const Range& range, GLuint offset) {
+            return range.m_Offset < offset;
+        });
+        
+        // merge with the range before
+        if(next != freeList.begin() && (next - 1)->m_Offset + (next - 1)->m_Size == offset){
+            
+            auto previous = next - 1;
+            previous->m_Size += size;
+            
+            // and with the range after
+            if(next != freeList.end() && previous->m_Offset + previous->m_Size == next->m_Offset){
+                previous->m_Size += next->m_Size;
+                freeList.erase(next);
+            }
+            
+            return;
+        }
+        
+        // merge with the range after
+        if(next != freeList.end() && offset + size == next->m_Offset){
+            next->m_Offset = offset;
+            next->m_Size += size;
+            return;
+        }
+        
+        freeList.insert(next, Range(offset, size));
+    }
+    
+    GLuint GeometryArena::addPage(GLuint vertexCapacity, GLuint indexCapacity){
+        
+        Page page;
+        
+        glGenBuffers(1, &page.m_Vbo);
+        glGenBuffers(1, &page.m_Ibo);
+        glGenVertexArrays(1, &page.m_Vao);
+        
+        glBindVertexArray(page.m_Vao);
+        
+        glBindBuffer(GL_ARRAY_BUFFER, page.m_Vbo);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) vertexCapacity * m_VertexSize, NULL, GL_STATIC_DRAW);
+        
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.m_Ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) indexCapacity, NULL, GL_STATIC_DRAW);
+        
+        m_SetAttributes();
+        
+        glBindVertexArray(0);
+        
+        page.m_FreeVertices.push_back(Range(0, vertexCapacity));
+        page.m_FreeIndices.push_back(Range(0, indexCapacity));
+        
+        m_Pages.push_back(page);
+        
+        return (GLuint) m_Pages.size() - 1;
+    }
+}
@@ -0,0 +1,140 @@
+//
+//  GeometryArena.h
+//  SDL-GLEW-App
+//
+
+#ifndef GeometryArena_h
+#define GeometryArena_h
+
+#include <GL/glew.h>
+
+#include <vector>
+
+namespace Fox {
+    
+    /**
+     * Large vertex and index buffers of one vertex format shared by many meshes. Each page has
+     * one vertex array, meshes get ranges of its buffers from first fit free lists and are drawn
+     * with a base vertex, so drawing meshes of the same page needs no vertex array changes
+     */
+    class GeometryArena {
+    
+    public:
+        
+        static const GLuint PAGE_VERTICES = 1 << 20; ///< vertices of a page, larger meshes get a page of their own
+        static const GLuint PAGE_INDEX_BYTES = 1 << 23; ///< index bytes of a page
+        static const GLuint INDEX_ALIGNMENT = 4; ///< index ranges start at multiples of this, any index type can be read from them
+        
+        /**
+         * Sets the vertex attributes of the bound vertex array for the bound array buffer
+         */
+        typedef void (*AttributeSetup)();
+        
+        /**
+         * Ranges of a mesh in the buffers of a page
+         */
+        class Allocation {
+        public:
+            
+            Allocation() : m_Page(-1), m_BaseVertex(0), m_VertexCount(0), m_IndexOffset(0), m_IndexBytes(0) {}
+            
+            GLint m_Page; ///< -1 if nothing is allocated
+            GLuint m_BaseVertex; ///< first vertex
+            GLuint m_VertexCount;
+            GLuint m_IndexOffset; ///< first byte in the index buffer
+            GLuint m_IndexBytes; ///< bytes taken from the index buffer
+        };
+        
+        /**
+         * Creates an empty arena, pages are created when needed
+         *
+         * @param vertexSize Size of one vertex
+         * @param setAttributes Attribute setup of the vertex format
+         */
+        GeometryArena(GLuint vertexSize, AttributeSetup setAttributes) : m_VertexSize(vertexSize), m_SetAttributes(setAttributes) {}
+        
+        /**
+         * Copies vertices and indices of a mesh to the arena
+         *
+         * @param vertices Vertex data
+         * @param vertexCount Number of vertices
+         * @param indices Index data, relative to the first vertex of the mesh
+         * @param indexBytes Size of the index data
+         * @param allocation Receives the ranges of the mesh
+         */
+        void allocate(const GLvoid* vertices, GLuint vertexCount, const GLvoid* indices, GLuint indexBytes, Allocation& allocation);
+        
+        /**
+         * Returns the ranges of a mesh to the free lists
+         *
+         * @param allocation Ranges from allocate, reset to nothing
+         */
+        void free(Allocation& allocation);
+        
+        inline GLuint getVertexArray(const Allocation& allocation) const {
+            return m_Pages[allocation.m_Page].m_Vao;
+        }
+        
+        inline GLuint getVertexBuffer(const Allocation& allocation) const {
+            return m_Pages[allocation.m_Page].m_Vbo;
+        }
+        
+        /**
+         * Returns number of pages, each has a vertex array and two buffers
+         */
+        inline GLuint getPageCount() const {
+            return (GLuint) m_Pages.size();
+        }
+    
+    private:
+        
+        /**
+         * Free part of a buffer
+         */
+        class Range {
+        public:
+            
+            Range(GLuint offset, GLuint size) : m_Offset(offset), m_Size(size) {}
+            
+            GLuint m_Offset;
+            GLuint m_Size;
+        };
+        
+        /**
+         * Vertex array with its vertex and index buffers
+         */
+        class Page {
+        public:
+            GLuint m_Vao;
+            GLuint m_Vbo;
+            GLuint m_Ibo;
+            std::vector<Range> m_FreeVertices; ///< free vertex ranges ordered by offset
+            std::vector<Range> m_FreeIndices; ///< free index byte ranges ordered by offset
+        };
+        
+        /**
+         * Takes the first free range that is large enough
+         *
+         * @return false if there is none
+         */
+        static bool take(std::vector<Range>& freeList, GLuint size, GLuint& offset);
+        
+        /**
+         * Returns a range to a free list, merging it with its free neighbours
+         */
+        static void give(std::vector<Range>& freeList, GLuint offset, GLuint size);
+        
+        /**
+         * Creates a page
+         *
+         * @return index of the page
+         */
+        GLuint addPage(GLuint vertexCapacity, GLuint indexCapacity);
+        
+        GLuint m_VertexSize; ///< size of one vertex
+        AttributeSetup m_SetAttributes; ///< vertex format
+        std::vector<Page> m_Pages;
+    };
+}
+
+#endif /* GeometryArena_h */
@@ -0,0 +1,118 @@
+//
+//  HeightField.cpp
+//  SDL-GLEW-App
+//
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "HeightField.h"
+#include "Texture.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Fox {
+    
+    static const GLfloat RED_WEIGHT = 0.21f;
+    static const GLfloat GREEN_WEIGHT = 0.72f;
+    static const GLfloat BLUE_WEIGHT = 0.07f;
+    
+    /**
+     * Converts a row of ARGB8888 pixels to heights. Luminance is truncated to whole levels
+     * before scaling, like the height maps have always been read
+     *
+     * @param pixels Pixels of the row
+     * @param count Number of pixels
+     * @param heights Receives the heights
+     */
+    static void convertRow(const Uint32* pixels, GLint count, GLfloat* heights){
+        
+        const GLfloat scale = HeightField::HEIGHT_SCALE / 255.0f;
+        const GLfloat offset = HeightField::HEIGHT_OFFSET;
+        
+        GLint x = 0;
+
+#if defined(__SSE2__)
+        
+        const __m128i byteMask = _mm_set1_epi32(0xff);
+        const __m128 red = _mm_set1_ps(RED_WEIGHT);
+        const __m128 green = _mm_set1_ps(GREEN_WEIGHT);
+        const __m128 blue = _mm_set1_ps(BLUE_WEIGHT);
+        const __m128 scales = _mm_set1_ps(scale);
+        const __m128 offsets = _mm_set1_ps(offset);
+        
+        // four pixels at a time, channels are picked out of the 32 bit values
+        for(; x + 4 <= count; x += 4){
+            
+            __m128i p = _mm_loadu_si128((const __m128i*) (pixels + x));
+            
+            __m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), byteMask));
+            __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), byteMask));
+            __m128 b = _mm_cvtepi32_ps(_mm_and_si128(p, byteMask));
+            
+            __m128 luminance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, red), _mm_mul_ps(g, green)), _mm_mul_ps(b, blue));
+            luminance = _mm_cvtepi32_ps(_mm_cvttps_epi32(luminance));
+            
+            _mm_storeu_ps(heights + x, _mm_add_ps(_mm_mul_ps(luminance, scales), offsets));
+        }
+
+#endif
+        
+        for(; x < count; x++){
+            
+            Uint32 p = pixels[x];
+            
+            GLfloat luminance = RED_WEIGHT * ((p >> 16) & 0xff) + GREEN_WEIGHT * ((p >> 8) & 0xff) + BLUE_WEIGHT * (p & 0xff);
+            heights[x] = (GLfloat) (GLint) luminance * scale + offset;
+        }
+    }
+    
+    bool HeightField::load(const GLchar* filePath) {
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        
+        GLboolean hasAlpha;
+        SDL_Surface* image = Texture::decode(filePath, hasAlpha);
+        
+        if(!image)
+            return false;
+        
+        m_Width = image->w;
+        m_Depth = image->h;
+        m_Heights.resize((size_t) m_Width * m_Depth);
+        
+        // rows may be padded, each one is converted on its own
+        for(GLint z = 0; z < m_Depth; z++){
+            const Uint32* row = (const Uint32*) ((const Uint8*) image->pixels + z * image->pitch);
+            convertRow(row, m_Width, m_Heights.data() + z * m_Width);
+        }
+        
+        Texture::freeTexture(image);
+        
+        std::cout << filePath << " height field decoded in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+        
+        return true;
+    }
+    
+    GLfloat HeightField::sampleHeight(GLfloat worldX, GLfloat worldZ) const {
+        
+        if(m_Heights.empty())
+            return 0.0f;
+        
+        GLfloat x = worldX + m_Width / 2;
+        GLfloat z = worldZ + m_Depth / 2;
+        
+        GLint x0 = (GLint) std::floor(x);
+        GLint z0 = (GLint) std::floor(z);
+        GLfloat fx = x - x0;
+        GLfloat fz = z - z0;
+        
+        GLfloat front = heightAt(x0, z0) + (heightAt(x0 + 1, z0) - heightAt(x0, z0)) * fx;
+        GLfloat back = heightAt(x0, z0 + 1) + (heightAt(x0 + 1, z0 + 1) - heightAt(x0, z0 + 1)) * fx;
+        
+        return front + (back - front) * fz;
+    }
+}
@@ -0,0 +1,94 @@
+//
+//  HeightField.h
+//  SDL-GLEW-App
+//
+
+#ifndef HeightField_h
+#define HeightField_h
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace Fox {
+    
+    /**
+     * Heights of a height map image in world units, decoded once and shared by the terrain,
+     * the ground mesh and object placement. Sample (x, z) lies at world position
+     * (x - width/2, z - depth/2), x along the image rows and z along its columns
+     */
+    class HeightField {
+    
+    public:
+        
+        static constexpr GLfloat HEIGHT_SCALE = 100.0f; ///< height of white above black
+        static constexpr GLfloat HEIGHT_OFFSET = -100.0f; ///< height of black
+        
+        HeightField() : m_Width(0), m_Depth(0) {}
+        
+        /**
+         * Creates a height field from heights, e.g. generated ones
+         *
+         * @param width Samples per row
+         * @param depth Number of rows
+         * @param heights Heights in world units, row after row
+         */
+        HeightField(GLint width, GLint depth, const std::vector<GLfloat>& heights) : m_Width(width), m_Depth(depth), m_Heights(heights) {}
+        
+        /**
+         * Decodes a height map image, the luminance of each pixel maps to a height
+         *
+         * @param filePath File path of the image
+         * @return false if the image could not be read
+         */
+        bool load(const GLchar* filePath);
+        
+        /**
+         * Returns the height of a sample, coordinates are clamped to the field
+         *
+         * @param x Sample column
+         * @param z Sample row
+         */
+        inline GLfloat heightAt(GLint x, GLint z) const {
+            x = std::max(0, std::min(x, m_Width - 1));
+            z = std::max(0, std::min(z, m_Depth - 1));
+            return m_Heights[z * m_Width + x];
+        }
+        
+        /**
+         * Returns the height at a world position, bilinearly interpolated between samples
+         *
+         * @param worldX World x coordinate
+         * @param worldZ World z coordinate
+         */
+        GLfloat sampleHeight(GLfloat worldX, GLfloat worldZ) const;
+        
+        /**
+         * Returns the heights, row after row
+         */
+        inline const GLfloat* data() const {
+            return m_Heights.data();
+        }
+        
+        inline GLint getWidth() const {
+            return m_Width;
+        }
+        
+        inline GLint getDepth() const {
+            return m_Depth;
+        }
+        
+        inline bool empty() const {
+            return m_Heights.empty();
+        }
+    
+    private:
+        
+        GLint m_Width; ///< samples per row
+        GLint m_Depth; ///< number of rows
+        std::vector<GLfloat> m_Heights; ///< height of each sample in world units
+    };
+}
+
+#endif /* HeightField_h */
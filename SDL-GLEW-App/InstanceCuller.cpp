@@ -0,0 +1,147 @@
+//
+//  InstanceCuller.cpp
+//  SDL-GLEW-App
+//
+
+#include <cstddef>
+
+#include "InstanceCuller.h"
+
+namespace Fox {
+    
+    void InstanceCuller::create(GLuint program, const DrawElementsIndirectCommand& command, const BoundingSphere& bounds, const glm::mat4& dequantize, const std::vector<glm::vec3>& positions){
+        
+        release();
+        
+        m_Program = program;
+        m_InstanceCount = (GLuint) positions.size();
+        m_BoundingSphere = glm::vec4(bounds.m_Center, bounds.m_Radius);
+        m_Dequantize = dequantize;
+        
+        // vec3 arrays are padded to vec4 in std430
+        std::vector<glm::vec4> padded(positions.size());
+        glm::vec3 center;
+        
+        for(GLuint i = 0; i < positions.size(); i++){
+            padded[i] = glm::vec4(positions[i], 1.0f);
+            center += positions[i];
+        }
+        
+        m_Center = (positions.empty() ? center : center / (GLfloat) positions.size()) + bounds.m_Center;
+        
+        DrawElementsIndirectCommand initial = command;
+        initial.m_InstanceCount = 0;
+        initial.m_BaseInstance = 0;
+        
+        glGenBuffers(1, &m_PositionBuffer);
+        glGenBuffers(1, &m_TransformBuffer);
+        glGenBuffers(1, &m_CommandBuffer);
+        
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_PositionBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4) * padded.size(), (const GLvoid*) padded.data(), GL_STATIC_DRAW);
+        
+        // written by the compute shader, read as instance attributes
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_TransformBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4) * (positions.empty() ? 1 : positions.size()), NULL, GL_DYNAMIC_COPY);
+        
+        // the counts of the occlusion test follow the command
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_CommandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawElementsIndirectCommand) + 2 * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(DrawElementsIndirectCommand), (const GLvoid*) &initial);
+        
+        resetStatistics();
+    }
+    
+    void InstanceCuller::release(){
+        
+        if(m_CommandBuffer == 0)
+            return;
+        
+        glDeleteBuffers(1, &m_PositionBuffer);
+        glDeleteBuffers(1, &m_TransformBuffer);
+        glDeleteBuffers(1, &m_CommandBuffer);
+        
+        m_PositionBuffer = m_TransformBuffer = m_CommandBuffer = 0;
+        m_InstanceCount = 0;
+    }
+    
+    void InstanceCuller::cull(GLContext* gl, const Frustum& frustum, const OcclusionCuller* occlusion, GLuint depthTexture){
+        
+        // visible instances are counted from zero again
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_CommandBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsetof(DrawElementsIndirectCommand, m_InstanceCount), sizeof(GLuint), &zero);
+        
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITION_BINDING, m_PositionBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_BINDING, m_TransformBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_CommandBuffer);
+        
+        gl->useShader(m_Program);
+        gl->setVec4Array(frustum.getPlanes(), 6, UNIFORM_FRUSTUM_PLANES);
+        gl->setVec4(m_BoundingSphere, UNIFORM_BOUNDING_SPHERE);
+        gl->setMatrix4fUniform(m_Dequantize, UNIFORM_DEQUANTIZE);
+        gl->setUint(m_InstanceCount, UNIFORM_INSTANCE_COUNT);
+        
+        // nothing is hidden before the first occlusion render
+        bool occlusionTest = occlusion != nullptr && occlusion->isRendered();
+        gl->setUint(occlusionTest ? 1 : 0, UNIFORM_OCCLUSION);
+        
+        if(occlusionTest){
+            gl->setMatrix4fUniform(occlusion->getClip(), UNIFORM_OCCLUSION_CLIP);
+            gl->bindTexture(depthTexture, GL_TEXTURE0 + DEPTH_UNIT, UNIFORM_OCCLUSION_DEPTH, DEPTH_UNIT);
+        }
+        
+        glDispatchCompute((m_InstanceCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+        
+        // the command is read by the indirect draw and the transforms by the vertex fetch
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+    
+    void InstanceCuller::resetStatistics(){
+        
+        GLuint zero[2] = {0, 0};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_CommandBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawElementsIndirectCommand), sizeof(zero), zero);
+    }
+    
+    void InstanceCuller::readStatistics(OcclusionCuller::Statistics& statistics) const {
+        
+        if(m_CommandBuffer == 0)
+            return;
+        
+        // the counters are written by the shader, not through the buffer binding
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        
+        GLuint counts[2];
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_CommandBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawElementsIndirectCommand), sizeof(counts), counts);
+        
+        statistics.m_Visible += counts[0];
+        statistics.m_Occluded += counts[1];
+    }
+    
+    GLuint InstanceCuller::createDepthTexture(GLContext* gl){
+        
+        GLuint texture;
+        glGenTextures(1, &texture);
+        gl->bindTexture2D(DEPTH_UNIT, texture);
+        
+        // immutable storage is complete without the levels between the pixels and the tiles
+        glTexStorage2D(GL_TEXTURE_2D, DEPTH_TILE_LEVEL + 1, GL_R32F, OcclusionCuller::WIDTH, OcclusionCuller::HEIGHT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        
+        return texture;
+    }
+    
+    void InstanceCuller::uploadDepth(GLContext* gl, GLuint texture, const OcclusionCuller& occlusion){
+        
+        if(!occlusion.isRendered())
+            return;
+        
+        gl->bindTexture2D(DEPTH_UNIT, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, OcclusionCuller::WIDTH, OcclusionCuller::HEIGHT, GL_RED, GL_FLOAT, occlusion.getDepthBuffer());
+        glTexSubImage2D(GL_TEXTURE_2D, DEPTH_TILE_LEVEL, 0, 0, OcclusionCuller::TILES_X, OcclusionCuller::TILES_Y, GL_RED, GL_FLOAT, occlusion.getTileDepth());
+    }
+}
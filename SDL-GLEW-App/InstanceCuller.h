@@ -0,0 +1,154 @@
+//
+//  InstanceCuller.h
+//  SDL-GLEW-App
+//
+
+#ifndef InstanceCuller_h
+#define InstanceCuller_h
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "GLContext.h"
+#include "Frustum.h"
+#include "BoundingVolume.h"
+#include "OcclusionCuller.h"
+
+namespace Fox {
+    
+    /**
+     * Parameters of one glDrawElementsIndirect draw, laid out as GL reads them from the
+     * indirect buffer
+     */
+    class DrawElementsIndirectCommand {
+    public:
+        GLuint m_Count; ///< indices per instance
+        GLuint m_InstanceCount;
+        GLuint m_FirstIndex; ///< first index in the index buffer, in indices
+        GLint m_BaseVertex;
+        GLuint m_BaseInstance; ///< first transform of the instance buffer
+    };
+    
+    static_assert(sizeof(DrawElementsIndirectCommand) == 5 * sizeof(GLuint), "indirect commands must be tightly packed");
+    
+    /**
+     * Frustum and occlusion culling of the instances of a mesh on the GPU, needs
+     * GLContext::supportsIndirectDraw. The instance positions stay in a shader storage buffer, a
+     * compute shader tests them against the frustum of a pass, optionally against the terrain
+     * depth of an OcclusionCuller, and writes the model matrices of the visible ones together
+     * with their number in an indirect draw command. The CPU work of a pass does not depend on
+     * the number of instances and the visible count only comes back to the CPU for statistics
+     */
+    class InstanceCuller {
+    
+    public:
+        
+        static const GLuint WORK_GROUP_SIZE = 64; ///< local size of Shaders/cullInstances.comp
+        
+        static const GLuint POSITION_BINDING = 0; ///< shader storage binding of the instance positions
+        static const GLuint TRANSFORM_BINDING = 1; ///< shader storage binding of the visible transforms
+        static const GLuint COMMAND_BINDING = 2; ///< shader storage binding of the indirect command
+        
+        static const GLuint DEPTH_UNIT = 0; ///< texture unit of the occlusion depth during a cull
+        static const GLuint DEPTH_TILE_LEVEL = 3; ///< mipmap level of the depth texture holding the tiles
+        
+        static_assert(OcclusionCuller::TILE_SIZE == 1 << DEPTH_TILE_LEVEL, "a tile must be one texel of the tile level");
+        
+        InstanceCuller() : m_Program(0), m_PositionBuffer(0), m_TransformBuffer(0), m_CommandBuffer(0), m_InstanceCount(0) {}
+        
+        /**
+         * Uploads the instances of a mesh and the draw command of their geometry
+         *
+         * @param program Index of the culling compute program in GLContext
+         * @param command Draw command of the mesh, the instance fields are ignored
+         * @param bounds Object space bounding sphere of the mesh
+         * @param dequantize Maps the packed positions of the mesh to object space
+         * @param positions Positions of the instances
+         */
+        void create(GLuint program, const DrawElementsIndirectCommand& command, const BoundingSphere& bounds, const glm::mat4& dequantize, const std::vector<glm::vec3>& positions);
+        
+        /**
+         * Deletes the buffers
+         */
+        void release();
+        
+        /**
+         * Culls the instances against a frustum and the terrain. Draws reading the buffers
+         * afterwards see the result, the previous result must not be needed anymore
+         *
+         * @param gl GLContext
+         * @param frustum Frustum with world space planes
+         * @param occlusion Occlusion culler whose latest render is in depthTexture, nullptr to skip the occlusion test
+         * @param depthTexture Texture made by createDepthTexture and filled by uploadDepth
+         */
+        void cull(GLContext* gl, const Frustum& frustum, const OcclusionCuller* occlusion = nullptr, GLuint depthTexture = 0);
+        
+        /**
+         * Zeroes the counts of occlusion tested instances
+         */
+        void resetStatistics();
+        
+        /**
+         * Reads back the counts of occlusion tested instances since resetStatistics and adds
+         * them to statistics. Waits for the culls in flight, so call it once in a while only
+         *
+         * @param statistics Receives the counts
+         */
+        void readStatistics(OcclusionCuller::Statistics& statistics) const;
+        
+        /**
+         * Creates a texture for the depth of an OcclusionCuller, the pixels in level 0 and
+         * the tiles in DEPTH_TILE_LEVEL
+         *
+         * @param gl GLContext
+         * @return Texture name
+         */
+        static GLuint createDepthTexture(GLContext* gl);
+        
+        /**
+         * Uploads the latest render of an occlusion culler to a texture of createDepthTexture
+         *
+         * @param gl GLContext
+         * @param texture Depth texture
+         * @param occlusion Occlusion culler
+         */
+        static void uploadDepth(GLContext* gl, GLuint texture, const OcclusionCuller& occlusion);
+        
+        /**
+         * Returns the buffer with the model matrices of the visible instances
+         */
+        inline GLuint getTransformBuffer() const {
+            return m_TransformBuffer;
+        }
+        
+        /**
+         * Returns the buffer holding the draw command for GL_DRAW_INDIRECT_BUFFER
+         */
+        inline GLuint getCommandBuffer() const {
+            return m_CommandBuffer;
+        }
+        
+        /**
+         * Returns the world space center of all instances, e.g. for render queue sorting
+         */
+        inline const glm::vec3& getCenter() const {
+            return m_Center;
+        }
+    
+    private:
+        
+        GLuint m_Program; ///< index of the compute program in GLContext
+        GLuint m_PositionBuffer; ///< vec4 position of each instance
+        GLuint m_TransformBuffer; ///< mat4 of each visible instance, room for all of them
+        GLuint m_CommandBuffer; ///< one DrawElementsIndirectCommand followed by the visible and occluded counts
+        GLuint m_InstanceCount;
+        glm::vec4 m_BoundingSphere; ///< object space center and radius
+        glm::mat4 m_Dequantize;
+        glm::vec3 m_Center;
+    };
+}
+
+#endif /* InstanceCuller_h */
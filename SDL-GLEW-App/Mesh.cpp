@@ -15,10 +15,132 @@
 #include "Mesh.h"
 
 namespace Fox {
-
+    
+    void MeshBase::uploadInstances(GLContext* gl, GLuint vao, const std::vector<glm::mat4>& transforms){
+        
+        // the vertex array stays bound for the instanced draw
+        gl->bindVertexArray(vao);
+        
+        if(m_InstanceVbo == 0){
+            glGenBuffers(1, &m_InstanceVbo);
+        }
+        
+        attachInstances(m_InstanceVbo);
+        
+        if(transforms.size() > m_InstanceCapacity){
+            // grow the buffer
+            m_InstanceCapacity = (GLuint) transforms.size();
+            glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * transforms.size(), (const GLvoid*) transforms.data(), GL_STREAM_DRAW);
+        } else {
+            // orphan previous contents so that the driver does not wait for earlier draws
+            glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * m_InstanceCapacity, NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::mat4) * transforms.size(), (const GLvoid*) transforms.data());
+        }
+    }
+    
+    void MeshBase::attachInstances(GLuint buffer){
+        
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        
+        // attach again each time when other meshes of an arena page share the vertex array
+        if(buffer == m_AttachedInstances && m_Arena == nullptr)
+            return;
+        
+        // mat4 attribute takes four consecutive vec4 locations, advanced once per instance
+        for(GLuint i = 0; i < 4; i++){
+            glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + i, 4, GL_FLOAT, false, sizeof(glm::mat4), (GLvoid*) (i * sizeof(glm::vec4)));
+            glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + i);
+            glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + i, 1);
+        }
+        
+        m_AttachedInstances = buffer;
+    }
+    
+    void MeshBase::drawIndirect(){
+        
+        attachInstances(m_IndirectInstances);
+        
+        // the instance count was written by the compute shader and never read back
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectCommands);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, m_IndexType, 0, 1, 0);
+    }
+    
+    void MeshBase::createBuffers(const GLvoid* vertices, GLuint vertexSize, GLuint numVertices, const GLuint* indices, GLuint numIndices, GLenum usage,
+                                 GeometryArena* arena, GeometryArena::AttributeSetup setAttributes, GLuint& vao, GLuint& vbo, GLuint& ibo){
+        
+        std::vector<GLushort> shortIndices;
+        const GLvoid* indexData = indices;
+        
+        // 0xffff is left free, it is the primitive restart index of 16 bit lists
+        if(numVertices < 0xffff){
+            shortIndices.assign(indices, indices + numIndices);
+            indexData = shortIndices.data();
+            m_IndexType = GL_UNSIGNED_SHORT;
+            m_IndexSize = sizeof(GLushort);
+        } else {
+            m_IndexType = GL_UNSIGNED_INT;
+            m_IndexSize = sizeof(GLuint);
+        }
+        
+        // indices stay relative to the mesh, the base vertex moves them to its range
+        if(arena != nullptr){
+            
+            arena->allocate(vertices, numVertices, indexData, numIndices * m_IndexSize, m_Allocation);
+            
+            m_Arena = arena;
+            m_BaseVertex = (GLint) m_Allocation.m_BaseVertex;
+            m_IndexStart = m_Allocation.m_IndexOffset;
+            
+            vao = arena->getVertexArray(m_Allocation);
+            vbo = arena->getVertexBuffer(m_Allocation);
+            ibo = 0;
+            return;
+        }
+        
+        // generate vertex and index buffer objects
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ibo);
+        
+        // create vertex array object
+        glGenVertexArrays(1, &vao);
+        
+        glBindVertexArray(vao);
+        
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) vertexSize * numVertices, vertices, usage);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) m_IndexSize * numIndices, indexData, usage);
+        
+        setAttributes();
+        
+        glBindVertexArray(0);
+    }
+    
+    void MeshBase::releaseBuffers(GLuint& vao, GLuint& vbo, GLuint& ibo){
+        
+        if(m_Arena != nullptr){
+            m_Arena->free(m_Allocation);
+            m_Arena = nullptr;
+        } else {
+            glDeleteVertexArrays(1, &vao);
+            glDeleteBuffers(1, &vbo);
+            glDeleteBuffers(1, &ibo);
+        }
+        
+        if(m_InstanceVbo != 0){
+            glDeleteBuffers(1, &m_InstanceVbo);
+        }
+        
+        vao = vbo = ibo = 0;
+        m_InstanceVbo = 0;
+        m_InstanceCapacity = 0;
+        m_AttachedInstances = 0;
+    }
+    
     template<>
     FMesh<Vertex>::FMesh(std::vector<Vertex>& vertices, GLenum usage) {
-     
+        
         // copy data to vector
         m_Vertices.resize(vertices.size());
         std::copy(vertices.begin(), vertices.end(), m_Vertices.begin());
@@ -73,79 +195,78 @@ namespace Fox {
     }
     
     template<>
-    Mesh<Vertex>::Mesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, GLenum usage){
+    void Mesh<Vertex>::setAttributes(){
         
-        m_Vertices.resize(vertices.size());
-        m_Indices.resize(indices.size());
-        
-        std::copy(vertices.begin(), vertices.end(), m_Vertices.begin());
-        std::copy(indices.begin(), indices.end(), m_Indices.begin());
-        
-        // generate vertex and index buffer objects
-        glGenBuffers(1, &m_Vbo);
-        glGenBuffers(1, &m_Ibo);
-        
-        // create vertex array object
-        glGenVertexArrays(1, &m_Vao);
-        
-        glBindVertexArray(m_Vao);
-        
-        glBindBuffer(GL_ARRAY_BUFFER, m_Vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Ibo);
-        
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * m_Vertices.size(), (const GLvoid*) m_Vertices.data(), usage);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(), (const GLvoid*) m_Indices.data(), usage);
-        
-        glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex), (GLvoid*) 0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(Vertex), (GLvoid*) (3 * sizeof(GLfloat)));
-        glVertexAttribPointer(2, 2, GL_FLOAT, false, sizeof(Vertex), (GLvoid*) (6 * sizeof(GLfloat)));
+        glVertexAttribPointer(0, 3, GL_SHORT, true, sizeof(VertexQPNT), (GLvoid*) 0);
+        glVertexAttribPointer(1, 2, GL_SHORT, true, sizeof(VertexQPNT), (GLvoid*) (4 * sizeof(GLshort)));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, false, sizeof(VertexQPNT), (GLvoid*) (6 * sizeof(GLshort)));
         
         glEnableVertexAttribArray(0);
         glEnableVertexAttribArray(1);
         glEnableVertexAttribArray(2);
-        
-        glBindVertexArray(0);
     }
     
     template<>
-    Mesh<VertexPNTTB>::Mesh(std::vector<VertexPNTTB>& vertices, std::vector<GLuint>& indices, GLenum usage){
+    GeometryArena& Mesh<Vertex>::getArena(){
+        static GeometryArena arena(sizeof(VertexQPNT), &Mesh<Vertex>::setAttributes);
+        return arena;
+    }
     
-        m_Vertices.resize(vertices.size());
-        m_Indices.resize(indices.size());
-        
-        std::copy(vertices.begin(), vertices.end(), m_Vertices.begin());
-        std::copy(indices.begin(), indices.end(), m_Indices.begin());
-        
-        // generate vertex and index buffer objects
-        glGenBuffers(1, &m_Vbo);
-        glGenBuffers(1, &m_Ibo);
+    template<>
+    Mesh<Vertex>::Mesh(const Vertex* vertices, GLuint numVertices, const GLuint* indices, GLuint numIndices, GLenum usage, GLboolean shared) : m_IndexCount((GLsizei) numIndices) {
         
-        // create vertex array object
-        glGenVertexArrays(1, &m_Vao);
+        // pack the vertices, the float data stays on the CPU side only
+        VertexQuantizer quantizer(vertices, numVertices);
+        m_Dequantize = quantizer.getDequantization();
         
-        glBindVertexArray(m_Vao);
+        std::vector<VertexQPNT> packed(numVertices);
+        for(GLuint i = 0; i < numVertices; i++){
+            packed[i] = quantizer.quantize(vertices[i]);
+        }
         
-        glBindBuffer(GL_ARRAY_BUFFER, m_Vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Ibo);
+        createBuffers(packed.data(), sizeof(VertexQPNT), numVertices, indices, numIndices, usage, shared ? &getArena() : nullptr, &setAttributes, m_Vao, m_Vbo, m_Ibo);
         
-        glBufferData(GL_ARRAY_BUFFER, sizeof(VertexPNTTB) * m_Vertices.size(), (const GLvoid*) m_Vertices.data(), usage);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(), (const GLvoid*) m_Indices.data(), usage);
+        m_Lods.push_back(MeshLod(0, numIndices, 0.0f));
+    }
+    
+    template<>
+    void Mesh<VertexPNTTB>::setAttributes(){
         
-        glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(VertexPNTTB), (GLvoid*) 0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(VertexPNTTB), (GLvoid*) (3 * sizeof(GLfloat)));
-        glVertexAttribPointer(2, 2, GL_FLOAT, false, sizeof(VertexPNTTB), (GLvoid*) (6 * sizeof(GLfloat)));
-        glVertexAttribPointer(3, 3, GL_FLOAT, false, sizeof(VertexPNTTB), (GLvoid*) (8 * sizeof(GLfloat)));
-        glVertexAttribPointer(4, 3, GL_FLOAT, false, sizeof(VertexPNTTB), (GLvoid*) (11 * sizeof(GLfloat)));
+        glVertexAttribPointer(0, 3, GL_SHORT, true, sizeof(VertexQPNTTB), (GLvoid*) 0);
+        glVertexAttribPointer(1, 2, GL_SHORT, true, sizeof(VertexQPNTTB), (GLvoid*) (4 * sizeof(GLshort)));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, false, sizeof(VertexQPNTTB), (GLvoid*) (6 * sizeof(GLshort)));
+        glVertexAttribPointer(3, 2, GL_SHORT, true, sizeof(VertexQPNTTB), (GLvoid*) (8 * sizeof(GLshort)));
+        // bitangent sign in the w of the position
+        glVertexAttribPointer(4, 1, GL_SHORT, true, sizeof(VertexQPNTTB), (GLvoid*) (3 * sizeof(GLshort)));
         
         glEnableVertexAttribArray(0);
         glEnableVertexAttribArray(1);
         glEnableVertexAttribArray(2);
         glEnableVertexAttribArray(3);
         glEnableVertexAttribArray(4);
-        
-        glBindVertexArray(0);
     }
     
+    template<>
+    GeometryArena& Mesh<VertexPNTTB>::getArena(){
+        static GeometryArena arena(sizeof(VertexQPNTTB), &Mesh<VertexPNTTB>::setAttributes);
+        return arena;
+    }
     
+    template<>
+    Mesh<VertexPNTTB>::Mesh(const VertexPNTTB* vertices, GLuint numVertices, const GLuint* indices, GLuint numIndices, GLenum usage, GLboolean shared) : m_IndexCount((GLsizei) numIndices) {
+        
+        // pack the vertices, the float data stays on the CPU side only
+        VertexQuantizer quantizer(vertices, numVertices);
+        m_Dequantize = quantizer.getDequantization();
+        
+        std::vector<VertexQPNTTB> packed(numVertices);
+        for(GLuint i = 0; i < numVertices; i++){
+            packed[i] = quantizer.quantize(vertices[i]);
+        }
+        
+        createBuffers(packed.data(), sizeof(VertexQPNTTB), numVertices, indices, numIndices, usage, shared ? &getArena() : nullptr, &setAttributes, m_Vao, m_Vbo, m_Ibo);
+        
+        m_Lods.push_back(MeshLod(0, numIndices, 0.0f));
+    }
     
 }
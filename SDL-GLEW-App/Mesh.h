@@ -19,26 +19,84 @@
 #include "Texture.h"
 #include "TextureManager.h"
 #include "BoundingVolume.h"
+#include "RenderQueue.h"
+#include "ShaderVariants.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "NormalGenerator.h"
+#include "HeightField.h"
+#include "VertexQuantizer.h"
+#include "GeometryArena.h"
+#include "InstanceCuller.h"
 
 namespace Fox {
     
-    static std::vector<const GLchar*> textureToUniformName = {"material.diffuse", "material.specular", nullptr, nullptr, "material.normalMap", nullptr};
+    static const UniformId textureToUniform[] = {UNIFORM_MATERIAL_DIFFUSE, UNIFORM_MATERIAL_SPECULAR, NO_UNIFORM, UNIFORM_HEIGHT_MAP, UNIFORM_MATERIAL_NORMAL_MAP, NO_UNIFORM};
+    
+    static const GLuint INSTANCE_ATTRIBUTE_LOCATION = 5; ///< first of the four locations of the per instance model matrix
+    
+    static const GLuint LOD_BITS = 2; ///< low bits of the packet data holding the level of detail, the instance count is above them
+    static const GLuint LOD_MASK = (1 << LOD_BITS) - 1;
+    static const GLfloat LOD_HYSTERESIS = 0.75f; ///< part of the pixel error a coarser level must stay under before it is taken
+    
+    static_assert(MAX_LODS <= (1 << LOD_BITS), "levels of detail do not fit in the packet data");
+    
+    static const GLuint INDIRECT_DATA = 0xFFFFFFFF; ///< packet data of instances drawn from the buffers of an InstanceCuller
     
     class MeshBase {
     public:
         
-        MeshBase(){
+        MeshBase() : m_IndexType(GL_UNSIGNED_INT), m_IndexSize(sizeof(GLuint)), m_BaseVertex(0), m_IndexStart(0), m_Arena(nullptr), m_InstanceVbo(0), m_InstanceCapacity(0), m_AttachedInstances(0), m_IndirectInstances(0), m_IndirectCommands(0) {
             
             m_Material.m_Shininess = 32.0f;
             m_Material.m_Textures = std::vector<Texture*>(Texture::TextureType_Max);
         }
         
+        virtual ~MeshBase() {}
+        
         virtual void draw(GLContext* gl){}
         
         virtual void drawToDepthBuffer(GLContext* gl){}
         
         virtual void drawWireframe(GLContext* gl){}
         
+        /**
+         * Deletes the buffers of this mesh or returns its ranges to the geometry arena
+         */
+        virtual void release(){}
+        
+        /**
+         * Returns the vertex array used by drawGeometry
+         */
+        virtual GLuint getVertexArray() const {
+            return 0;
+        }
+        
+        /**
+         * Issues the draw call of a render queue packet, vertex array and material are already bound
+         *
+         * @param gl GLContext
+         * @param data Packet data given at submit
+         */
+        virtual void drawGeometry(GLContext* gl, GLuint data){}
+        
+        /**
+         * Submits this mesh to a render queue
+         *
+         * @param queue Render queue
+         * @param shader Shader index in GLContext
+         * @param model Model matrix
+         * @param lod Level of detail, see selectLod
+         */
+        virtual void submit(RenderQueue& queue, GLuint shader, const glm::mat4& model, GLuint lod = 0){}
+        
+        /**
+         * Returns the shader features this mesh can use, see ShaderVariants::Feature
+         */
+        virtual GLuint getFeatures() const {
+            return 0;
+        }
+        
         
         /**
          * Adds a texture of certain type to this mesh's material
@@ -59,21 +117,189 @@ namespace Fox {
         void computeBoundingSphere(std::vector<Vertex>& vertices){
             m_BoundingSphere = BoundingSphere(vertices);
         }
-    
+        
+        /**
+         * Picks the coarsest level of detail whose error covers at most a given number of pixels.
+         * A coarser level than the current one is taken only when its error is clearly below the
+         * limit, so that a mesh at the switching distance does not pop back and forth
+         *
+         * @param pixelsPerUnit Pixels covered by one object space unit at the distance of the mesh
+         * @param current Level drawn in the previous frame
+         * @param pixelError Largest error in pixels
+         * @return level of detail
+         */
+        GLuint selectLod(GLfloat pixelsPerUnit, GLuint current, GLfloat pixelError) const {
+            
+            GLuint lod = 0;
+            while(lod + 1 < m_Lods.size() && m_Lods[lod + 1].m_Error * pixelsPerUnit <= pixelError){
+                lod++;
+            }
+            
+            // finer levels are taken right away, the current level is over the limit
+            if(lod <= current)
+                return lod;
+            
+            GLuint coarser = current;
+            while(coarser < lod && m_Lods[coarser + 1].m_Error * pixelsPerUnit <= pixelError * LOD_HYSTERESIS){
+                coarser++;
+            }
+            
+            return coarser;
+        }
+        
+        /**
+         * Returns the number of triangles of a level of detail
+         */
+        inline GLuint getLodTriangles(GLuint lod) const {
+            return lod < m_Lods.size() ? m_Lods[lod].m_IndexCount / 3 : 0;
+        }
+        
+        /**
+         * Returns the indirect draw command of a level of detail without instances
+         *
+         * @param lod Level of detail
+         */
+        DrawElementsIndirectCommand getIndirectCommand(GLuint lod) const {
+            
+            DrawElementsIndirectCommand command = DrawElementsIndirectCommand();
+            command.m_Count = m_Lods[lod].m_IndexCount;
+            command.m_FirstIndex = m_IndexStart / m_IndexSize + m_Lods[lod].m_IndexOffset;
+            command.m_BaseVertex = m_BaseVertex;
+            return command;
+        }
+        
         // material class
         class Material {
         public:
-        
-            Material(){}
-        
+            
+            Material() : m_UniformSlot(-1) {}
+            
+            /**
+             * Attaches the constants of this material to the material uniform block. The slot
+             * in the material uniform buffer is taken on first use
+             *
+             * @param gl GLContext
+             * @return true if the binding reached GL
+             */
+            bool bindUniforms(GLContext* gl){
+                
+                if(m_UniformSlot < 0){
+                    MaterialUniforms uniforms = MaterialUniforms();
+                    uniforms.m_Shininess = m_Shininess;
+                    m_UniformSlot = (GLint) gl->addMaterialUniforms(uniforms);
+                }
+                
+                return gl->bindMaterialUniforms((GLuint) m_UniformSlot);
+            }
+            
             GLfloat m_Shininess;
             std::vector<Texture*> m_Textures; /// all texture types
+            GLint m_UniformSlot; ///< slot in the material uniform buffer, -1 until first use
         };
-    
+        
         Material m_Material; ///< material of the mesh
         BoundingSphere m_BoundingSphere; ///< bounding sphere
-    };
+        glm::mat4 m_Dequantize; ///< maps packed vertex positions to object space, applied by submit, callers of draw include it in their model matrix
+    
+    protected:
+        
+        /**
+         * Binds the material textures, units without a texture get texture 0. Bindings that are
+         * already in place are dropped by the GLContext state cache, so nothing is reset afterwards
+         *
+         * @param gl GLContext
+         */
+        void bindMaterial(GLContext* gl){
+            
+            for(GLuint i = 0; i < m_Material.m_Textures.size(); i++){
+                
+                Texture* texture = m_Material.m_Textures[i];
+                
+                // if there is a texture
+                if(texture != nullptr){
+                    gl->bindTexture(texture->m_Id, GL_TEXTURE0 + i, textureToUniform[(GLuint) texture->m_Type], i);
+                } else {
+                    gl->bindTexture2D(i, 0);
+                }
+            }
+            
+            m_Material.bindUniforms(gl);
+        }
+        
+        /**
+         * Uploads per instance model matrices to the instance buffer of a vertex array.
+         * The buffer is created and bound to the vertex array on first use
+         *
+         * @param gl GLContext
+         * @param vao Vertex array the instance attributes belong to
+         * @param transforms Model matrix of each instance
+         */
+        void uploadInstances(GLContext* gl, GLuint vao, const std::vector<glm::mat4>& transforms);
+        
+        /**
+         * Binds a buffer of model matrices to the instance attributes of the bound vertex array
+         * and leaves it bound to GL_ARRAY_BUFFER. Attaching the same buffer again is skipped
+         * unless other meshes of an arena page share the vertex array
+         *
+         * @param buffer Buffer with one mat4 per instance
+         */
+        void attachInstances(GLuint buffer);
+        
+        /**
+         * Draws the instances left by the latest InstanceCuller::cull with the command and
+         * transforms given at submit, the vertex array is already bound
+         */
+        void drawIndirect();
         
+        /**
+         * Uploads packed vertices and indices, with 16 bit indices when all vertices can be
+         * addressed by them. Buffers come from the arena when one is given, otherwise the mesh
+         * gets a vertex array and buffers of its own. Sets the index type and the buffer ranges
+         *
+         * @param vertices Packed vertex data
+         * @param vertexSize Size of one packed vertex
+         * @param numVertices Number of vertices
+         * @param indices Index data
+         * @param numIndices Number of indices
+         * @param usage Buffer usage of own buffers
+         * @param arena Geometry arena of the vertex format or nullptr
+         * @param setAttributes Attribute setup of the vertex format
+         * @param vao Receives the vertex array
+         * @param vbo Receives the vertex buffer
+         * @param ibo Receives the index buffer, 0 for arena meshes
+         */
+        void createBuffers(const GLvoid* vertices, GLuint vertexSize, GLuint numVertices, const GLuint* indices, GLuint numIndices, GLenum usage,
+                           GeometryArena* arena, GeometryArena::AttributeSetup setAttributes, GLuint& vao, GLuint& vbo, GLuint& ibo);
+        
+        /**
+         * Deletes own buffers and the instance buffer, or returns the ranges to the arena
+         */
+        void releaseBuffers(GLuint& vao, GLuint& vbo, GLuint& ibo);
+        
+        /**
+         * Returns the draw call offset of an index
+         *
+         * @param index Index of the index within this mesh
+         */
+        inline const GLvoid* indexOffset(GLuint index) const {
+            return (const GLvoid*) (size_t) (m_IndexStart + index * m_IndexSize);
+        }
+        
+        GLenum m_IndexType; ///< GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        GLuint m_IndexSize; ///< size of one index in the index buffer
+        GLint m_BaseVertex; ///< first vertex of the mesh in the vertex buffer, added to the indices
+        GLuint m_IndexStart; ///< first byte of the indices in the index buffer
+        GeometryArena* m_Arena; ///< arena holding the geometry, nullptr if the mesh owns its buffers
+        GeometryArena::Allocation m_Allocation; ///< ranges of the mesh in the arena
+        std::vector<MeshLod> m_Lods; ///< index ranges of the levels of detail, the full mesh first
+        GLuint m_InstanceVbo; ///< vertex buffer object for instance transforms
+        GLuint m_InstanceCapacity; ///< number of transforms the instance buffer can hold
+        std::vector<glm::mat4> m_InstanceTransforms; ///< transforms of the instances to draw
+        GLuint m_AttachedInstances; ///< buffer bound to the instance attributes, 0 if none
+        GLuint m_IndirectInstances; ///< transform buffer of the latest indirect submit
+        GLuint m_IndirectCommands; ///< command buffer of the latest indirect submit
+    };
+
 template <class V = Vertex> class FMesh : public MeshBase {
     
     public:
@@ -84,248 +310,324 @@ template <class V = Vertex> class FMesh : public MeshBase {
     
     void draw(GLContext* gl){
         
-        // bind all existing textures
-        for(GLuint i = 0; i < m_Material.m_Textures.size(); i++){
-        
-            Texture* texture = m_Material.m_Textures[i];
-            
-            // if there is a texture
-            if(texture != nullptr){
-                
-                gl->bindTexture(texture->m_Id, GL_TEXTURE0 + i, textureToUniformName[(GLuint) texture->m_Type], i);
-            }
-        
-        }
-        
-        glActiveTexture(GL_TEXTURE0);
-        
-        if(gl->getCurrentShader()->hasUniform("material.shininess"))
-            gl->setFloat(m_Material.m_Shininess, "material.shininess");
+        bindMaterial(gl);
         
         // render this mesh
-        glBindVertexArray(m_Vao);
+        gl->bindVertexArray(m_Vao);
         glDrawArrays(GL_TRIANGLES, 0, m_Vertices.size());
-        glBindVertexArray(0);
-        
-        // reset bound textures
-        for (GLuint i = 0; i < m_Material.m_Textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
-     
     }
     
     void drawToDepthBuffer(GLContext* gl){
         // render this mesh
-        glBindVertexArray(m_Vao);
+        gl->bindVertexArray(m_Vao);
         glDrawArrays(GL_TRIANGLES, 0, m_Vertices.size());
-        glBindVertexArray(0);
-    
     }
     
+    /**
+     * Draws n instances of this mesh with a single instanced draw call
+     *
+     * @param gl GLContext
+     * @param n Number of instances
+     * @param positions Positions of the instances
+     */
     void draw(GLContext* gl, GLuint n, std::vector<glm::vec3>& positions){
-    
-        // bind all existing textures
-        for(GLuint i = 0; i < m_Material.m_Textures.size(); i++){
-            
-            Texture* texture = m_Material.m_Textures[i];
-            
-            // if there is a texture
-            if(texture != nullptr){
-                gl->bindTexture(texture->m_Id, GL_TEXTURE0 + i, textureToUniformName[(GLuint) texture->m_Type], i);
-            }
-            
-        }
         
-        glActiveTexture(GL_TEXTURE0);
+        m_InstanceTransforms.clear();
         
-        glBindVertexArray(m_Vao);
+        for(GLuint i = 0; i < n; i++){
+            m_InstanceTransforms.push_back(glm::translate(glm::mat4(), positions[i]) * m_Dequantize);
+        }
         
-        gl->setFloat(m_Material.m_Shininess, "material.shininess");
+        if(m_InstanceTransforms.empty())
+            return;
         
-        // render n times
-        for(GLuint i = 0; i < n; i++)
-        {
-            glm::mat4 model = glm::mat4();
-            model = glm::translate(model, positions[i]);
-          //  GLfloat angle = 20.0f * i;
-          //  model = glm::rotate(model, angle, glm::vec3(1.0f, 0.3f, 0.5f));
-            gl->setMatrix4fUniform(model, "model");
-            
-            glDrawArrays(GL_TRIANGLES, 0, m_Vertices.size());
-        }
+        bindMaterial(gl);
         
-        glBindVertexArray(0);
+        uploadInstances(gl, m_Vao, m_InstanceTransforms);
         
-        // reset bound textures
-        for (GLuint i = 0; i < m_Material.m_Textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
+        // render all instances at once
+        glDrawArraysInstanced(GL_TRIANGLES, 0, m_Vertices.size(), (GLsizei) m_InstanceTransforms.size());
     }
     
+    /**
+     * Draws instances of this mesh to the depth buffer with a single instanced draw call
+     *
+     * @param gl GLContext
+     * @param positions Positions of the instances
+     */
     void drawToDepthBuffer(GLContext* gl, std::vector<glm::vec3>& positions){
         
-        glBindVertexArray(m_Vao);
+        m_InstanceTransforms.clear();
         
-        // render n times
-        for(GLuint i = 0; i < positions.size(); i++)
-        {
-            glm::mat4 model = glm::mat4();
-            model = glm::translate(model, positions[i]);
-            gl->setMatrix4fUniform(model, "model");
-            
-            glDrawArrays(GL_TRIANGLES, 0, m_Vertices.size());
+        for(GLuint i = 0; i < positions.size(); i++){
+            m_InstanceTransforms.push_back(glm::translate(glm::mat4(), positions[i]) * m_Dequantize);
         }
         
-        glBindVertexArray(0);
+        if(m_InstanceTransforms.empty())
+            return;
         
+        uploadInstances(gl, m_Vao, m_InstanceTransforms);
+        
+        glDrawArraysInstanced(GL_TRIANGLES, 0, m_Vertices.size(), (GLsizei) m_InstanceTransforms.size());
     }
     
     void drawWireframe(GLContext* gl){
         // enable wireframe mode
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        gl->polygonMode(GL_LINE);
         
-        glBindVertexArray(m_Vao);
+        gl->bindVertexArray(m_Vao);
         glDrawArrays(GL_TRIANGLES, 0, m_Vertices.size());
-        glBindVertexArray(0);
         
         // disable wireframe mode
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    
+        gl->polygonMode(GL_FILL);
     }
     
     std::vector<V> m_Vertices; ///< vertices
     std::vector<GLuint> m_Indices; ///< index data
-    
+
 private:
     
     GLuint m_Vao; ///< vertex array id
     GLuint m_Vbo; ///< vertex buffer object
-    
+        
     };
     
     template <class V = Vertex> class Mesh : public MeshBase {
     
     public:
         
-        Mesh(){}
+        Mesh() : m_IndexCount(0) {}
         
-        Mesh(std::vector<V>& vertices, std::vector<GLuint>& indices, GLenum usage);
+        /**
+         * Creates a mesh and keeps a copy of the data in m_Vertices and m_Indices
+         */
+        Mesh(std::vector<V>& vertices, std::vector<GLuint>& indices, GLenum usage, GLboolean shared = false) : Mesh(vertices.data(), (GLuint) vertices.size(), indices.data(), (GLuint) indices.size(), usage, shared) {
+            m_Vertices = vertices;
+            m_Indices = indices;
+        }
+        
+        /**
+         * Creates a mesh from raw data without keeping a copy, e.g. straight from a mapped file
+         *
+         * @param vertices Vertex data
+         * @param numVertices Number of vertices
+         * @param indices Index data
+         * @param numIndices Number of indices
+         * @param usage Buffer usage
+         * @param shared Put the geometry in the arena of the vertex format instead of buffers of its own
+         */
+        Mesh(const V* vertices, GLuint numVertices, const GLuint* indices, GLuint numIndices, GLenum usage, GLboolean shared = false);
         
         void draw(GLContext* gl){
             
-            // bind all existing textures
-            for(GLuint i = 0; i < m_Material.m_Textures.size(); i++){
-                
-                Texture* texture = m_Material.m_Textures[i];
-                
-                // if there is a texture
-                if(texture != nullptr){
-                    gl->bindTexture(texture->m_Id, GL_TEXTURE0 + i, textureToUniformName[(GLuint) texture->m_Type], i);
-                }
-                
-            }
-            
-            gl->setFloat(m_Material.m_Shininess, "material.shininess");
-            
-            glBindVertexArray(m_Vao);
-            glDrawElements(GL_TRIANGLES, (GLsizei) m_Indices.size(), GL_UNSIGNED_INT, 0); //BUFFER_OFFSET(0));
-            glBindVertexArray(0);
+            bindMaterial(gl);
             
-            // reset bound textures
-            for (GLuint i = 0; i < m_Material.m_Textures.size(); i++)
-            {
-                glActiveTexture(GL_TEXTURE0 + i);
-                glBindTexture(GL_TEXTURE_2D, 0);
-            }
+            gl->bindVertexArray(m_Vao);
+            glDrawElementsBaseVertex(GL_TRIANGLES, m_IndexCount, m_IndexType, indexOffset(0), m_BaseVertex);
         }
         
         void drawToDepthBuffer(GLContext* gl){
-            glBindVertexArray(m_Vao);
-            glDrawElements(GL_TRIANGLES, (GLsizei) m_Indices.size(), GL_UNSIGNED_INT, 0); //BUFFER_OFFSET(0));
-            glBindVertexArray(0);
+            gl->bindVertexArray(m_Vao);
+            glDrawElementsBaseVertex(GL_TRIANGLES, m_IndexCount, m_IndexType, indexOffset(0), m_BaseVertex);
         }
         
         void drawWireframe(GLContext* gl){
             // enable wireframe mode
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            gl->polygonMode(GL_LINE);
             
-            glBindVertexArray(m_Vao);
-            glDrawElements(GL_TRIANGLES, m_Indices.size(), GL_UNSIGNED_INT, 0);
-            glBindVertexArray(0);
+            gl->bindVertexArray(m_Vao);
+            glDrawElementsBaseVertex(GL_TRIANGLES, m_IndexCount, m_IndexType, indexOffset(0), m_BaseVertex);
             
             // disable wireframe mode
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            gl->polygonMode(GL_FILL);
             
         }
         
-        void draw(GLContext* gl, GLuint n, std::vector<glm::vec3>& positions){
+        void release(){
+            releaseBuffers(m_Vao, m_Vbo, m_Ibo);
+        }
+        
+        GLuint getVertexArray() const {
+            return m_Vao;
+        }
+        
+        /**
+         * Sets the levels of detail, the index buffer holds the indices of all of them
+         *
+         * @param lods Levels of detail from MeshSimplifier::generateLods
+         */
+        void setLods(const std::vector<MeshLod>& lods){
+            m_Lods = lods;
+            m_IndexCount = (GLsizei) lods[0].m_IndexCount;
+        }
+        
+        /**
+         * Draws a level of detail given in the low bits of data, instanced when the bits above
+         * hold the number of instances uploaded by submit
+         */
+        void drawGeometry(GLContext* gl, GLuint data){
             
-            // bind all existing textures
-            for(GLuint i = 0; i < m_Material.m_Textures.size(); i++){
-                
-                
-                Texture* texture = m_Material.m_Textures[i];
-                
-                // if there is a texture
-                if(texture != nullptr){
-                    gl->bindTexture(texture->m_Id, GL_TEXTURE0 + i, textureToUniformName[(GLuint) texture->m_Type], i);
-                }
-                
+            if(data == INDIRECT_DATA){
+                drawIndirect();
+                return;
+            }
+            
+            const MeshLod& lod = m_Lods[data & LOD_MASK];
+            GLuint instances = data >> LOD_BITS;
+            
+            if(instances == 0){
+                glDrawElementsBaseVertex(GL_TRIANGLES, lod.m_IndexCount, m_IndexType, indexOffset(lod.m_IndexOffset), m_BaseVertex);
+            } else {
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.m_IndexCount, m_IndexType, indexOffset(lod.m_IndexOffset), (GLsizei) instances, m_BaseVertex);
+            }
+        }
+        
+        void submit(RenderQueue& queue, GLuint shader, const glm::mat4& model, GLuint lod = 0){
+            queue.submit(shader, this, lod, glm::vec3(model * glm::vec4(m_BoundingSphere.m_Center, 1.0f)), model * m_Dequantize);
+        }
+        
+        /**
+         * Normal mapping needs both tangents in the vertices and a normal map in the material,
+         * vertices packed on upload need the decoding of QUANTIZED
+         */
+        GLuint getFeatures() const {
+            
+            GLuint features = VertexTraits<V>::IS_QUANTIZED ? ShaderVariants::QUANTIZED : 0;
+            
+            if(VertexTraits<V>::HAS_TANGENTS && m_Material.m_Textures[Texture::Normal] != nullptr)
+                features |= ShaderVariants::NORMAL_MAP;
+            
+            return features;
+        }
+        
+        /**
+         * Uploads given instances and submits them to a render queue as one instanced packet.
+         * The queue must be executed before the instances of this mesh are submitted again
+         *
+         * @param gl GLContext
+         * @param queue Render queue
+         * @param shader Shader index in GLContext
+         * @param positions Positions of all instances
+         * @param visible Indices of the instances to draw
+         */
+        void submit(GLContext* gl, RenderQueue& queue, GLuint shader, const std::vector<glm::vec3>& positions, const std::vector<GLuint>& visible){
+            
+            m_InstanceTransforms.clear();
+            
+            glm::vec3 center;
+            
+            for(GLuint i : visible){
+                m_InstanceTransforms.push_back(glm::translate(glm::mat4(), positions[i]) * m_Dequantize);
+                center += positions[i];
             }
             
-            glActiveTexture(GL_TEXTURE0);
+            if(m_InstanceTransforms.empty())
+                return;
             
-            glBindVertexArray(m_Vao);
+            uploadInstances(gl, m_Vao, m_InstanceTransforms);
             
-            if(gl->getCurrentShader()->hasUniform("material.shininess"))
-                gl->setFloat(m_Material.m_Shininess, "material.shininess");
+            queue.submit(shader, this, (GLuint) m_InstanceTransforms.size() << LOD_BITS, center / (GLfloat) m_InstanceTransforms.size() + m_BoundingSphere.m_Center);
+        }
+        
+        /**
+         * Submits the instances that passed the latest cull of an InstanceCuller as one indirect
+         * packet. The queue must be executed before the culler culls again
+         *
+         * @param queue Render queue
+         * @param shader Shader index in GLContext
+         * @param culler Culler created with the draw command of this mesh
+         */
+        void submit(RenderQueue& queue, GLuint shader, const InstanceCuller& culler){
             
+            m_IndirectInstances = culler.getTransformBuffer();
+            m_IndirectCommands = culler.getCommandBuffer();
             
+            queue.submit(shader, this, INDIRECT_DATA, culler.getCenter());
+        }
+        
+        /**
+         * Draws the instances of this mesh that are inside the view frustum with a single instanced draw call
+         *
+         * @param gl GLContext
+         * @param n Number of instances
+         * @param positions Positions of the instances
+         */
+        void draw(GLContext* gl, GLuint n, std::vector<glm::vec3>& positions){
             
-            // render n times
-            for(GLuint i = 0; i < n; i++)
-            {
-                glm::mat4 model = glm::mat4();
-                model = glm::translate(model, positions[i]);
-                gl->setMatrix4fUniform(model, "model");
-                
-                gl->getCurrentRenderContext().updateFrustum(model);
-             
-                // use frustum culling and bounding volume to determine if sphere is inside
-                if(gl->getCurrentRenderContext().m_Frustum.sphereIsInsideFrustum(m_BoundingSphere.m_Center, m_BoundingSphere.m_Radius)){
-                    glDrawElements(GL_TRIANGLES, (GLsizei) m_Indices.size(), GL_UNSIGNED_INT, 0);
-                
-                }
+            RenderContext& rc = gl->getCurrentRenderContext();
+            rc.updateFrustum();
+            
+            // bounding spheres of the instances in world space
+            m_InstanceBounds.clear();
+            for(GLuint i = 0; i < n; i++){
+                m_InstanceBounds.add(positions[i] + m_BoundingSphere.m_Center, m_BoundingSphere.m_Radius);
             }
             
-            glBindVertexArray(0);
+            rc.m_Frustum.cullSpheres(m_InstanceBounds, m_VisibleInstances);
+            draw(gl, positions, m_VisibleInstances);
+        }
+        
+        /**
+         * Draws given instances of this mesh with a single instanced draw call
+         *
+         * @param gl GLContext
+         * @param positions Positions of all instances
+         * @param visible Indices of the instances to draw, e.g. output of Frustum::cullSpheres
+         */
+        void draw(GLContext* gl, const std::vector<glm::vec3>& positions, const std::vector<GLuint>& visible){
+            
+            m_InstanceTransforms.clear();
             
-            // reset bound textures
-            for (GLuint i = 0; i < m_Material.m_Textures.size(); i++)
-            {
-                glActiveTexture(GL_TEXTURE0 + i);
-                glBindTexture(GL_TEXTURE_2D, 0);
+            for(GLuint i : visible){
+                m_InstanceTransforms.push_back(glm::translate(glm::mat4(), positions[i]) * m_Dequantize);
             }
+            
+            if(m_InstanceTransforms.empty())
+                return;
+            
+            bindMaterial(gl);
+            
+            uploadInstances(gl, m_Vao, m_InstanceTransforms);
+            
+            // render all visible instances at once
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, m_IndexCount, m_IndexType, indexOffset(0), (GLsizei) m_InstanceTransforms.size(), m_BaseVertex);
         }
         
+        /**
+         * Draws instances of this mesh to the depth buffer with a single instanced draw call
+         *
+         * @param gl GLContext
+         * @param positions Positions of the instances
+         */
         void drawToDepthBuffer(GLContext* gl, std::vector<glm::vec3>& positions) {
             
-            glBindVertexArray(m_Vao);
+            m_InstanceTransforms.clear();
             
-            // render n times
             for(GLuint i = 0; i < positions.size(); i++)
             {
-                glm::mat4 model = glm::mat4();
-                model = glm::translate(model, positions[i]);
-                gl->setMatrix4fUniform(model, "model");
-                glDrawElements(GL_TRIANGLES, (GLsizei) m_Indices.size(), GL_UNSIGNED_INT, 0);
+                m_InstanceTransforms.push_back(glm::translate(glm::mat4(), positions[i]) * m_Dequantize);
             }
             
-            glBindVertexArray(0);
+            drawInstancesToDepthBuffer(gl);
+        }
+        
+        /**
+         * Draws given instances of this mesh to the depth buffer with a single instanced draw call
+         *
+         * @param gl GLContext
+         * @param positions Positions of all instances
+         * @param visible Indices of the instances to draw
+         */
+        void drawToDepthBuffer(GLContext* gl, const std::vector<glm::vec3>& positions, const std::vector<GLuint>& visible) {
+            
+            m_InstanceTransforms.clear();
+            
+            for(GLuint i : visible)
+            {
+                m_InstanceTransforms.push_back(glm::translate(glm::mat4(), positions[i]) * m_Dequantize);
+            }
+            
+            drawInstancesToDepthBuffer(gl);
         }
         
         
@@ -335,14 +637,23 @@ private:
          *
          * @param vertices Vertices to add
          */
-        void updateVertices(const std::vector<Vertex>& vertices) {
+        void updateVertices(const std::vector<V>& vertices) {
             
-            glBindVertexArray(m_Vao);
+            // the buffer holds packed vertices, the bounds of the new positions may differ
+            VertexQuantizer quantizer(vertices.data(), (GLuint) vertices.size());
+            m_Dequantize = quantizer.getDequantization();
             
-            glBindBuffer(GL_ARRAY_BUFFER, m_Vbo);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex) * vertices.size(), (const GLvoid*)vertices.data());
+            // packed format of V, e.g. VertexQPNTTB for VertexPNTTB
+            typedef decltype(quantizer.quantize(vertices[0])) Packed;
             
-            glBindVertexArray(0);
+            std::vector<Packed> packed(vertices.size());
+            for(GLuint i = 0; i < vertices.size(); i++){
+                packed[i] = quantizer.quantize(vertices[i]);
+            }
+            
+            // the array buffer binding is not vertex array state, so the bound vertex array is left alone
+            glBindBuffer(GL_ARRAY_BUFFER, m_Vbo);
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(Packed) * m_BaseVertex, sizeof(Packed) * packed.size(), (const GLvoid*)packed.data());
         }
         
         /**
@@ -352,76 +663,47 @@ private:
          * @param indices Index array
          */
         static void calculateNormals(std::vector<Vertex>& vertices, const std::vector<GLuint>& indices){
-            
-            GLfloat* normal = new GLfloat[3 * vertices.size()];
-            
-            // initialize normal array with zeros
-            for(GLuint i = 0; i < 3 * vertices.size(); i++){
-                normal[i] = 0;
-            }
-            
-            // calculate normals with cross product
-            for (GLuint e = 0; e < indices.size(); e+=3) {
-                
-                Vertex& v = vertices[indices[e]];
-                Vertex& v2 = vertices[indices[e + 1]];
-                Vertex& v3 = vertices[indices[e + 2]];
-                
-                // triangle end points
-                glm::vec3 a = v.m_Position;
-                glm::vec3 b = v2.m_Position;
-                glm::vec3 c = v3.m_Position;
-                // cross product
-                glm::vec3 n = glm::cross(c - b, a - b);
-                
-                // add normals to every participating vertex
-                normal[3*indices[e]] += n.x;
-                normal[3*indices[e] + 1] += n.y;
-                normal[3*indices[e] + 2] += n.z;
-                
-                normal[3*indices[e+1]] += n.x;
-                normal[3*indices[e+1] + 1] += n.y;
-                normal[3*indices[e+1] + 2] += n.z;
-                
-                normal[3*indices[e+2]] += n.x;
-                normal[3*indices[e+2] + 1] += n.y;
-                normal[3*indices[e+2] + 2] += n.z;
-                
-            }
-            
-            // normalize normals
-            for(GLuint i = 0; i < 3 * vertices.size(); i+=3){
-                
-                glm::vec3 n = glm::vec3(normal[i], normal[i+1], normal[i+2]);
-                n = glm::normalize(n);
-                
-                normal[i] = n.x;
-                normal[i+1] = n.y;
-                normal[i+2] = n.z;
-                
-            }
-            // set normals to vertices
-            for(GLuint i = 0; i < vertices.size(); i++){
-                
-                Vertex& vertex = vertices[i];
-                vertex.m_Normal = glm::vec3(normal[3*i], normal[3*i+1], normal[3*i+2]);
-            }
-            
-            // release array memory
-            delete[] normal;
-            
+            NormalGenerator::generateNormals(vertices, indices);
         }
         
         std::vector<V> m_Vertices; ///< vertices
         std::vector<GLuint> m_Indices; ///< index data
     
     private:
-        GLuint m_Vao; ///< vertex array id
+        
+        /**
+         * Sets the attributes of the packed vertex format to the bound vertex array
+         */
+        static void setAttributes();
+        
+        /**
+         * Returns the geometry arena of the packed vertex format
+         */
+        static GeometryArena& getArena();
+        
+        /**
+         * Draws the collected instance transforms to the depth buffer
+         */
+        void drawInstancesToDepthBuffer(GLContext* gl){
+            
+            if(m_InstanceTransforms.empty())
+                return;
+            
+            uploadInstances(gl, m_Vao, m_InstanceTransforms);
+            
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, m_IndexCount, m_IndexType, indexOffset(0), (GLsizei) m_InstanceTransforms.size(), m_BaseVertex);
+        }
+        
+        GLuint m_Vao; ///< vertex array id, shared by the meshes of an arena page
         GLuint m_Vbo; ///< vertex buffer object
-        GLuint m_Ibo; ///< index buffer object
+        GLuint m_Ibo; ///< index buffer object, 0 in an arena
+        GLsizei m_IndexCount; ///< number of indices in the index buffer
+        
+        BoundingSphereSet m_InstanceBounds; ///< world space bounds of the instances
+        std::vector<GLuint> m_VisibleInstances; ///< instances that passed culling
         
     };
-
+    
     /**
      * Creates a cube 
      *
@@ -447,7 +729,7 @@ private:
      *
      * @param vertex data
      */
-    template<class V> static std::vector<V> getGroundData(const GLchar* filePath, GLint* width, GLint* height){
+    template<class V> static std::vector<V> getGroundData(const HeightField& heightField, GLint* width, GLint* height){
         return std::vector<V>();
     }
     
@@ -459,28 +741,22 @@ private:
     template<class V> static std::vector<V> getPlaneIndices(GLint w, GLint h){
         return std::vector<V>();
     }
-
+    
     
     /**
-     * Generates ground vertex data for type Vertex based on height map
+     * Generates ground vertex data for type Vertex based on a height field
      *
      * @return vertex data
      */
     template<> static
-    std::vector<Vertex> getGroundData(const GLchar* filePath, GLint* width, GLint* height) {
+    std::vector<Vertex> getGroundData(const HeightField& heightField, GLint* width, GLint* height) {
         
         std::vector<Vertex> data;
         
         GLfloat dimension = 1.0f;
         
-       SDL_Surface* image = Texture::readTexture(filePath);
-        
-        Uint8 r,g,b;
-        
-        Uint32* p = (Uint32*) image->pixels;
-        
-        GLint w = image->w;
-        GLint h = image->h;
+        GLint w = heightField.getWidth();
+        GLint h = heightField.getDepth();
         *width = w;
         *height = h;
         
@@ -499,13 +775,8 @@ private:
                     y--;
                 }
                 
-                // sample height map
-                SDL_GetRGB(p[y*image->w + x], image->format, &r, &g, &b);
-                
-                GLint heightMap = (GLint)(0.21f * r + 0.72f * g + 0.07f * b);
-                
-                //GLint heightMap = (GLint) r;
-                GLfloat h = ((GLfloat)(heightMap/255.0f) * 10.0f - 10.0f ) * 10;
+                // sample height field
+                GLfloat h = heightField.heightAt(x, y);
                 
                 Vertex v;
                 v.m_Position = glm::vec3(i*dimension, h, j*dimension);
@@ -517,8 +788,6 @@ private:
             }
         }
         
-        SDL_FreeSurface(image);
-        
         return data;
     }
     
@@ -529,7 +798,7 @@ private:
      */
     template<> static
     std::vector<GLuint> getPlaneIndices(GLint w, GLint h){
-    
+        
         std::vector<GLuint> indices;
         
         for(int i = 0; i < w; i++){
@@ -542,9 +811,9 @@ private:
                 indices.push_back((h+1)*i + j);
                 indices.push_back((h+1)*i + j + 1); // swap2
                 indices.push_back((h+1) * (i+1) + j + 1); // swap2
-            
+                
             }
-            
+         
          /*   for(int i = 0; i < indices.size(); i++){
                 std::cout << indices[i] << std::endl;
             }*/
@@ -606,7 +875,8 @@ private:
         
         std::vector<GLuint> indices;
         
-        for(int i = 0; i <= number; i++){
+        // the last ring repeats the first one for the texture seam, there are number quads
+        for(int i = 0; i < number; i++){
             // first triangle
             indices.push_back(2 * i);
             indices.push_back(2 * (i + 1)); 
@@ -667,16 +937,17 @@ private:
     }
     
     /**
-     * Creates a ground based on height map
+     * Creates a ground based on a height field
      *
      * @return created plane
      */
     template <class V>
-    static Mesh<V> createGround(const GLchar* filePath){
-
+    static Mesh<V> createGround(const HeightField& heightField){
+        
         GLint w, h;
-        std::vector<V> vertices = getGroundData<V>(filePath, &w, &h);
+        std::vector<V> vertices = getGroundData<V>(heightField, &w, &h);
         std::vector<GLuint> indices = getPlaneIndices<GLuint>(w, h);
+        MeshOptimizer::optimizeVertexCache(indices.data(), (GLuint) indices.size(), (GLuint) vertices.size());
         
         Mesh<V>::calculateNormals(vertices, indices);
         
@@ -694,9 +965,10 @@ private:
      */
     template <class V>
     static Mesh<V> createCylinder(GLuint number, GLfloat height, GLfloat radius){
-    
+        
         std::vector<V> vertices = getCylinderData<V>(number, height, radius);
         std::vector<GLuint> indices = getCylinderIndices<GLuint>(number);
+        MeshOptimizer::optimizeVertexCache(indices.data(), (GLuint) indices.size(), (GLuint) vertices.size());
         Mesh<V> mesh = Mesh<V>(vertices, indices, GL_STATIC_DRAW);
         return mesh;
     }
@@ -711,9 +983,10 @@ private:
     
     template <class V>
     static Mesh<V> createSphere(GLuint sides, GLfloat radius){
-    
+        
         std::vector<V> vertices = sphere<V>(sides, radius);
         std::vector<GLuint> indices = getPlaneIndices<GLuint>(sides, sides);
+        MeshOptimizer::optimizeVertexCache(indices.data(), (GLuint) indices.size(), (GLuint) vertices.size());
      //   Mesh<V>::calculateNormals(vertices, indices);
         return Mesh<V>(vertices, indices, GL_STATIC_DRAW);
     }
@@ -0,0 +1,301 @@
+//
+//  MeshOptimizer.cpp
+//  SDL-GLEW-App
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "glm/glm.hpp"
+
+#include "MeshOptimizer.h"
+
+namespace Fox {
+    
+    static inline const glm::vec3& position(const GLvoid* vertices, GLuint vertexSize, GLuint index){
+        return *reinterpret_cast<const glm::vec3*>((const GLubyte*) vertices + (size_t) index * vertexSize);
+    }
+    
+    template <class I>
+    void MeshOptimizer::optimizeVertexCache(I* indices, GLuint indexCount, GLuint vertexCount, std::vector<GLuint>* clusters) {
+        
+        GLuint triangleCount = indexCount / 3;
+        
+        if(clusters != nullptr)
+            clusters->clear();
+        
+        if(triangleCount == 0)
+            return;
+        
+        // number of triangles of each vertex that are not emitted yet
+        std::vector<GLuint> live(vertexCount, 0);
+        for(GLuint i = 0; i < triangleCount * 3; i++){
+            live[indices[i]]++;
+        }
+        
+        // triangles of each vertex, packed one vertex after another
+        std::vector<GLuint> offsets(vertexCount + 1, 0);
+        for(GLuint v = 0; v < vertexCount; v++){
+            offsets[v + 1] = offsets[v] + live[v];
+        }
+        
+        std::vector<GLuint> adjacency(triangleCount * 3);
+        std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+        for(GLuint i = 0; i < triangleCount * 3; i++){
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+        
+        std::vector<GLuint> timestamps(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<GLuint> deadEnds;
+        std::vector<GLuint> candidates;
+        std::vector<I> output;
+        output.reserve(triangleCount * 3);
+        
+        // a vertex is in the cache when fewer than CACHE_SIZE vertices were added after it
+        GLuint time = CACHE_SIZE + 1;
+        GLuint cursor = 0;
+        
+        auto nextUnfinished = [&]() -> GLint {
+            
+            // the most recent vertices are the most likely to still be in the cache
+            while(!deadEnds.empty()){
+                GLuint v = deadEnds.back();
+                deadEnds.pop_back();
+                
+                if(live[v] > 0)
+                    return (GLint) v;
+            }
+            
+            while(cursor < vertexCount && live[cursor] == 0){
+                cursor++;
+            }
+            
+            return cursor < vertexCount ? (GLint) cursor : -1;
+        };
+        
+        GLint fanning = nextUnfinished();
+        
+        if(clusters != nullptr)
+            clusters->push_back(0);
+        
+        while(fanning >= 0){
+            
+            candidates.clear();
+            
+            // emit all remaining triangles around the fanning vertex
+            for(GLuint a = offsets[fanning]; a < offsets[fanning + 1]; a++){
+                
+                GLuint t = adjacency[a];
+                
+                if(emitted[t])
+                    continue;
+                
+                for(GLuint k = 0; k < 3; k++){
+                    
+                    GLuint v = indices[3 * t + k];
+                    
+                    output.push_back((I) v);
+                    deadEnds.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    
+                    if(time - timestamps[v] > CACHE_SIZE){
+                        timestamps[v] = time;
+                        time++;
+                    }
+                }
+                
+                emitted[t] = true;
+            }
+            
+            // next fanning vertex is the oldest one of the 1-ring that stays in the cache while its triangles are emitted
+            GLint next = -1;
+            GLint best = -1;
+            
+            for(GLuint v : candidates){
+                
+                if(live[v] == 0)
+                    continue;
+                
+                GLint priority = 0;
+                if(time - timestamps[v] + 2 * live[v] <= CACHE_SIZE)
+                    priority = (GLint) (time - timestamps[v]);
+                
+                if(priority > best){
+                    best = priority;
+                    next = (GLint) v;
+                }
+            }
+            
+            // dead end, the traversal jumps away and a new cluster starts
+            if(next < 0){
+                
+                next = nextUnfinished();
+                
+                if(next >= 0 && clusters != nullptr)
+                    clusters->push_back((GLuint) output.size() / 3);
+            }
+            
+            fanning = next;
+        }
+        
+        std::copy(output.begin(), output.end(), indices);
+    }
+    
+    template <class I>
+    void MeshOptimizer::optimizeOverdraw(I* indices, GLuint indexCount, const GLvoid* vertices, GLuint vertexSize, const std::vector<GLuint>& clusters) {
+        
+        GLuint triangleCount = indexCount / 3;
+        
+        if(clusters.size() < 2)
+            return;
+        
+        std::vector<glm::vec3> centers(clusters.size());
+        std::vector<glm::vec3> normals(clusters.size());
+        std::vector<GLfloat> areas(clusters.size(), 0.0f);
+        
+        glm::vec3 meshCenter;
+        GLfloat meshArea = 0.0f;
+        
+        // area weighted center and normal of each cluster
+        for(GLuint c = 0; c < clusters.size(); c++){
+            
+            GLuint end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            
+            for(GLuint t = clusters[c]; t < end; t++){
+                
+                const glm::vec3& a = position(vertices, vertexSize, indices[3 * t]);
+                const glm::vec3& b = position(vertices, vertexSize, indices[3 * t + 1]);
+                const glm::vec3& d = position(vertices, vertexSize, indices[3 * t + 2]);
+                
+                glm::vec3 normal = glm::cross(b - a, d - a);
+                GLfloat area = glm::length(normal) * 0.5f;
+                
+                centers[c] += (a + b + d) * (area / 3.0f);
+                normals[c] += normal;
+                areas[c] += area;
+            }
+            
+            meshCenter += centers[c];
+            meshArea += areas[c];
+        }
+        
+        if(meshArea <= 0.0f)
+            return;
+        
+        meshCenter /= meshArea;
+        
+        // clusters facing away from the center of the mesh tend to occlude the others
+        std::vector<GLfloat> keys(clusters.size(), 0.0f);
+        
+        for(GLuint c = 0; c < clusters.size(); c++){
+            
+            GLfloat length = glm::length(normals[c]);
+            
+            if(areas[c] > 0.0f && length > 0.0f)
+                keys[c] = glm::dot(centers[c] / areas[c] - meshCenter, normals[c]) / length;
+        }
+        
+        std::vector<GLuint> order(clusters.size());
+        for(GLuint c = 0; c < clusters.size(); c++){
+            order[c] = c;
+        }
+        
+        std::stable_sort(order.begin(), order.end(), [&](GLuint a, GLuint b) {
+            return keys[a] > keys[b];
+        });
+        
+        std::vector<I> sorted;
+        sorted.reserve(triangleCount * 3);
+        
+        for(GLuint c : order){
+            
+            GLuint end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            sorted.insert(sorted.end(), indices + 3 * clusters[c], indices + 3 * end);
+        }
+        
+        std::copy(sorted.begin(), sorted.end(), indices);
+    }
+    
+    void MeshOptimizer::optimizeVertexFetch(GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, std::vector<GLuint>& indices) {
+        
+        const GLuint UNUSED = ~0u;
+        
+        std::vector<GLuint> remap(vertexCount, UNUSED);
+        GLuint next = 0;
+        
+        for(GLuint& index : indices){
+            
+            if(remap[index] == UNUSED)
+                remap[index] = next++;
+            
+            index = remap[index];
+        }
+        
+        for(GLuint v = 0; v < vertexCount; v++){
+            if(remap[v] == UNUSED)
+                remap[v] = next++;
+        }
+        
+        std::vector<GLubyte> copy((const GLubyte*) vertices, (const GLubyte*) vertices + (size_t) vertexCount * vertexSize);
+        
+        for(GLuint v = 0; v < vertexCount; v++){
+            std::memcpy((GLubyte*) vertices + (size_t) remap[v] * vertexSize, copy.data() + (size_t) v * vertexSize, vertexSize);
+        }
+    }
+    
+    template <class I>
+    VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const I* indices, GLuint indexCount, GLuint vertexCount, GLuint cacheSize) {
+        
+        VertexCacheStatistics statistics;
+        statistics.m_Triangles = indexCount / 3;
+        
+        // zero marks a vertex that was never used
+        std::vector<GLuint> timestamps(vertexCount, 0);
+        GLuint time = cacheSize + 1;
+        
+        for(GLuint i = 0; i < statistics.m_Triangles * 3; i++){
+            
+            GLuint v = indices[i];
+            
+            if(timestamps[v] == 0)
+                statistics.m_Vertices++;
+            
+            if(time - timestamps[v] > cacheSize){
+                timestamps[v] = time;
+                time++;
+                statistics.m_Misses++;
+            }
+        }
+        
+        return statistics;
+    }
+    
+    void MeshOptimizer::optimize(GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, std::vector<GLuint>& indices, const std::vector<MeshLod>& lods, VertexCacheStatistics& before, VertexCacheStatistics& after) {
+        
+        before.add(analyzeVertexCache(indices.data() + lods[0].m_IndexOffset, lods[0].m_IndexCount, vertexCount));
+        
+        std::vector<GLuint> clusters;
+        
+        for(const MeshLod& lod : lods){
+            
+            GLuint* range = indices.data() + lod.m_IndexOffset;
+            
+            optimizeVertexCache(range, lod.m_IndexCount, vertexCount, &clusters);
+            optimizeOverdraw(range, lod.m_IndexCount, vertices, vertexSize, clusters);
+        }
+        
+        // the first level decides the vertex order, the coarser ones reuse its vertices
+        optimizeVertexFetch(vertices, vertexSize, vertexCount, indices);
+        
+        after.add(analyzeVertexCache(indices.data() + lods[0].m_IndexOffset, lods[0].m_IndexCount, vertexCount));
+    }
+    
+    template void MeshOptimizer::optimizeVertexCache<GLuint>(GLuint*, GLuint, GLuint, std::vector<GLuint>*);
+    template void MeshOptimizer::optimizeVertexCache<GLushort>(GLushort*, GLuint, GLuint, std::vector<GLuint>*);
+    template void MeshOptimizer::optimizeOverdraw<GLuint>(GLuint*, GLuint, const GLvoid*, GLuint, const std::vector<GLuint>&);
+    template void MeshOptimizer::optimizeOverdraw<GLushort>(GLushort*, GLuint, const GLvoid*, GLuint, const std::vector<GLuint>&);
+    template VertexCacheStatistics MeshOptimizer::analyzeVertexCache<GLuint>(const GLuint*, GLuint, GLuint, GLuint);
+    template VertexCacheStatistics MeshOptimizer::analyzeVertexCache<GLushort>(const GLushort*, GLuint, GLuint, GLuint);
+}
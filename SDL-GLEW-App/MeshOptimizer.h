@@ -0,0 +1,123 @@
+//
+//  MeshOptimizer.h
+//  SDL-GLEW-App
+//
+
+#ifndef MeshOptimizer_h
+#define MeshOptimizer_h
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "MeshSimplifier.h"
+
+namespace Fox {
+    
+    /**
+     * Post transform vertex cache behaviour of a triangle list, simulated as a FIFO cache.
+     * Statistics of several lists can be added together
+     */
+    class VertexCacheStatistics {
+    public:
+        
+        VertexCacheStatistics() : m_Triangles(0), m_Vertices(0), m_Misses(0) {}
+        
+        /**
+         * Average cache miss ratio, vertices transformed per triangle. 0.5 is the best a
+         * regular grid can do, 3 means no reuse at all
+         */
+        GLfloat acmr() const {
+            return m_Triangles > 0 ? (GLfloat) m_Misses / (GLfloat) m_Triangles : 0.0f;
+        }
+        
+        /**
+         * Average transform to vertex ratio, 1 means every vertex is transformed only once
+         */
+        GLfloat atvr() const {
+            return m_Vertices > 0 ? (GLfloat) m_Misses / (GLfloat) m_Vertices : 0.0f;
+        }
+        
+        void add(const VertexCacheStatistics& statistics){
+            m_Triangles += statistics.m_Triangles;
+            m_Vertices += statistics.m_Vertices;
+            m_Misses += statistics.m_Misses;
+        }
+        
+        GLuint m_Triangles; ///< number of triangles
+        GLuint m_Vertices; ///< number of distinct vertices referenced
+        GLuint m_Misses; ///< number of vertex shader invocations
+    };
+    
+    /**
+     * Reorders triangle lists and vertices for the GPU: triangles for the post transform
+     * vertex cache with Tipsify, clusters of them for less overdraw, and vertices in the order
+     * of first use for vertex fetch. Only the order changes, the triangles stay the same
+     */
+    class MeshOptimizer {
+    
+    public:
+        
+        static const GLuint CACHE_SIZE = 16; ///< vertex cache entries assumed by the optimization and the statistics
+        
+        /**
+         * Reorders a triangle list for the vertex cache
+         *
+         * @param indices Triangle list, reordered in place
+         * @param indexCount Number of indices
+         * @param vertexCount Number of vertices addressed by the indices
+         * @param clusters Receives the first triangle of each cluster, optional. Clusters start
+         * where the cache is cold, so they can be reordered by optimizeOverdraw
+         */
+        template <class I> static void optimizeVertexCache(I* indices, GLuint indexCount, GLuint vertexCount, std::vector<GLuint>* clusters = nullptr);
+        
+        /**
+         * Reorders the clusters of a cache optimized triangle list so that triangles facing
+         * out from the mesh are drawn first, they are the ones likely to hide the others
+         *
+         * @param indices Triangle list from optimizeVertexCache, reordered in place
+         * @param indexCount Number of indices
+         * @param vertices Vertices, each starting with its position
+         * @param vertexSize Size of one vertex
+         * @param clusters First triangle of each cluster
+         */
+        template <class I> static void optimizeOverdraw(I* indices, GLuint indexCount, const GLvoid* vertices, GLuint vertexSize, const std::vector<GLuint>& clusters);
+        
+        /**
+         * Moves the vertices to the order in which the indices first use them, unused vertices
+         * go last
+         *
+         * @param vertices Vertices, reordered in place
+         * @param vertexSize Size of one vertex
+         * @param vertexCount Number of vertices
+         * @param indices Indices, remapped to the new vertex order
+         */
+        static void optimizeVertexFetch(GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, std::vector<GLuint>& indices);
+        
+        /**
+         * Simulates the vertex cache over a triangle list
+         *
+         * @param indices Triangle list
+         * @param indexCount Number of indices
+         * @param vertexCount Number of vertices addressed by the indices
+         * @param cacheSize Number of cache entries
+         */
+        template <class I> static VertexCacheStatistics analyzeVertexCache(const I* indices, GLuint indexCount, GLuint vertexCount, GLuint cacheSize = CACHE_SIZE);
+        
+        /**
+         * Runs all stages on an imported mesh. Each level of detail is optimized on its own,
+         * the vertex order follows the full mesh
+         *
+         * @param vertices Vertices, each starting with its position, reordered in place
+         * @param vertexSize Size of one vertex
+         * @param vertexCount Number of vertices
+         * @param indices Indices of all levels of detail, reordered in place
+         * @param lods Levels of detail from MeshSimplifier::generateLods
+         * @param before Statistics of the full mesh before optimization are added to it
+         * @param after Statistics of the full mesh after optimization are added to it
+         */
+        static void optimize(GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, std::vector<GLuint>& indices, const std::vector<MeshLod>& lods, VertexCacheStatistics& before, VertexCacheStatistics& after);
+    };
+}
+
+#endif /* MeshOptimizer_h */
@@ -0,0 +1,364 @@
+//
+//  MeshSimplifier.cpp
+//  SDL-GLEW-App
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <unordered_map>
+
+#include "glm/glm.hpp"
+
+#include "MeshSimplifier.h"
+
+namespace Fox {
+    
+    static const GLuint MIN_LOD_TRIANGLES = 64; ///< smaller meshes get no levels of detail
+    static const GLfloat MIN_LOD_REDUCTION = 0.8f; ///< a level must drop at least a fifth of the triangles of the previous one
+    static const GLuint MAX_PASSES = 64; ///< collapse passes of one simplification
+    
+    /**
+     * Sum of squared distances to a set of planes, stored as the upper half of a symmetric 4x4 matrix
+     */
+    class Quadric {
+    public:
+        
+        Quadric() {
+            for(GLuint i = 0; i < 10; i++){
+                m_Q[i] = 0.0;
+            }
+        }
+        
+        /**
+         * Adds the plane n.p + d = 0, n is of unit length
+         */
+        void addPlane(const glm::vec3& n, double d){
+            m_Q[0] += n.x * n.x; m_Q[1] += n.x * n.y; m_Q[2] += n.x * n.z; m_Q[3] += n.x * d;
+            m_Q[4] += n.y * n.y; m_Q[5] += n.y * n.z; m_Q[6] += n.y * d;
+            m_Q[7] += n.z * n.z; m_Q[8] += n.z * d;
+            m_Q[9] += d * d;
+        }
+        
+        void add(const Quadric& q){
+            for(GLuint i = 0; i < 10; i++){
+                m_Q[i] += q.m_Q[i];
+            }
+        }
+        
+        /**
+         * Returns the sum of squared distances of a point to the planes
+         */
+        double error(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            return m_Q[0] * x * x + 2.0 * m_Q[1] * x * y + 2.0 * m_Q[2] * x * z + 2.0 * m_Q[3] * x
+                 + m_Q[4] * y * y + 2.0 * m_Q[5] * y * z + 2.0 * m_Q[6] * y
+                 + m_Q[7] * z * z + 2.0 * m_Q[8] * z
+                 + m_Q[9];
+        }
+        
+        double m_Q[10];
+    };
+    
+    /**
+     * Candidate collapse of vertex m_From onto vertex m_To
+     */
+    class Collapse {
+    public:
+        GLuint m_From;
+        GLuint m_To;
+        double m_Cost;
+    };
+    
+    static inline const glm::vec3& position(const GLvoid* vertices, GLuint vertexSize, GLuint index){
+        return *reinterpret_cast<const glm::vec3*>((const GLubyte*) vertices + (size_t) index * vertexSize);
+    }
+    
+    static inline uint64_t edgeKey(GLuint a, GLuint b){
+        return a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+    }
+    
+    /**
+     * Maps every vertex to the first vertex with identical bytes and finds the vertices that must
+     * not move: vertices on attribute seams, where one position has several different vertices,
+     * and vertices on open borders
+     */
+    static void classifyVertices(const GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, const std::vector<GLuint>& indices,
+                                 std::vector<GLuint>& remap, std::vector<GLboolean>& locked){
+        
+        const GLubyte* bytes = (const GLubyte*) vertices;
+        
+        // sorting by the raw bytes puts equal vertices next to each other, and equal positions
+        // too since every vertex format starts with the position
+        std::vector<GLuint> order(vertexCount);
+        for(GLuint i = 0; i < vertexCount; i++){
+            order[i] = i;
+        }
+        
+        std::sort(order.begin(), order.end(), [&](GLuint a, GLuint b){
+            return memcmp(bytes + (size_t) a * vertexSize, bytes + (size_t) b * vertexSize, vertexSize) < 0;
+        });
+        
+        remap.assign(vertexCount, 0);
+        locked.assign(vertexCount, false);
+        
+        std::vector<GLuint> positionGroup(vertexCount);
+        
+        for(GLuint begin = 0; begin < vertexCount; ){
+            
+            // run of vertices at the same position
+            GLuint end = begin + 1;
+            while(end < vertexCount && memcmp(bytes + (size_t) order[begin] * vertexSize, bytes + (size_t) order[end] * vertexSize, sizeof(glm::vec3)) == 0){
+                end++;
+            }
+            
+            GLboolean seam = false;
+            
+            for(GLuint i = begin; i < end; i++){
+                
+                GLuint vertex = order[i];
+                GLuint previous = order[i > begin ? i - 1 : i];
+                
+                if(i > begin && memcmp(bytes + (size_t) vertex * vertexSize, bytes + (size_t) previous * vertexSize, vertexSize) == 0){
+                    remap[vertex] = remap[previous];
+                } else {
+                    remap[vertex] = vertex;
+                    seam = seam || i > begin;
+                }
+                
+                positionGroup[vertex] = order[begin];
+            }
+            
+            for(GLuint i = begin; i < end && seam; i++){
+                locked[order[i]] = true;
+            }
+            
+            begin = end;
+        }
+        
+        // edges used by one triangle only are on a border
+        std::unordered_map<uint64_t, GLuint> edges;
+        edges.reserve(indices.size());
+        
+        for(GLuint i = 0; i < indices.size(); i += 3){
+            for(GLuint e = 0; e < 3; e++){
+                edges[edgeKey(positionGroup[indices[i + e]], positionGroup[indices[i + (e + 1) % 3]])]++;
+            }
+        }
+        
+        std::vector<GLboolean> border(vertexCount, false);
+        
+        for(const auto& edge : edges){
+            if(edge.second == 1){
+                border[edge.first >> 32] = true;
+                border[edge.first & 0xFFFFFFFF] = true;
+            }
+        }
+        
+        for(GLuint i = 0; i < vertexCount; i++){
+            locked[i] = locked[i] || border[positionGroup[i]];
+        }
+    }
+    
+    std::vector<GLuint> MeshSimplifier::simplify(const GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, const std::vector<GLuint>& indices, GLuint targetIndexCount, GLfloat& error) {
+        
+        std::vector<GLuint> remap;
+        std::vector<GLboolean> locked;
+        classifyVertices(vertices, vertexSize, vertexCount, indices, remap, locked);
+        
+        std::vector<GLuint> result(indices.size());
+        for(GLuint i = 0; i < indices.size(); i++){
+            result[i] = remap[indices[i]];
+        }
+        
+        // planes of the triangles around each vertex
+        std::vector<Quadric> quadrics(vertexCount);
+        
+        for(GLuint i = 0; i < result.size(); i += 3){
+            
+            const glm::vec3& p0 = position(vertices, vertexSize, result[i]);
+            const glm::vec3& p1 = position(vertices, vertexSize, result[i + 1]);
+            const glm::vec3& p2 = position(vertices, vertexSize, result[i + 2]);
+            
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            GLfloat length = glm::length(n);
+            
+            if(length <= 0.0f)
+                continue;
+            
+            n /= length;
+            double d = -glm::dot(n, p0);
+            
+            for(GLuint k = 0; k < 3; k++){
+                quadrics[result[i + k]].addPlane(n, d);
+            }
+        }
+        
+        std::vector<GLuint> offsets(vertexCount + 1);
+        std::vector<GLuint> adjacency;
+        std::vector<GLuint> collapseTo(vertexCount);
+        std::vector<GLboolean> touched(vertexCount);
+        std::vector<Collapse> collapses;
+        
+        for(GLuint pass = 0; pass < MAX_PASSES && result.size() > targetIndexCount; pass++){
+            
+            // triangles around each vertex
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for(GLuint index : result){
+                offsets[index + 1]++;
+            }
+            for(GLuint i = 0; i < vertexCount; i++){
+                offsets[i + 1] += offsets[i];
+            }
+            
+            adjacency.resize(result.size());
+            std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+            for(GLuint i = 0; i < result.size(); i++){
+                adjacency[fill[result[i]]++] = i / 3;
+            }
+            
+            // every edge can collapse both ways unless the moving vertex is locked
+            collapses.clear();
+            
+            for(GLuint i = 0; i < result.size(); i += 3){
+                for(GLuint e = 0; e < 3; e++){
+                    
+                    GLuint a = result[i + e];
+                    GLuint b = result[i + (e + 1) % 3];
+                    
+                    if(!locked[a]){
+                        const glm::vec3& target = position(vertices, vertexSize, b);
+                        collapses.push_back({a, b, quadrics[a].error(target) + quadrics[b].error(target)});
+                    }
+                    if(!locked[b]){
+                        const glm::vec3& target = position(vertices, vertexSize, a);
+                        collapses.push_back({b, a, quadrics[a].error(target) + quadrics[b].error(target)});
+                    }
+                }
+            }
+            
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b){
+                return a.m_Cost < b.m_Cost;
+            });
+            
+            for(GLuint i = 0; i < vertexCount; i++){
+                collapseTo[i] = i;
+                touched[i] = false;
+            }
+            
+            GLuint triangles = (GLuint) result.size() / 3;
+            GLuint applied = 0;
+            
+            // only the cheaper half of a pass, the rest is costed again after the collapses around it
+            size_t limit = (collapses.size() + 1) / 2;
+            
+            for(size_t c = 0; c < limit && triangles * 3 > targetIndexCount; c++){
+                
+                const Collapse& collapse = collapses[c];
+                GLuint a = collapse.m_From;
+                GLuint b = collapse.m_To;
+                
+                if(touched[a] || touched[b])
+                    continue;
+                
+                // reject collapses that flip a remaining triangle
+                const glm::vec3& target = position(vertices, vertexSize, b);
+                GLboolean flips = false;
+                GLuint removed = 0;
+                
+                for(GLuint k = offsets[a]; k < offsets[a + 1] && !flips; k++){
+                    
+                    const GLuint* triangle = &result[adjacency[k] * 3];
+                    
+                    if(triangle[0] == b || triangle[1] == b || triangle[2] == b){
+                        removed++;
+                        continue;
+                    }
+                    
+                    glm::vec3 p[3], q[3];
+                    for(GLuint v = 0; v < 3; v++){
+                        p[v] = position(vertices, vertexSize, triangle[v]);
+                        q[v] = triangle[v] == a ? target : p[v];
+                    }
+                    
+                    glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                    
+                    flips = glm::dot(before, after) <= 0.0f;
+                }
+                
+                if(flips)
+                    continue;
+                
+                collapseTo[a] = b;
+                quadrics[b].add(quadrics[a]);
+                triangles -= removed;
+                applied++;
+                
+                error = std::max(error, (GLfloat) std::sqrt(std::max(collapse.m_Cost, 0.0)));
+                
+                // the neighbourhood of both vertices changed, leave it to the next pass
+                for(GLuint vertex : {a, b}){
+                    for(GLuint k = offsets[vertex]; k < offsets[vertex + 1]; k++){
+                        const GLuint* triangle = &result[adjacency[k] * 3];
+                        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+                    }
+                }
+            }
+            
+            if(applied == 0)
+                break;
+            
+            // apply the collapses and drop the triangles that became degenerate
+            GLuint write = 0;
+            
+            for(GLuint i = 0; i < result.size(); i += 3){
+                
+                GLuint v0 = collapseTo[result[i]];
+                GLuint v1 = collapseTo[result[i + 1]];
+                GLuint v2 = collapseTo[result[i + 2]];
+                
+                if(v0 == v1 || v1 == v2 || v0 == v2)
+                    continue;
+                
+                result[write++] = v0;
+                result[write++] = v1;
+                result[write++] = v2;
+            }
+            
+            result.resize(write);
+        }
+        
+        return result;
+    }
+    
+    std::vector<MeshLod> MeshSimplifier::generateLods(const GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, std::vector<GLuint>& indices) {
+        
+        std::vector<MeshLod> lods;
+        lods.push_back(MeshLod(0, (GLuint) indices.size(), 0.0f));
+        
+        if(indices.size() < MIN_LOD_TRIANGLES * 3)
+            return lods;
+        
+        std::vector<GLuint> previous = indices;
+        GLfloat error = 0.0f;
+        
+        // each level is simplified from the previous one, its error includes the errors before it
+        while(lods.size() < MAX_LODS){
+            
+            GLuint target = (GLuint) previous.size() / 6 * 3;
+            std::vector<GLuint> lod = simplify(vertices, vertexSize, vertexCount, previous, target, error);
+            
+            if(lod.empty() || lod.size() > previous.size() * MIN_LOD_REDUCTION)
+                break;
+            
+            lods.push_back(MeshLod((GLuint) indices.size(), (GLuint) lod.size(), error));
+            indices.insert(indices.end(), lod.begin(), lod.end());
+            
+            previous.swap(lod);
+        }
+        
+        return lods;
+    }
+}
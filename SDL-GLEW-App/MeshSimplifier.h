@@ -0,0 +1,69 @@
+//
+//  MeshSimplifier.h
+//  SDL-GLEW-App
+//
+
+#ifndef MeshSimplifier_h
+#define MeshSimplifier_h
+
+#include <GL/glew.h>
+
+#include <vector>
+
+namespace Fox {
+    
+    static const GLuint MAX_LODS = 4; ///< levels of detail of a mesh, the full mesh included
+    
+    /**
+     * Level of detail of a mesh, a range of the index buffer over the vertices of the full mesh
+     */
+    class MeshLod {
+    public:
+        
+        MeshLod() : m_IndexOffset(0), m_IndexCount(0), m_Error(0.0f) {}
+        
+        MeshLod(GLuint indexOffset, GLuint indexCount, GLfloat error) : m_IndexOffset(indexOffset), m_IndexCount(indexCount), m_Error(error) {}
+        
+        GLuint m_IndexOffset; ///< first index of the level
+        GLuint m_IndexCount; ///< number of indices of the level
+        GLfloat m_Error; ///< largest distance from the full mesh in object space
+    };
+    
+    /**
+     * Reduces triangle meshes with edge collapses ordered by quadric error metric. Vertices are
+     * collapsed onto their neighbours, so simplified meshes are index lists over the original
+     * vertices and the vertex buffer is shared by all levels of detail. Vertices on open borders
+     * and on attribute seams stay in place
+     */
+    class MeshSimplifier {
+    
+    public:
+        
+        /**
+         * Simplifies a triangle list
+         *
+         * @param vertices Vertices, each starting with its position, whole vertices are compared to find seams
+         * @param vertexSize Size of one vertex
+         * @param vertexCount Number of vertices
+         * @param indices Triangle list
+         * @param targetIndexCount Number of indices to reduce to
+         * @param error Set to the largest distance of a collapse, not less than its value on input
+         * @return simplified triangle list, may stay above the target when no collapse is left
+         */
+        static std::vector<GLuint> simplify(const GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, const std::vector<GLuint>& indices, GLuint targetIndexCount, GLfloat& error);
+        
+        /**
+         * Appends coarser levels of detail to a triangle list, each with half the triangles of
+         * the previous one. Generation stops early when a level would not save enough
+         *
+         * @param vertices Vertices, each starting with its position
+         * @param vertexSize Size of one vertex
+         * @param vertexCount Number of vertices
+         * @param indices Full triangle list, the levels are appended to it
+         * @return levels of detail, the first one is the full mesh
+         */
+        static std::vector<MeshLod> generateLods(const GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, std::vector<GLuint>& indices);
+    };
+}
+
+#endif /* MeshSimplifier_h */
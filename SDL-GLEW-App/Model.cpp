@@ -6,263 +6,428 @@
 //  Copyright © 2017 Olli Kettunen. All rights reserved.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
 #include "Model.h"
 
 namespace Fox {
     
+    /**
+     * Assimp file system that notes the files an import opens besides the model itself,
+     * e.g. the material libraries of an OBJ file
+     */
+    class RecordingIOSystem : public Assimp::DefaultIOSystem {
+    
+    public:
+        
+        RecordingIOSystem(const std::string& source, ModelCache& cache) : m_Source(source), m_Cache(cache) {}
+        
+        virtual Assimp::IOStream* Open(const char* file, const char* mode = "rb"){
+            
+            if(m_Source != file){
+                m_Cache.addDependency(file);
+            }
+            
+            return Assimp::DefaultIOSystem::Open(file, mode);
+        }
+    
+    private:
+        
+        std::string m_Source;
+        ModelCache& m_Cache;
+    };
+    
     void Model::loadModel(std::string path, GLboolean bumpMapping){
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        
+        this->directory = path.substr(0, path.find_last_of('/'));
+        
+        GLuint vertexSize = bumpMapping ? sizeof(VertexPNTTB) : sizeof(Vertex);
+        std::string cachePath = path + (bumpMapping ? ".bumped.cache" : ".cache");
+        
+        ModelCache cache;
+        
+        // warm start, skip Assimp when there is an up to date cache. A parser chosen with
+        // FOX_OBJ_PARSER always imports, so that each start prints its parse rate
+        if(std::getenv("FOX_OBJ_PARSER") == nullptr && cache.open(cachePath, path, vertexSize)){
+            
+            loadCache(cache, bumpMapping);
+            
+            std::cout << path << " loaded from cache in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+            return;
+        }
+        
+        m_CacheBefore = VertexCacheStatistics();
+        m_CacheAfter = VertexCacheStatistics();
+        
+        std::string extension = path.substr(std::min(path.find_last_of('.'), path.size()));
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        
+        GLboolean imported = useObjLoader() && extension == ".obj" ? importObj(path, cache, bumpMapping) : importScene(path, cache, bumpMapping);
+        
+        if(!imported)
+            return;
+        
+        std::cout << path << " vertex cache ACMR " << m_CacheBefore.acmr() << " -> " << m_CacheAfter.acmr() << ", ATVR " << m_CacheBefore.atvr() << " -> " << m_CacheAfter.atvr() << std::endl;
+        
+        if(!cache.write(cachePath, path, vertexSize)){
+            std::cout << "Could not write model cache " << cachePath << std::endl;
+        }
+        
+        std::cout << path << " imported in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+    }
     
+    GLboolean Model::useObjLoader(){
+        
+        const char* parser = std::getenv("FOX_OBJ_PARSER");
+        
+        return parser == nullptr || std::string(parser) != "assimp";
+    }
+    
+    GLboolean Model::importScene(const std::string& path, ModelCache& cache, GLboolean bumpMapping){
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        
+        // the importer owns the file system
         Assimp::Importer import;
-        const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals |aiProcess_CalcTangentSpace);
+        import.SetIOHandler(new RecordingIOSystem(path, cache));
+        const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
         
         // check if evertything is loaded properly
         if(!scene) {
             std::cout << "No scene. Assimp error: " << import.GetErrorString() << std::endl;
-            return;
+            return false;
         }
-        
+ 
  /**      if(scene->mFlags | AI_SCENE_FLAGS_INCOMPLETE) {
             std::cout << "Scene incomplete. Assimp error: " << import.GetErrorString() << std::endl;
             return;
         }*/
         if(!scene->mRootNode){
             std::cout << "No root node. Assimp error: " << import.GetErrorString() << std::endl;
-            return;
+            return false;
         }
         
-        this->directory = path.substr(0, path.find_last_of('/'));
+        uint64_t size;
+        int64_t time;
+        
+        // throughput of the importer, to compare with ObjLoader
+        if(ModelCache::stamp(path, size, time)){
+            GLdouble ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            std::cout << path << " parsed by Assimp in " << ms << " ms, " << (GLdouble) size / (1024.0 * 1024.0) / (ms / 1000.0) << " MB/s" << std::endl;
+        }
         
         // start processing from root node
-        processNode(scene->mRootNode, scene, bumpMapping);
+        std::vector<aiMesh*> meshes;
+        collectMeshes(scene->mRootNode, scene, meshes);
+        
+        if(!bumpMapping){
+            loadMeshes<Vertex>((GLuint) meshes.size(), [&](GLuint i, StagedMesh<Vertex>& staged) {
+                stageMesh(meshes[i], scene, staged);
+            }, cache);
+        } else {
+            loadMeshes<VertexPNTTB>((GLuint) meshes.size(), [&](GLuint i, StagedMesh<VertexPNTTB>& staged) {
+                stageMesh(meshes[i], scene, staged);
+            }, cache);
+        }
+        
+        return true;
     }
     
-    void Model::processNode(aiNode* node , const aiScene* scene, GLboolean bumpMapping){
+    GLboolean Model::importObj(const std::string& path, ModelCache& cache, GLboolean bumpMapping){
         
-        MeshBase* meshBase;
+        ObjLoader obj;
         
-        // process all nodes meshes
-        for(GLuint i = 0; i < node->mNumMeshes; i++){
+        if(!obj.load(path)){
+            std::cout << "Could not read " << path << std::endl;
+            return false;
+        }
         
-            aiMesh* aMesh = scene->mMeshes[node->mMeshes[i]];
-            
-            // if no bump mapping, load normal mesh, otherwise mesh with normal map
-            if(!bumpMapping) {
-                Mesh<Vertex>* mesh = processMesh(aMesh, scene);
-                meshBase = mesh;
-            } else {
-                Mesh<VertexPNTTB>* bumpedMesh = processBumpedMesh(aMesh, scene);
-                meshBase = bumpedMesh;
-            }
-            m_Meshes.push_back(meshBase);
+        for(const std::string& library : obj.getLibraries()){
+            cache.addDependency(library);
         }
         
-        // process children
-        for(GLuint i = 0; i < node->mNumChildren; i++){
-            processNode(node->mChildren[i], scene, bumpMapping);
+        if(!bumpMapping){
+            loadMeshes<Vertex>(obj.getMeshCount(), [&](GLuint i, StagedMesh<Vertex>& staged) {
+                stageMesh(obj, i, staged);
+            }, cache);
+        } else {
+            loadMeshes<VertexPNTTB>(obj.getMeshCount(), [&](GLuint i, StagedMesh<VertexPNTTB>& staged) {
+                stageMesh(obj, i, staged);
+            }, cache);
         }
+        
+        return true;
     }
     
-    Mesh<Vertex>* Model::processMesh(aiMesh* mesh, const aiScene* scene){
+    void Model::submit(GLContext* gl, RenderQueue& queue, ShaderVariants& variants, GLuint features, const glm::mat4& model) {
         
-        std::vector<Vertex> vertices;
-        std::vector<GLuint> indices;
+        RenderContext& rc = gl->getCurrentRenderContext();
         
-        // processs vertices
-        for(GLuint i = 0; i < mesh->mNumVertices; i++) {
+        GLuint meshCount = (GLuint) m_Meshes.size();
+        GLuint first = gl->getCurrentRenderContextIndex() * meshCount;
+        
+        if(m_SelectedLods.size() < first + meshCount){
+            m_SelectedLods.resize(first + meshCount, 0);
+        }
+        
+        // largest scale of the model matrix, object space errors grow with it
+        GLfloat scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        
+        // pixels covered by one world space unit at unit distance
+        GLfloat pixelsPerUnit = rc.m_Projection[1][1] * (GLfloat) rc.m_ViewPortHeight * 0.5f;
+        
+        m_SubmittedTriangles = 0;
+        
+        for(GLuint i = 0; i < meshCount; i++){
             
-            Vertex vertex;
+            MeshBase* mesh = m_Meshes[i];
             
-            // process position
-            glm::vec3 position;
-            position.x = mesh->mVertices[i].x;
-            position.y = mesh->mVertices[i].y;
-            position.z = mesh->mVertices[i].z;
-            vertex.m_Position = position;
+            glm::vec3 center = glm::vec3(model * glm::vec4(mesh->m_BoundingSphere.m_Center, 1.0f));
+            GLfloat distance = glm::length(center - rc.m_Camera.m_Position) - mesh->m_BoundingSphere.m_Radius * scale;
+            
+            // the full mesh when the camera is inside the bounds
+            GLuint lod = 0;
             
+            if(distance > rc.m_Near){
+                lod = mesh->selectLod(scale * pixelsPerUnit / distance, m_SelectedLods[first + i], m_LodPixelError);
+            }
             
-            // process normals
-            glm::vec3 normal;
-            normal.x = mesh->mNormals[i].x;
-            normal.y = mesh->mNormals[i].y;
-            normal.z = mesh->mNormals[i].z;
-            vertex.m_Normal = normal;
-           
+            m_SelectedLods[first + i] = lod;
+            m_SubmittedTriangles += mesh->getLodTriangles(lod);
             
-            // does the mesh contain textures coordinates
-            if(mesh->mTextureCoords[0]) {
-                // process texture coordinates
-                glm::vec2 uvs;
-                uvs.x = mesh->mTextureCoords[0][i].x;
-                uvs.y = mesh->mTextureCoords[0][i].y;
-                vertex.m_TexCoords = uvs;
-                
+            mesh->submit(queue, variants.getShader(gl, features | mesh->getFeatures()), model, lod);
+        }
+    }
+    
+    void Model::loadCache(const ModelCache& cache, GLboolean bumpMapping){
+        
+        for(GLuint i = 0; i < cache.getMeshCount(); i++){
+            
+            const ModelCache::MeshEntry& entry = cache.getMesh(i);
+            
+            MeshBase* meshBase;
+            
+            // buffers are filled straight from the mapped file, levels of detail included
+            if(!bumpMapping){
+                Mesh<Vertex>* mesh = new Mesh<Vertex>(cache.getVertices<Vertex>(entry), entry.m_VertexCount, cache.getIndices(entry), entry.m_IndexCount, GL_STATIC_DRAW, true);
+                mesh->setLods(cache.getLods(entry));
+                meshBase = mesh;
+            } else {
+                Mesh<VertexPNTTB>* mesh = new Mesh<VertexPNTTB>(cache.getVertices<VertexPNTTB>(entry), entry.m_VertexCount, cache.getIndices(entry), entry.m_IndexCount, GL_STATIC_DRAW, true);
+                mesh->setLods(cache.getLods(entry));
+                meshBase = mesh;
             }
-            else {
-                
-                vertex.m_TexCoords = glm::vec2(0.0f, 0.0f);
+            
+            meshBase->m_BoundingSphere.m_Center = entry.m_Center;
+            meshBase->m_BoundingSphere.m_Radius = entry.m_Radius;
+            
+            std::vector<std::string> texturePaths(Texture::TextureType_Max);
+            
+            for(GLuint t = 0; t < Texture::TextureType_Max; t++){
+                texturePaths[t] = cache.getTexturePath(entry, (Texture::TextureType) t);
             }
             
-            vertices.push_back(vertex);
+            addTextures(meshBase, texturePaths);
+            
+            m_Meshes.push_back(meshBase);
         }
+    }
+    
+    void Model::collectMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes){
         
-        // process indices
-        for(GLuint i = 0; i < mesh->mNumFaces; i++) {
-            aiFace face = mesh->mFaces[i];
-            
-            for(GLuint j = 0; j < face.mNumIndices; j++){
-                indices.push_back(face.mIndices[j]);
-                
+        // process all nodes meshes
+        for(GLuint i = 0; i < node->mNumMeshes; i++){
+            meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+        }
+        
+        // process children
+        for(GLuint i = 0; i < node->mNumChildren; i++){
+            collectMeshes(node->mChildren[i], scene, meshes);
+        }
+    }
+    
+    template <class V, class F>
+    void Model::loadMeshes(GLuint meshCount, F stage, ModelCache& cache){
+        
+        std::vector<StagedMesh<V>> staged(meshCount);
+        
+        GLuint threads = std::min(std::max(std::thread::hardware_concurrency(), 1u), MAX_LOAD_THREADS);
+        threads = std::min(threads, meshCount);
+        
+        // meshes differ a lot in size, so each thread takes the next one when it is done
+        std::atomic<GLuint> next(0);
+        
+        auto work = [&]() {
+            for(GLuint i = next++; i < meshCount; i = next++){
+                stage(i, staged[i]);
             }
+        };
+        
+        std::vector<std::thread> workers;
+        
+        for(GLuint t = 1; t < threads; t++){
+            workers.push_back(std::thread(work));
         }
         
-        Mesh<Vertex>* m = new Mesh<Vertex>(vertices, indices, GL_STATIC_DRAW);
+        // the GL thread converts meshes too instead of waiting
+        work();
         
-       
-        // process material
-        if(mesh->mMaterialIndex >= 0) {
+        for(std::thread& worker : workers){
+            worker.join();
+        }
+        
+        // buffers, textures and the cache in file order, staging memory is released as soon as a mesh is uploaded
+        m_Meshes.reserve(m_Meshes.size() + staged.size());
+        
+        for(StagedMesh<V>& s : staged){
             
-            aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-            std::vector<Texture*> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, Texture::Diffuse);
+            // meshes of all models share the vertex arrays and buffers of the geometry arena
+            Mesh<V>* m = new Mesh<V>(s.m_Vertices.data(), (GLuint) s.m_Vertices.size(), s.m_Indices.data(), (GLuint) s.m_Indices.size(), GL_STATIC_DRAW, true);
+            m->setLods(s.m_Lods);
+            m->m_BoundingSphere = s.m_BoundingSphere;
             
-            // add only first diffuse map
-            if(diffuseMaps.size() > 0)
-            m->addTexture(diffuseMaps[0]);
+            addTextures(m, s.m_TexturePaths);
             
-            std::vector<Texture*> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, Texture::Specular);
+            cache.addMesh(s.m_Vertices.data(), (GLuint) s.m_Vertices.size(), sizeof(V), s.m_Indices, s.m_Lods, s.m_BoundingSphere, s.m_TexturePaths);
             
-            // add only first specular map
-            if(specularMaps.size() > 0)
-                m->addTexture(specularMaps[0]);
+            m_CacheBefore.add(s.m_CacheBefore);
+            m_CacheAfter.add(s.m_CacheAfter);
             
-            std::vector<Texture*> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, Texture::Normal);
-       //     std::cout << normalMaps.size() << std::endl;
-            // add only first normal map
-            if(normalMaps.size() > 0){
-                m->addTexture(normalMaps[0]);
-            }
-    
+            m_Meshes.push_back(m);
+            
+            s = StagedMesh<V>();
         }
-        
-        return m;
     }
     
-    Mesh<VertexPNTTB>* Model::processBumpedMesh(aiMesh* mesh, const aiScene* scene) {
+    static inline void generateTangents(std::vector<Vertex>& vertices, const std::vector<GLuint>& indices){
+        // no tangent frame without normal mapping
+    }
+    
+    static inline void generateTangents(std::vector<VertexPNTTB>& vertices, const std::vector<GLuint>& indices){
+        // tangents follow the texture coordinates, instead of aiProcess_CalcTangentSpace
+        NormalGenerator::generateTangents(vertices, indices);
+    }
     
-        std::vector<VertexPNTTB> vertices;
-        std::vector<GLuint> indices;
+    template <class V>
+    void Model::stageMesh(aiMesh* mesh, const aiScene* scene, StagedMesh<V>& staged) const {
+        
+        std::vector<V>& vertices = staged.m_Vertices;
+        std::vector<GLuint>& indices = staged.m_Indices;
+        
+        vertices.resize(mesh->mNumVertices);
         
         // processs vertices
         for(GLuint i = 0; i < mesh->mNumVertices; i++) {
             
-            VertexPNTTB vertex;
+            V& vertex = vertices[i];
             
             // process position
-            glm::vec3 position;
-            position.x = mesh->mVertices[i].x;
-            position.y = mesh->mVertices[i].y;
-            position.z = mesh->mVertices[i].z;
-            vertex.m_Position = position;
-            
-            
-            // process normals
-            glm::vec3 normal;
-            normal.x = mesh->mNormals[i].x;
-            normal.y = mesh->mNormals[i].y;
-            normal.z = mesh->mNormals[i].z;
-            vertex.m_Normal = normal;
+            vertex.m_Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
             
+            // process normals, generated below when the file has none
+            if(mesh->mNormals) {
+                vertex.m_Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            }
             
             // does the mesh contain textures coordinates
             if(mesh->mTextureCoords[0]) {
-                // process texture coordinates
-                glm::vec2 uvs;
-                uvs.x = mesh->mTextureCoords[0][i].x;
-                uvs.y = mesh->mTextureCoords[0][i].y;
-                vertex.m_TexCoords = uvs;
-                
-            }
-            else {
-                
+                vertex.m_TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+            } else {
                 vertex.m_TexCoords = glm::vec2(0.0f, 0.0f);
             }
-            
-            // process tangents
-            glm::vec3 tangent;
-            tangent.x = mesh->mTangents[i].x;
-            tangent.y = mesh->mTangents[i].y;
-            tangent.z = mesh->mTangents[i].z;
-            vertex.m_Tangent = tangent;
-            
-            // processs bitangents
-            glm::vec3 bitangent;
-            bitangent.x = mesh->mBitangents[i].x;
-            bitangent.y = mesh->mBitangents[i].y;
-            bitangent.z = mesh->mBitangents[i].z;
-            vertex.m_Bitangent = bitangent;
-            
-            vertices.push_back(vertex);
         }
         
-        // process indices
+        // process indices, faces are triangles after aiProcess_Triangulate
+        indices.reserve(mesh->mNumFaces * 3);
+        
         for(GLuint i = 0; i < mesh->mNumFaces; i++) {
-            aiFace face = mesh->mFaces[i];
+            
+            const aiFace& face = mesh->mFaces[i];
             
             for(GLuint j = 0; j < face.mNumIndices; j++){
                 indices.push_back(face.mIndices[j]);
-                
             }
         }
         
-        Mesh<VertexPNTTB>* m = new Mesh<VertexPNTTB>(vertices, indices, GL_STATIC_DRAW);
+        // process material
+        staged.m_TexturePaths = getTexturePaths(scene->mMaterials[mesh->mMaterialIndex]);
         
+        processStagedMesh(staged, mesh->mNormals != nullptr);
+    }
+    
+    template <class V>
+    void Model::stageMesh(const ObjLoader& obj, GLuint mesh, StagedMesh<V>& staged) const {
         
-        // process material
-        if(mesh->mMaterialIndex >= 0) {
-            
-            aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-            std::vector<Texture*> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, Texture::Diffuse);
-            
-            // add only first diffuse map
-            if(diffuseMaps.size() > 0)
-                m->addTexture(diffuseMaps[0]);
-            
-            std::vector<Texture*> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, Texture::Specular);
-            
-            // add only first specular map
-            if(specularMaps.size() > 0)
-                m->addTexture(specularMaps[0]);
-            
-            std::vector<Texture*> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, Texture::Normal);
-            //std::cout << normalMaps.size() << std::endl;
-            if(normalMaps.size() > 0){
-                m->addTexture(normalMaps[0]);
-            }
-            
-        }
+        // identical corners are joined like with aiProcess_JoinIdenticalVertices
+        obj.getMesh(mesh, staged.m_Vertices, staged.m_Indices);
+        staged.m_TexturePaths = obj.getTexturePaths(mesh);
         
-        return m;
+        processStagedMesh(staged, obj.hasNormals(mesh));
     }
     
+    template <class V>
+    void Model::processStagedMesh(StagedMesh<V>& staged, GLboolean hasNormals) const {
+        
+        std::vector<V>& vertices = staged.m_Vertices;
+        std::vector<GLuint>& indices = staged.m_Indices;
+        
+        // smooth normals over the shared vertices, instead of aiProcess_GenNormals
+        if(!hasNormals)
+            NormalGenerator::generateNormals(vertices, indices);
+        
+        generateTangents(vertices, indices);
+        
+        // coarser levels of detail are appended to the indices and share the vertices
+        staged.m_Lods = MeshSimplifier::generateLods(vertices.data(), sizeof(V), (GLuint) vertices.size(), indices);
+        
+        // file order of the faces is poor for the vertex cache, the cache stores the optimized order
+        MeshOptimizer::optimize(vertices.data(), sizeof(V), (GLuint) vertices.size(), indices, staged.m_Lods, staged.m_CacheBefore, staged.m_CacheAfter);
+        
+        staged.m_BoundingSphere = BoundingSphere(vertices);
+    }
     
+    std::vector<std::string> Model::getTexturePaths(aiMaterial* material) const {
+        
+        std::vector<std::string> texturePaths(Texture::TextureType_Max);
+        
+        // only the first texture of each type is used
+        texturePaths[Texture::Diffuse] = getTexturePath(material, aiTextureType_DIFFUSE);
+        texturePaths[Texture::Specular] = getTexturePath(material, aiTextureType_SPECULAR);
+        texturePaths[Texture::Normal] = getTexturePath(material, aiTextureType_HEIGHT);
+        
+        return texturePaths;
+    }
     
-    std::vector<Texture*> Model::loadMaterialTextures(aiMaterial* material, aiTextureType type,
-                                                      Texture::TextureType texType) {
+    std::string Model::getTexturePath(aiMaterial* material, aiTextureType type) const {
+        
+        if(material->GetTextureCount(type) == 0)
+            return std::string();
+        
+        aiString str;
+        material->GetTexture(type, 0, &str);
+        
+        return directory + '/' + std::string(str.C_Str());
+    }
     
-        std::vector<Texture*> textures;
+    void Model::addTextures(MeshBase* mesh, const std::vector<std::string>& texturePaths) {
         
-        for(GLuint i = 0; i < material->GetTextureCount(type); i++)
-        {
-            aiString str;
-            material->GetTexture(type, i, &str);
+        TextureManager* textureManager = TextureManager::Instance();
+        
+        for(GLuint i = 0; i < texturePaths.size(); i++){
             
-            std::string filename = std::string(str.C_Str());
-            filename = directory + '/' + filename;
+            if(texturePaths[i].empty())
+                continue;
             
-            const GLchar* filePath = filename.c_str();
+            Texture::TextureType texType = (Texture::TextureType) i;
+            const GLchar* filePath = texturePaths[i].c_str();
             
-            Texture* texture = nullptr;
-            TextureManager* textureManager = TextureManager::Instance();
-            texture = textureManager->loadTexture(filePath, texType);
+            Texture* texture = textureManager->loadTexture(filePath, texType);
             
             if(texture->m_Type != texType){
                 
@@ -270,13 +435,9 @@ namespace Fox {
                 std::cout << texture->m_Type << std::endl;
                 std::cout << "----------" << std::endl;
                 texture->m_Type = texType;
-               // std::cout << "error " << texType << " " << filePath << std::endl;
-                
-                //textureManager->printAll();
             }
             
-            textures.push_back(texture);
+            mesh->addTexture(texture);
         }
-        return textures;
     }
 }
@@ -14,23 +14,45 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/DefaultIOSystem.h>
 
+#include <string>
 #include <vector>
 
 #include "GLContext.h"
 #include "Mesh.h"
 #include "TextureManager.h"
 #include "Vector.h"
+#include "ModelCache.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
 
 namespace Fox {
     
+    /**
+     * Imported mesh converted on a worker thread, waiting for its buffers on the GL thread
+     */
+    template <class V> class StagedMesh {
+    public:
+        std::vector<V> m_Vertices;
+        std::vector<GLuint> m_Indices; ///< all levels of detail
+        std::vector<MeshLod> m_Lods;
+        BoundingSphere m_BoundingSphere;
+        std::vector<std::string> m_TexturePaths; ///< texture path of each Texture::TextureType
+        VertexCacheStatistics m_CacheBefore; ///< vertex cache in file order
+        VertexCacheStatistics m_CacheAfter; ///< vertex cache after MeshOptimizer
+    };
+    
     /**
      * Model consists of several meshes
      */
     class Model {
     
     public:
-        Model(){}
+        
+        static const GLuint MAX_LOAD_THREADS = 8; ///< upper limit of threads converting imported meshes
+        
+        Model() : m_LodPixelError(1.0f), m_SubmittedTriangles(0) {}
         
         
         /**
@@ -38,7 +60,7 @@ namespace Fox {
          *
          * @param path Path to the model data
          */
-        Model(GLchar* path, GLboolean bumpMapping = false){
+        Model(GLchar* path, GLboolean bumpMapping = false) : m_LodPixelError(1.0f), m_SubmittedTriangles(0) {
             loadModel(path, bumpMapping);
         }
         
@@ -54,6 +76,41 @@ namespace Fox {
             }
         }
         
+        /**
+         * Submits all meshes of this model to a render queue
+         *
+         * @param queue Render queue
+         * @param shader Shader index in GLContext
+         * @param model Model matrix
+         */
+        void submit(RenderQueue& queue, GLuint shader, const glm::mat4& model) {
+            for(GLuint i = 0; i < m_Meshes.size(); i++){
+                m_Meshes[i]->submit(queue, shader, model);
+            }
+        }
+        
+        /**
+         * Submits all meshes of this model to a render queue, each with the cheapest variant
+         * that covers the scene features and the features of the mesh. The level of detail of
+         * each mesh is picked by its projected size in the current render context
+         *
+         * @param gl GLContext
+         * @param queue Render queue
+         * @param variants Shader variants
+         * @param features Scene features, see ShaderVariants::Feature
+         * @param model Model matrix
+         */
+        void submit(GLContext* gl, RenderQueue& queue, ShaderVariants& variants, GLuint features, const glm::mat4& model);
+        
+        /**
+         * Returns number of triangles submitted by the latest submit
+         */
+        inline GLuint getSubmittedTriangles() const {
+            return m_SubmittedTriangles;
+        }
+        
+        GLfloat m_LodPixelError; ///< largest error of a level of detail on screen, in pixels
+        
         void drawWireframe(GLContext* gl){
             for(GLuint i = 0; i < m_Meshes.size(); i++){
                 m_Meshes[i]->drawWireframe(gl);
@@ -66,45 +123,129 @@ namespace Fox {
             }
         }
         
+        /**
+         * Deletes the meshes of this model and returns their geometry to the arena. Copies of
+         * the model share the meshes, so this is called on one of them only
+         */
+        void release(){
+            for(GLuint i = 0; i < m_Meshes.size(); i++){
+                m_Meshes[i]->release();
+                delete m_Meshes[i];
+            }
+            m_Meshes.clear();
+            m_SelectedLods.clear();
+        }
+    
     private:
         
         /**
-         * Loads the model from path
+         * Loads the model from path, from the binary cache next to it when the cache is up to date
          *
          * @param path Path of the model
          */
         void loadModel(std::string path, GLboolean bumpMapping = false);
         
         /**
-         * Processes an aiNode
+         * Creates meshes from an opened model cache
+         *
+         * @param cache Model cache
+         */
+        void loadCache(const ModelCache& cache, GLboolean bumpMapping);
+        
+        /**
+         * Returns true if OBJ files are read by ObjLoader, the default. Setting the environment
+         * variable FOX_OBJ_PARSER to assimp reads them with Assimp and to objloader with ObjLoader,
+         * either skips the model cache so that the parse rates of both can be compared. Other
+         * formats are always read by Assimp
+         */
+        static GLboolean useObjLoader();
+        
+        /**
+         * Imports a model with Assimp
+         *
+         * @param path Path of the model
+         * @param cache Cache receiving the processed meshes
+         * @return false if the model could not be read
+         */
+        GLboolean importScene(const std::string& path, ModelCache& cache, GLboolean bumpMapping);
+        
+        /**
+         * Imports an OBJ model with ObjLoader
+         *
+         * @param path Path of the model
+         * @param cache Cache receiving the processed meshes
+         * @return false if the model could not be read
+         */
+        GLboolean importObj(const std::string& path, ModelCache& cache, GLboolean bumpMapping);
+        
+        /**
+         * Collects the meshes of an aiNode and its children in drawing order
          *
          * @param node aiNode to be processed
          * @param scene aiScene
+         * @param meshes Receives the meshes
+         */
+        void collectMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes);
+        
+        /**
+         * Converts the meshes on worker threads, then creates their buffers on the GL thread
+         *
+         * @param meshCount Number of meshes
+         * @param stage Function filling the StagedMesh<V> of a mesh index, called on worker threads
+         * @param cache Cache receiving the processed meshes
          */
-        void processNode(aiNode* node, const aiScene* scene, GLboolean bumpMapping = false);
+        template <class V, class F> void loadMeshes(GLuint meshCount, F stage, ModelCache& cache);
         
         /**
-         * Processes an aiMesh to Mesh<Vertex>
+         * Converts an aiMesh to vertices and indices with levels of detail, makes no GL calls
          *
          * @param mesh aiMesh to be processed
          * @param scene aiScene
-         * @return Mesh<Vertex>
+         * @param staged Receives the converted mesh
+         */
+        template <class V> void stageMesh(aiMesh* mesh, const aiScene* scene, StagedMesh<V>& staged) const;
+        
+        /**
+         * Converts a mesh of an OBJ file like stageMesh of an aiMesh
+         *
+         * @param obj Loaded OBJ file
+         * @param mesh Mesh index in the file
+         * @param staged Receives the converted mesh
          */
-        Mesh<Vertex>* processMesh(aiMesh* mesh, const aiScene* scene);
+        template <class V> void stageMesh(const ObjLoader& obj, GLuint mesh, StagedMesh<V>& staged) const;
         
-        Mesh<VertexPNTTB>* processBumpedMesh(aiMesh* mesh, const aiScene* scene);
+        /**
+         * Generates normals when the file has none, tangents, levels of detail and bounds of a
+         * staged mesh and optimizes its order
+         *
+         * @param staged Mesh with vertices, indices and texture paths
+         * @param hasNormals false if the normals must be generated
+         */
+        template <class V> void processStagedMesh(StagedMesh<V>& staged, GLboolean hasNormals) const;
         
         /**
-         * Loads the materials from aiMaterial of given type
+         * Returns path of the first texture of each Texture::TextureType, empty if there is none
          *
          * @param material aiMaterial to be processed
-         * @param type Type of the textures
          */
-        std::vector<Texture*> loadMaterialTextures(aiMaterial* material, aiTextureType type,
-                                                   Texture::TextureType texType);
-    
+        std::vector<std::string> getTexturePaths(aiMaterial* material) const;
+        
+        std::string getTexturePath(aiMaterial* material, aiTextureType type) const;
+        
+        /**
+         * Loads textures and adds them to a mesh
+         *
+         * @param mesh Mesh receiving the textures
+         * @param texturePaths Texture path of each texture type
+         */
+        void addTextures(MeshBase* mesh, const std::vector<std::string>& texturePaths);
+        
         std::string directory; ///< model file directory
         std::vector<MeshBase*> m_Meshes; ///< all meshes of this model
+        std::vector<GLuint> m_SelectedLods; ///< level of detail of each mesh in each render context, for hysteresis
+        GLuint m_SubmittedTriangles; ///< statistics of the latest submit
+        VertexCacheStatistics m_CacheBefore; ///< vertex cache of the imported meshes in file order
+        VertexCacheStatistics m_CacheAfter; ///< vertex cache of the imported meshes after MeshOptimizer
         
     };
 }
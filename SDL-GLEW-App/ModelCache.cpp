@@ -0,0 +1,252 @@
+//
+//  ModelCache.cpp
+//  SDL-GLEW-App
+//
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "ModelCache.h"
+
+namespace Fox {
+    
+    static const GLuint BLOB_ALIGNMENT = 16; ///< alignment of vertex and index blobs in the file
+    
+    static uint64_t align(uint64_t offset) {
+        return (offset + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT;
+    }
+    
+    GLboolean ModelCache::stamp(const std::string& path, uint64_t& size, int64_t& time) {
+        
+        struct stat info;
+        
+        if(stat(path.c_str(), &info) != 0)
+            return false;
+        
+        size = (uint64_t) info.st_size;
+        time = (int64_t) info.st_mtime;
+        
+        return true;
+    }
+    
+    /**
+     * Stamps a dependency, a missing file gets size MISSING
+     */
+    static void stampDependency(const std::string& path, ModelCache::Dependency& dependency) {
+        
+        if(!ModelCache::stamp(path, dependency.m_Size, dependency.m_Time)){
+            dependency.m_Size = ModelCache::MISSING;
+            dependency.m_Time = 0;
+        }
+    }
+    
+    GLboolean ModelCache::open(const std::string& cachePath, const std::string& sourcePath, GLuint vertexSize) {
+        
+        close();
+        
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        
+        if(!stamp(sourcePath, sourceSize, sourceTime))
+            return false;
+        
+        int file = ::open(cachePath.c_str(), O_RDONLY);
+        
+        if(file < 0)
+            return false;
+        
+        struct stat info;
+        
+        if(fstat(file, &info) != 0 || (size_t) info.st_size < sizeof(Header)){
+            ::close(file);
+            return false;
+        }
+        
+        void* data = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        
+        // the mapping stays valid after the descriptor is closed
+        ::close(file);
+        
+        if(data == MAP_FAILED)
+            return false;
+        
+        m_Data = (const GLubyte*) data;
+        m_Size = (size_t) info.st_size;
+        
+        const Header& h = header();
+        
+        // outdated or foreign cache
+        if(h.m_Magic != MAGIC || h.m_Version != VERSION || h.m_VertexSize != vertexSize ||
+           h.m_SourceSize != sourceSize || h.m_SourceTime != sourceTime ||
+           sizeof(Header) + (uint64_t) h.m_MeshCount * sizeof(MeshEntry) + (uint64_t) h.m_DependencyCount * sizeof(Dependency) > m_Size){
+            close();
+            return false;
+        }
+        
+        // a material library or another dependency changed since
+        for(GLuint i = 0; i < h.m_DependencyCount; i++){
+            
+            const Dependency& stored = getDependency(i);
+            
+            if((uint64_t) stored.m_PathOffset + stored.m_PathLength > m_Size){
+                close();
+                return false;
+            }
+            
+            Dependency current;
+            stampDependency(std::string(reinterpret_cast<const char*>(m_Data + stored.m_PathOffset), stored.m_PathLength), current);
+            
+            if(current.m_Size != stored.m_Size || current.m_Time != stored.m_Time){
+                close();
+                return false;
+            }
+        }
+        
+        // truncated cache
+        for(GLuint i = 0; i < h.m_MeshCount; i++){
+            
+            const MeshEntry& mesh = getMesh(i);
+            
+            GLboolean valid = mesh.m_VertexOffset + (uint64_t) mesh.m_VertexCount * vertexSize <= m_Size &&
+                              mesh.m_IndexOffset + (uint64_t) mesh.m_IndexCount * sizeof(GLuint) <= m_Size;
+            
+            for(GLuint t = 0; t < Texture::TextureType_Max; t++){
+                valid = valid && (uint64_t) mesh.m_PathOffset[t] + mesh.m_PathLength[t] <= m_Size;
+            }
+            
+            valid = valid && mesh.m_LodCount >= 1 && mesh.m_LodCount <= MAX_LODS;
+            
+            for(GLuint l = 0; valid && l < mesh.m_LodCount; l++){
+                valid = (uint64_t) mesh.m_Lods[l].m_IndexOffset + mesh.m_Lods[l].m_IndexCount <= mesh.m_IndexCount;
+            }
+            
+            if(!valid){
+                close();
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    void ModelCache::close() {
+        
+        if(m_Data != nullptr){
+            munmap((void*) m_Data, m_Size);
+        }
+        
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+    
+    void ModelCache::addMesh(const void* vertices, GLuint vertexCount, GLuint vertexSize, const std::vector<GLuint>& indices,
+                             const std::vector<MeshLod>& lods, const BoundingSphere& bounds, const std::vector<std::string>& texturePaths) {
+        
+        MeshEntry mesh;
+        
+        mesh.m_VertexOffset = m_Vertices.size();
+        mesh.m_IndexOffset = m_Indices.size() * sizeof(GLuint);
+        mesh.m_VertexCount = vertexCount;
+        mesh.m_IndexCount = (GLuint) indices.size();
+        mesh.m_Center = bounds.m_Center;
+        mesh.m_Radius = bounds.m_Radius;
+        mesh.m_LodCount = (GLuint) std::min<size_t>(lods.size(), MAX_LODS);
+        
+        for(GLuint l = 0; l < mesh.m_LodCount; l++){
+            mesh.m_Lods[l] = lods[l];
+        }
+        
+        for(GLuint t = 0; t < Texture::TextureType_Max; t++){
+            
+            mesh.m_PathOffset[t] = (GLuint) m_Paths.size();
+            mesh.m_PathLength[t] = 0;
+            
+            if(t < texturePaths.size()){
+                mesh.m_PathLength[t] = (GLuint) texturePaths[t].size();
+                m_Paths += texturePaths[t];
+            }
+        }
+        
+        const GLubyte* bytes = (const GLubyte*) vertices;
+        m_Vertices.insert(m_Vertices.end(), bytes, bytes + (size_t) vertexCount * vertexSize);
+        m_Indices.insert(m_Indices.end(), indices.begin(), indices.end());
+        
+        m_Entries.push_back(mesh);
+    }
+    
+    GLboolean ModelCache::write(const std::string& cachePath, const std::string& sourcePath, GLuint vertexSize) {
+        
+        // zeroed so that the padding is written deterministically
+        Header h = Header();
+        h.m_Magic = MAGIC;
+        h.m_Version = VERSION;
+        h.m_VertexSize = vertexSize;
+        h.m_MeshCount = (GLuint) m_Entries.size();
+        h.m_DependencyCount = (GLuint) m_Dependencies.size();
+        
+        if(!stamp(sourcePath, h.m_SourceSize, h.m_SourceTime))
+            return false;
+        
+        // file layout: header, mesh entries, dependencies, vertex blob, index blob, texture and dependency paths
+        uint64_t entriesEnd = sizeof(Header) + m_Entries.size() * sizeof(MeshEntry) + m_Dependencies.size() * sizeof(Dependency);
+        uint64_t vertexBlob = align(entriesEnd);
+        uint64_t indexBlob = align(vertexBlob + m_Vertices.size());
+        uint64_t pathBlob = indexBlob + m_Indices.size() * sizeof(GLuint);
+        
+        std::vector<MeshEntry> entries = m_Entries;
+        
+        for(MeshEntry& mesh : entries){
+            
+            mesh.m_VertexOffset += vertexBlob;
+            mesh.m_IndexOffset += indexBlob;
+            
+            for(GLuint t = 0; t < Texture::TextureType_Max; t++){
+                mesh.m_PathOffset[t] += (GLuint) pathBlob;
+            }
+        }
+        
+        std::vector<Dependency> dependencies(m_Dependencies.size());
+        std::string paths = m_Paths;
+        
+        for(GLuint i = 0; i < m_Dependencies.size(); i++){
+            
+            stampDependency(m_Dependencies[i], dependencies[i]);
+            
+            dependencies[i].m_PathOffset = (GLuint) (pathBlob + paths.size());
+            dependencies[i].m_PathLength = (GLuint) m_Dependencies[i].size();
+            paths += m_Dependencies[i];
+        }
+        
+        // write to a temporary file first so that a crash never leaves a partial cache
+        std::string temporaryPath = cachePath + ".tmp";
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        
+        if(!file)
+            return false;
+        
+        const char padding[BLOB_ALIGNMENT] = {0};
+        
+        file.write((const char*) &h, sizeof(Header));
+        file.write((const char*) entries.data(), entries.size() * sizeof(MeshEntry));
+        file.write((const char*) dependencies.data(), dependencies.size() * sizeof(Dependency));
+        file.write(padding, vertexBlob - entriesEnd);
+        file.write((const char*) m_Vertices.data(), m_Vertices.size());
+        file.write(padding, indexBlob - (vertexBlob + m_Vertices.size()));
+        file.write((const char*) m_Indices.data(), m_Indices.size() * sizeof(GLuint));
+        file.write(paths.data(), paths.size());
+        file.close();
+        
+        if(!file || std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0){
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+        
+        return true;
+    }
+}
@@ -0,0 +1,202 @@
+//
+//  ModelCache.h
+//  SDL-GLEW-App
+//
+
+#ifndef ModelCache_h
+#define ModelCache_h
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Texture.h"
+#include "BoundingVolume.h"
+#include "MeshSimplifier.h"
+
+namespace Fox {
+    
+    /**
+     * Binary cache of an imported model. The file holds vertices, indices, bounds and texture
+     * paths of every mesh and is memory mapped on load so that buffers are uploaded straight
+     * from the mapping. A cache is valid only for the size and modification time of the source
+     * file and of its dependencies, e.g. material libraries, it was written for
+     */
+    class ModelCache {
+    
+    public:
+        
+        static const GLuint MAGIC = 0x43584F46; ///< "FOXC"
+        static const GLuint VERSION = 5; ///< bump when the layout changes
+        
+        /**
+         * Beginning of a cache file
+         */
+        class Header {
+        public:
+            GLuint m_Magic;
+            GLuint m_Version;
+            GLuint m_VertexSize; ///< size of one vertex, tells the vertex format apart
+            GLuint m_MeshCount;
+            GLuint m_DependencyCount; ///< dependency entries after the mesh entries
+            uint64_t m_SourceSize; ///< size of the source file
+            int64_t m_SourceTime; ///< modification time of the source file
+        };
+        
+        /**
+         * File read together with the source, e.g. a material library
+         */
+        class Dependency {
+        public:
+            uint64_t m_Size; ///< MISSING if the file did not exist
+            int64_t m_Time;
+            GLuint m_PathOffset;
+            GLuint m_PathLength;
+        };
+        
+        static const uint64_t MISSING = ~0ull; ///< size of a dependency that did not exist
+        
+        /**
+         * Mesh entry, entries follow the header. Offsets are from the beginning of the file
+         */
+        class MeshEntry {
+        public:
+            uint64_t m_VertexOffset;
+            uint64_t m_IndexOffset;
+            GLuint m_VertexCount;
+            GLuint m_IndexCount; ///< indices of all levels of detail
+            GLuint m_LodCount; ///< levels of detail, at least the full mesh
+            MeshLod m_Lods[MAX_LODS]; ///< index ranges of the levels of detail
+            glm::vec3 m_Center; ///< bounding sphere center
+            GLfloat m_Radius; ///< bounding sphere radius
+            GLuint m_PathOffset[Texture::TextureType_Max]; ///< texture path of each type
+            GLuint m_PathLength[Texture::TextureType_Max]; ///< zero if the mesh has no texture of the type
+        };
+        
+        ModelCache() : m_Data(nullptr), m_Size(0) {}
+        
+        ~ModelCache(){
+            close();
+        }
+        
+        /**
+         * Maps a cache file for reading
+         *
+         * @param cachePath Path of the cache file
+         * @param sourcePath Path of the model the cache was made from
+         * @param vertexSize Size of the expected vertex format
+         * @return false if the cache is missing, outdated or of another format
+         */
+        GLboolean open(const std::string& cachePath, const std::string& sourcePath, GLuint vertexSize);
+        
+        /**
+         * Unmaps an opened cache file
+         */
+        void close();
+        
+        inline GLuint getMeshCount() const {
+            return header().m_MeshCount;
+        }
+        
+        inline const MeshEntry& getMesh(GLuint index) const {
+            return reinterpret_cast<const MeshEntry*>(m_Data + sizeof(Header))[index];
+        }
+        
+        /**
+         * Returns vertices of a mesh inside the mapping
+         */
+        template<class V> const V* getVertices(const MeshEntry& mesh) const {
+            return reinterpret_cast<const V*>(m_Data + mesh.m_VertexOffset);
+        }
+        
+        /**
+         * Returns indices of a mesh inside the mapping
+         */
+        inline const GLuint* getIndices(const MeshEntry& mesh) const {
+            return reinterpret_cast<const GLuint*>(m_Data + mesh.m_IndexOffset);
+        }
+        
+        /**
+         * Returns levels of detail of a mesh
+         */
+        inline std::vector<MeshLod> getLods(const MeshEntry& mesh) const {
+            return std::vector<MeshLod>(mesh.m_Lods, mesh.m_Lods + mesh.m_LodCount);
+        }
+        
+        /**
+         * Returns texture path of given type, empty if there is none
+         */
+        inline std::string getTexturePath(const MeshEntry& mesh, Texture::TextureType type) const {
+            return std::string(reinterpret_cast<const char*>(m_Data + mesh.m_PathOffset[type]), mesh.m_PathLength[type]);
+        }
+        
+        /**
+         * Adds a mesh to be written
+         *
+         * @param vertices Vertex data
+         * @param vertexCount Number of vertices
+         * @param vertexSize Size of one vertex
+         * @param indices Index data of all levels of detail
+         * @param lods Levels of detail
+         * @param bounds Bounding sphere of the mesh
+         * @param texturePaths Texture path of each texture type, empty for none
+         */
+        void addMesh(const void* vertices, GLuint vertexCount, GLuint vertexSize, const std::vector<GLuint>& indices,
+                     const std::vector<MeshLod>& lods, const BoundingSphere& bounds, const std::vector<std::string>& texturePaths);
+        
+        /**
+         * Adds a file the meshes were read from besides the source, the cache is outdated when
+         * it changes, appears or disappears
+         *
+         * @param path Path of the file
+         */
+        inline void addDependency(const std::string& path) {
+            m_Dependencies.push_back(path);
+        }
+        
+        /**
+         * Writes the added meshes and dependencies to a cache file
+         *
+         * @param cachePath Path of the cache file
+         * @param sourcePath Path of the model the meshes were imported from
+         * @param vertexSize Size of one vertex
+         * @return true on success
+         */
+        GLboolean write(const std::string& cachePath, const std::string& sourcePath, GLuint vertexSize);
+        
+        /**
+         * Reads size and modification time of a file
+         *
+         * @return false if the file does not exist
+         */
+        static GLboolean stamp(const std::string& path, uint64_t& size, int64_t& time);
+    
+    private:
+        
+        ModelCache(const ModelCache&) = delete;
+        ModelCache& operator=(const ModelCache&) = delete;
+        
+        inline const Header& header() const {
+            return *reinterpret_cast<const Header*>(m_Data);
+        }
+        
+        inline const Dependency& getDependency(GLuint index) const {
+            return reinterpret_cast<const Dependency*>(m_Data + sizeof(Header) + header().m_MeshCount * sizeof(MeshEntry))[index];
+        }
+        
+        const GLubyte* m_Data; ///< mapped cache file
+        size_t m_Size; ///< size of the mapping
+        
+        std::vector<MeshEntry> m_Entries; ///< meshes to write, offsets relative to their blobs
+        std::vector<GLubyte> m_Vertices; ///< vertex blob to write
+        std::vector<GLuint> m_Indices; ///< index blob to write
+        std::string m_Paths; ///< texture path blob to write
+        std::vector<std::string> m_Dependencies; ///< dependency paths to write
+    };
+}
+
+#endif /* ModelCache_h */
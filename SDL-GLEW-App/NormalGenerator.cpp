@@ -0,0 +1,357 @@
+//
+//  NormalGenerator.cpp
+//  SDL-GLEW-App
+//
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "glm/glm.hpp"
+
+#include "NormalGenerator.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace Fox {
+    
+    static const GLuint MIN_TRIANGLES_PER_THREAD = 16384; ///< smaller meshes are not worth a thread
+    static const GLuint MIN_VERTICES_PER_THREAD = 16384;
+    static const GLfloat MIN_LENGTH_SQUARED = 1e-20f; ///< shorter vectors have no direction
+    
+    /**
+     * Per vertex sums of one worker as separate x, y and z arrays, padded to a multiple of
+     * four so that the last vertices can be loaded as a whole batch
+     */
+    class VectorSums {
+    public:
+        
+        void resize(GLuint count){
+            GLuint padded = (count + 3) & ~3u;
+            m_X.assign(padded, 0.0f);
+            m_Y.assign(padded, 0.0f);
+            m_Z.assign(padded, 0.0f);
+        }
+        
+        void add(GLuint i, const glm::vec3& v){
+            m_X[i] += v.x;
+            m_Y[i] += v.y;
+            m_Z[i] += v.z;
+        }
+        
+        std::vector<GLfloat> m_X;
+        std::vector<GLfloat> m_Y;
+        std::vector<GLfloat> m_Z;
+    };
+    
+    static inline glm::vec3& attribute3(GLvoid* vertices, GLuint vertexSize, GLuint index, GLuint offset){
+        return *reinterpret_cast<glm::vec3*>((GLubyte*) vertices + (size_t) index * vertexSize + offset);
+    }
+    
+    static inline const glm::vec2& attribute2(GLvoid* vertices, GLuint vertexSize, GLuint index, GLuint offset){
+        return *reinterpret_cast<const glm::vec2*>((GLubyte*) vertices + (size_t) index * vertexSize + offset);
+    }
+    
+    /**
+     * Returns the number of threads for an amount of work, at least one
+     */
+    static GLuint threadCount(GLuint work, GLuint minWork){
+        
+        GLuint threads = std::thread::hardware_concurrency();
+        threads = std::min(threads, NormalGenerator::MAX_THREADS);
+        threads = std::min(threads, work / minWork);
+        
+        return threads > 0 ? threads : 1;
+    }
+    
+    /**
+     * Calls function(thread, begin, end) for consecutive ranges of [0, count), one range per
+     * thread. Ranges start at multiples of four, the calling thread takes the first one
+     */
+    template <class F> static void parallelFor(GLuint threads, GLuint count, F function){
+        
+        GLuint chunk = ((count + threads - 1) / threads + 3) & ~3u;
+        
+        std::vector<std::thread> workers;
+        
+        for(GLuint t = 1; t < threads; t++){
+            GLuint begin = std::min(count, t * chunk);
+            GLuint end = std::min(count, begin + chunk);
+            workers.push_back(std::thread(function, t, begin, end));
+        }
+        
+        function(0, 0, std::min(count, chunk));
+        
+        for(std::thread& worker : workers){
+            worker.join();
+        }
+    }
+    
+    /**
+     * Adds the sums of all workers into the first one over a vertex range
+     */
+    static void reduce(std::vector<VectorSums>& sums, GLuint begin, GLuint end){
+        
+        VectorSums& total = sums[0];
+        
+        for(GLuint s = 1; s < sums.size(); s++){
+            for(GLuint i = begin; i < end; i++){
+                total.m_X[i] += sums[s].m_X[i];
+                total.m_Y[i] += sums[s].m_Y[i];
+                total.m_Z[i] += sums[s].m_Z[i];
+            }
+        }
+    }
+    
+    /**
+     * Normalizes a range of vectors in place, vectors without a direction become zero.
+     * The range starts at a multiple of four
+     */
+    static void normalize(VectorSums& v, GLuint begin, GLuint end){
+
+#if defined(__SSE__)
+        
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 minLength = _mm_set1_ps(MIN_LENGTH_SQUARED);
+        
+        // the arrays are padded, the last batch may run past end
+        for(GLuint i = begin; i < end; i += 4){
+            
+            __m128 x = _mm_loadu_ps(&v.m_X[i]);
+            __m128 y = _mm_loadu_ps(&v.m_Y[i]);
+            __m128 z = _mm_loadu_ps(&v.m_Z[i]);
+            
+            __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+            __m128 valid = _mm_cmpgt_ps(lengthSquared, minLength);
+            __m128 inverse = _mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(lengthSquared, minLength))));
+            
+            _mm_storeu_ps(&v.m_X[i], _mm_mul_ps(x, inverse));
+            _mm_storeu_ps(&v.m_Y[i], _mm_mul_ps(y, inverse));
+            _mm_storeu_ps(&v.m_Z[i], _mm_mul_ps(z, inverse));
+        }
+
+#else
+        
+        for(GLuint i = begin; i < end; i++){
+            
+            GLfloat lengthSquared = v.m_X[i] * v.m_X[i] + v.m_Y[i] * v.m_Y[i] + v.m_Z[i] * v.m_Z[i];
+            GLfloat inverse = lengthSquared > MIN_LENGTH_SQUARED ? 1.0f / std::sqrt(lengthSquared) : 0.0f;
+            
+            v.m_X[i] *= inverse;
+            v.m_Y[i] *= inverse;
+            v.m_Z[i] *= inverse;
+        }
+
+#endif
+    }
+    
+    void NormalGenerator::generateNormals(GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, GLuint normalOffset, const GLuint* indices, GLuint indexCount) {
+        
+        GLuint triangleCount = indexCount / 3;
+        
+        if(vertexCount == 0)
+            return;
+        
+        GLuint threads = threadCount(triangleCount, MIN_TRIANGLES_PER_THREAD);
+        std::vector<VectorSums> sums(threads);
+        
+        // each worker sums the face normals of its triangles into its own buffers
+        parallelFor(threads, triangleCount, [&](GLuint thread, GLuint begin, GLuint end) {
+            
+            VectorSums& sum = sums[thread];
+            sum.resize(vertexCount);
+            
+            for(GLuint t = begin; t < end; t++){
+                
+                GLuint a = indices[3 * t];
+                GLuint b = indices[3 * t + 1];
+                GLuint c = indices[3 * t + 2];
+                
+                const glm::vec3& pa = attribute3(vertices, vertexSize, a, 0);
+                const glm::vec3& pb = attribute3(vertices, vertexSize, b, 0);
+                const glm::vec3& pc = attribute3(vertices, vertexSize, c, 0);
+                
+                // the length of the cross product weights the normal by the area
+                glm::vec3 n = glm::cross(pb - pa, pc - pa);
+                
+                sum.add(a, n);
+                sum.add(b, n);
+                sum.add(c, n);
+            }
+        });
+        
+        // vertex ranges do not overlap, so they are added, normalized and written without locks
+        parallelFor(threadCount(vertexCount, MIN_VERTICES_PER_THREAD), vertexCount, [&](GLuint, GLuint begin, GLuint end) {
+            
+            reduce(sums, begin, end);
+            normalize(sums[0], begin, end);
+            
+            for(GLuint i = begin; i < end; i++){
+                attribute3(vertices, vertexSize, i, normalOffset) = glm::vec3(sums[0].m_X[i], sums[0].m_Y[i], sums[0].m_Z[i]);
+            }
+        });
+    }
+    
+    void NormalGenerator::generateTangents(GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, GLuint normalOffset, GLuint texCoordsOffset, GLuint tangentOffset, GLuint bitangentOffset, const GLuint* indices, GLuint indexCount) {
+        
+        GLuint triangleCount = indexCount / 3;
+        
+        if(vertexCount == 0)
+            return;
+        
+        GLuint threads = threadCount(triangleCount, MIN_TRIANGLES_PER_THREAD);
+        std::vector<VectorSums> tangents(threads);
+        std::vector<VectorSums> bitangents(threads);
+        
+        parallelFor(threads, triangleCount, [&](GLuint thread, GLuint begin, GLuint end) {
+            
+            VectorSums& tangent = tangents[thread];
+            VectorSums& bitangent = bitangents[thread];
+            tangent.resize(vertexCount);
+            bitangent.resize(vertexCount);
+            
+            for(GLuint t = begin; t < end; t++){
+                
+                GLuint a = indices[3 * t];
+                GLuint b = indices[3 * t + 1];
+                GLuint c = indices[3 * t + 2];
+                
+                const glm::vec3& pa = attribute3(vertices, vertexSize, a, 0);
+                glm::vec3 edge1 = attribute3(vertices, vertexSize, b, 0) - pa;
+                glm::vec3 edge2 = attribute3(vertices, vertexSize, c, 0) - pa;
+                
+                const glm::vec2& uva = attribute2(vertices, vertexSize, a, texCoordsOffset);
+                glm::vec2 delta1 = attribute2(vertices, vertexSize, b, texCoordsOffset) - uva;
+                glm::vec2 delta2 = attribute2(vertices, vertexSize, c, texCoordsOffset) - uva;
+                
+                GLfloat determinant = delta1.x * delta2.y - delta2.x * delta1.y;
+                
+                // no texture mapping to follow
+                if(std::fabs(determinant) < 1e-12f)
+                    continue;
+                
+                GLfloat r = 1.0f / determinant;
+                glm::vec3 faceTangent = (edge1 * delta2.y - edge2 * delta1.y) * r;
+                glm::vec3 faceBitangent = (edge2 * delta1.x - edge1 * delta2.x) * r;
+                
+                tangent.add(a, faceTangent);
+                tangent.add(b, faceTangent);
+                tangent.add(c, faceTangent);
+                bitangent.add(a, faceBitangent);
+                bitangent.add(b, faceBitangent);
+                bitangent.add(c, faceBitangent);
+            }
+        });
+        
+        parallelFor(threadCount(vertexCount, MIN_VERTICES_PER_THREAD), vertexCount, [&](GLuint, GLuint begin, GLuint end) {
+            
+            reduce(tangents, begin, end);
+            reduce(bitangents, begin, end);
+            
+            VectorSums& tangent = tangents[0];
+            VectorSums& bitangent = bitangents[0];
+            
+            // normals of the range in the same layout as the sums
+            VectorSums normals;
+            normals.resize(end - begin);
+            
+            for(GLuint i = begin; i < end; i++){
+                const glm::vec3& n = attribute3(vertices, vertexSize, i, normalOffset);
+                normals.m_X[i - begin] = n.x;
+                normals.m_Y[i - begin] = n.y;
+                normals.m_Z[i - begin] = n.z;
+            }
+
+#if defined(__SSE__)
+            
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 minLength = _mm_set1_ps(MIN_LENGTH_SQUARED);
+            const __m128 signBit = _mm_set1_ps(-0.0f);
+            
+            for(GLuint i = begin; i < end; i += 4){
+                
+                __m128 nx = _mm_loadu_ps(&normals.m_X[i - begin]);
+                __m128 ny = _mm_loadu_ps(&normals.m_Y[i - begin]);
+                __m128 nz = _mm_loadu_ps(&normals.m_Z[i - begin]);
+                
+                __m128 tx = _mm_loadu_ps(&tangent.m_X[i]);
+                __m128 ty = _mm_loadu_ps(&tangent.m_Y[i]);
+                __m128 tz = _mm_loadu_ps(&tangent.m_Z[i]);
+                
+                // Gram-Schmidt, remove the normal component of the tangent
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, tx), _mm_mul_ps(ny, ty)), _mm_mul_ps(nz, tz));
+                tx = _mm_sub_ps(tx, _mm_mul_ps(nx, d));
+                ty = _mm_sub_ps(ty, _mm_mul_ps(ny, d));
+                tz = _mm_sub_ps(tz, _mm_mul_ps(nz, d));
+                
+                __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+                __m128 valid = _mm_cmpgt_ps(lengthSquared, minLength);
+                __m128 inverse = _mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(lengthSquared, minLength))));
+                tx = _mm_mul_ps(tx, inverse);
+                ty = _mm_mul_ps(ty, inverse);
+                tz = _mm_mul_ps(tz, inverse);
+                
+                // bitangent is cross(n, t), flipped where the texture mapping is mirrored
+                __m128 cx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+                __m128 cy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+                __m128 cz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+                
+                __m128 handedness = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_loadu_ps(&bitangent.m_X[i])), _mm_mul_ps(cy, _mm_loadu_ps(&bitangent.m_Y[i]))), _mm_mul_ps(cz, _mm_loadu_ps(&bitangent.m_Z[i])));
+                __m128 flip = _mm_and_ps(_mm_cmplt_ps(handedness, zero), signBit);
+                
+                _mm_storeu_ps(&tangent.m_X[i], tx);
+                _mm_storeu_ps(&tangent.m_Y[i], ty);
+                _mm_storeu_ps(&tangent.m_Z[i], tz);
+                _mm_storeu_ps(&bitangent.m_X[i], _mm_xor_ps(cx, flip));
+                _mm_storeu_ps(&bitangent.m_Y[i], _mm_xor_ps(cy, flip));
+                _mm_storeu_ps(&bitangent.m_Z[i], _mm_xor_ps(cz, flip));
+            }
+
+#else
+            
+            for(GLuint i = begin; i < end; i++){
+                
+                glm::vec3 n(normals.m_X[i - begin], normals.m_Y[i - begin], normals.m_Z[i - begin]);
+                glm::vec3 t(tangent.m_X[i], tangent.m_Y[i], tangent.m_Z[i]);
+                glm::vec3 b(bitangent.m_X[i], bitangent.m_Y[i], bitangent.m_Z[i]);
+                
+                t -= n * glm::dot(n, t);
+                
+                GLfloat lengthSquared = glm::dot(t, t);
+                t *= lengthSquared > MIN_LENGTH_SQUARED ? 1.0f / std::sqrt(lengthSquared) : 0.0f;
+                
+                glm::vec3 c = glm::cross(n, t);
+                c *= glm::dot(c, b) < 0.0f ? -1.0f : 1.0f;
+                
+                tangent.m_X[i] = t.x; tangent.m_Y[i] = t.y; tangent.m_Z[i] = t.z;
+                bitangent.m_X[i] = c.x; bitangent.m_Y[i] = c.y; bitangent.m_Z[i] = c.z;
+            }
+
+#endif
+            
+            for(GLuint i = begin; i < end; i++){
+                
+                glm::vec3 t(tangent.m_X[i], tangent.m_Y[i], tangent.m_Z[i]);
+                glm::vec3 b(bitangent.m_X[i], bitangent.m_Y[i], bitangent.m_Z[i]);
+                
+                // no usable texture mapping, any frame around the normal will do
+                if(t.x == 0.0f && t.y == 0.0f && t.z == 0.0f){
+                    
+                    const glm::vec3& n = attribute3(vertices, vertexSize, i, normalOffset);
+                    glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                    
+                    t = glm::cross(n, axis);
+                    GLfloat length = glm::length(t);
+                    t = length > 0.0f ? t / length : axis;
+                    b = glm::cross(n, t);
+                }
+                
+                attribute3(vertices, vertexSize, i, tangentOffset) = t;
+                attribute3(vertices, vertexSize, i, bitangentOffset) = b;
+            }
+        });
+    }
+}
@@ -0,0 +1,68 @@
+//
+//  NormalGenerator.h
+//  SDL-GLEW-App
+//
+
+#ifndef NormalGenerator_h
+#define NormalGenerator_h
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace Fox {
+    
+    /**
+     * Generates smooth vertex normals and tangent frames of indexed triangle lists. Triangles
+     * are split between worker threads that each sum into their own buffers, the buffers are
+     * then added together and normalized per vertex range, four vertices at a time
+     */
+    class NormalGenerator {
+    
+    public:
+        
+        static const GLuint MAX_THREADS = 8; ///< upper limit of worker threads
+        
+        /**
+         * Sets each normal to the area weighted average of the normals of its triangles
+         *
+         * @param vertices Vertices with m_Position and m_Normal
+         * @param indices Triangle list
+         */
+        template <class V> static void generateNormals(std::vector<V>& vertices, const std::vector<GLuint>& indices){
+            generateNormals(vertices.data(), sizeof(V), (GLuint) vertices.size(), offsetof(V, m_Normal), indices.data(), (GLuint) indices.size());
+        }
+        
+        /**
+         * Sets tangents and bitangents from the texture coordinates. Tangents are made
+         * orthogonal to the normals, which must already be set, and bitangents keep the
+         * handedness of the texture mapping
+         *
+         * @param vertices Vertices with m_Position, m_Normal, m_TexCoords, m_Tangent and m_Bitangent
+         * @param indices Triangle list
+         */
+        template <class V> static void generateTangents(std::vector<V>& vertices, const std::vector<GLuint>& indices){
+            generateTangents(vertices.data(), sizeof(V), (GLuint) vertices.size(), offsetof(V, m_Normal), offsetof(V, m_TexCoords), offsetof(V, m_Tangent), offsetof(V, m_Bitangent), indices.data(), (GLuint) indices.size());
+        }
+        
+        /**
+         * Generates normals of vertices given as raw data, each vertex starts with its position
+         *
+         * @param vertices Vertex data
+         * @param vertexSize Size of one vertex
+         * @param vertexCount Number of vertices
+         * @param normalOffset Offset of the normal in a vertex
+         * @param indices Triangle list
+         * @param indexCount Number of indices
+         */
+        static void generateNormals(GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, GLuint normalOffset, const GLuint* indices, GLuint indexCount);
+        
+        /**
+         * Generates tangents of vertices given as raw data, each vertex starts with its position
+         */
+        static void generateTangents(GLvoid* vertices, GLuint vertexSize, GLuint vertexCount, GLuint normalOffset, GLuint texCoordsOffset, GLuint tangentOffset, GLuint bitangentOffset, const GLuint* indices, GLuint indexCount);
+    };
+}
+
+#endif /* NormalGenerator_h */
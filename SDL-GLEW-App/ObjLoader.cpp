@@ -0,0 +1,633 @@
+//
+//  ObjLoader.cpp
+//  SDL-GLEW-App
+//
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "ObjLoader.h"
+
+namespace Fox {
+    
+    static const GLint MISSING = -1; ///< corner without the attribute
+    static const int64_t RELATIVE = -((int64_t) 1 << 40); ///< offset of indices relative to a chunk
+    
+    /**
+     * Part of an OBJ file parsed by one thread. Negative indices of the file count back from
+     * the latest attribute and may reach into the chunks before, they are stored as RELATIVE
+     * plus the index in the chunk until the attributes of the chunks before are counted
+     */
+    class ObjChunk {
+    public:
+        const char* m_Begin;
+        const char* m_End;
+        std::vector<glm::vec3> m_Positions;
+        std::vector<glm::vec2> m_TexCoords;
+        std::vector<glm::vec3> m_Normals;
+        std::vector<int64_t> m_Corners; ///< position, texture coordinates and normal of each triangle corner
+        std::vector<size_t> m_SwitchCorners; ///< corner where each usemtl takes effect
+        std::vector<std::string> m_SwitchNames; ///< material of each usemtl
+        std::vector<std::string> m_Libraries; ///< mtllib file names
+    };
+    
+    static inline bool isSpace(char c){
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+    
+    static inline bool isDigit(char c){
+        return c >= '0' && c <= '9';
+    }
+    
+    static inline const char* skipSpaces(const char* p, const char* end){
+        while(p < end && isSpace(*p)){
+            p++;
+        }
+        return p;
+    }
+    
+    static inline const char* skipLine(const char* p, const char* end){
+        while(p < end && *p != '\n'){
+            p++;
+        }
+        return p < end ? p + 1 : end;
+    }
+    
+    /**
+     * Returns rest of the line without surrounding spaces, used for names that may contain spaces
+     */
+    static std::string restOfLine(const char* p, const char* end){
+        
+        p = skipSpaces(p, end);
+        
+        const char* last = p;
+        while(last < end && *last != '\n'){
+            last++;
+        }
+        
+        while(last > p && isSpace(last[-1])){
+            last--;
+        }
+        
+        return std::string(p, last);
+    }
+    
+    /**
+     * Returns true if the word at p is a number or on or off, an argument of a texture map option
+     */
+    static bool isOptionValue(const char* p, const char* end){
+        
+        const char* last = p;
+        while(last < end && !isSpace(*last)){
+            last++;
+        }
+        
+        std::string word(p, last);
+        
+        if(word == "on" || word == "off")
+            return true;
+        
+        if(!word.empty() && (word[0] == '-' || word[0] == '+'))
+            word.erase(0, 1);
+        
+        return !word.empty() && (isDigit(word[0]) || (word[0] == '.' && word.size() > 1 && isDigit(word[1])));
+    }
+    
+    /**
+     * Parses a decimal float. Up to 19 significant digits are gathered into an integer that is
+     * scaled once by a power of ten, exact for the short numbers exporters write
+     */
+    static const char* parseFloat(const char* p, const char* end, GLfloat& value){
+        
+        static const double POWERS[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        
+        p = skipSpaces(p, end);
+        
+        bool negative = false;
+        
+        if(p < end && (*p == '-' || *p == '+')){
+            negative = *p == '-';
+            p++;
+        }
+        
+        uint64_t digits = 0;
+        GLint significant = 0;
+        GLint exponent = 0;
+        
+        for(; p < end && isDigit(*p); p++){
+            
+            if(significant < 19){
+                digits = digits * 10 + (GLuint) (*p - '0');
+                significant += digits != 0;
+            } else {
+                exponent++;
+            }
+        }
+        
+        if(p < end && *p == '.'){
+            
+            for(p++; p < end && isDigit(*p); p++){
+                
+                if(significant < 19){
+                    digits = digits * 10 + (GLuint) (*p - '0');
+                    significant += digits != 0;
+                    exponent--;
+                }
+            }
+        }
+        
+        if(p < end && (*p == 'e' || *p == 'E')){
+            
+            p++;
+            
+            bool negativeExponent = false;
+            
+            if(p < end && (*p == '-' || *p == '+')){
+                negativeExponent = *p == '-';
+                p++;
+            }
+            
+            GLint e = 0;
+            for(; p < end && isDigit(*p); p++){
+                e = std::min(e * 10 + (*p - '0'), 1000);
+            }
+            
+            exponent += negativeExponent ? -e : e;
+        }
+        
+        double result = (double) digits;
+        
+        if(exponent < 0){
+            result = -exponent <= 22 ? result / POWERS[-exponent] : result * std::pow(10.0, exponent);
+        } else if(exponent > 0){
+            result = exponent <= 22 ? result * POWERS[exponent] : result * std::pow(10.0, exponent);
+        }
+        
+        value = (GLfloat) (negative ? -result : result);
+        
+        return p;
+    }
+    
+    /**
+     * Parses an index of a face and encodes it for the chunk, see ObjChunk
+     *
+     * @param count Number of attributes of the kind parsed so far in this chunk
+     */
+    static const char* parseIndex(const char* p, const char* end, size_t count, int64_t& index){
+        
+        bool negative = false;
+        
+        if(p < end && (*p == '-' || *p == '+')){
+            negative = *p == '-';
+            p++;
+        }
+        
+        int64_t value = 0;
+        bool found = false;
+        
+        for(; p < end && isDigit(*p); p++){
+            value = std::min(value * 10 + (*p - '0'), (int64_t) 0x7fffffff);
+            found = true;
+        }
+        
+        if(!found || value == 0){
+            index = MISSING;
+        } else if(!negative){
+            index = value - 1;
+        } else {
+            // relative to the chunk, resolved once the chunks before are counted
+            index = RELATIVE + (int64_t) count - value;
+        }
+        
+        return p;
+    }
+    
+    static void parseChunk(ObjChunk& chunk){
+        
+        const char* p = chunk.m_Begin;
+        const char* end = chunk.m_End;
+        
+        std::vector<int64_t> polygon;
+        
+        while(p < end){
+            
+            p = skipSpaces(p, end);
+            
+            if(p + 1 >= end){
+                break;
+            }
+            
+            if(p[0] == 'v' && isSpace(p[1])){
+                
+                glm::vec3 position;
+                p = parseFloat(p + 1, end, position.x);
+                p = parseFloat(p, end, position.y);
+                p = parseFloat(p, end, position.z);
+                chunk.m_Positions.push_back(position);
+                
+            } else if(p[0] == 'v' && p[1] == 't'){
+                
+                glm::vec2 texCoords;
+                p = parseFloat(p + 2, end, texCoords.x);
+                p = parseFloat(p, end, texCoords.y);
+                chunk.m_TexCoords.push_back(texCoords);
+                
+            } else if(p[0] == 'v' && p[1] == 'n'){
+                
+                glm::vec3 normal;
+                p = parseFloat(p + 2, end, normal.x);
+                p = parseFloat(p, end, normal.y);
+                p = parseFloat(p, end, normal.z);
+                chunk.m_Normals.push_back(normal);
+                
+            } else if(p[0] == 'f' && isSpace(p[1])){
+                
+                polygon.clear();
+                
+                for(p = skipSpaces(p + 1, end); p < end && *p != '\n' && *p != '#'; p = skipSpaces(p, end)){
+                    
+                    int64_t position, texCoords = MISSING, normal = MISSING;
+                    
+                    p = parseIndex(p, end, chunk.m_Positions.size(), position);
+                    
+                    if(p < end && *p == '/'){
+                        
+                        p = parseIndex(p + 1, end, chunk.m_TexCoords.size(), texCoords);
+                        
+                        if(p < end && *p == '/'){
+                            p = parseIndex(p + 1, end, chunk.m_Normals.size(), normal);
+                        }
+                    }
+                    
+                    // garbage, skip the character so the line is still consumed
+                    if(position == MISSING && p < end && !isSpace(*p) && *p != '\n'){
+                        p++;
+                        continue;
+                    }
+                    
+                    polygon.push_back(position);
+                    polygon.push_back(texCoords);
+                    polygon.push_back(normal);
+                }
+                
+                // triangle fan, like aiProcess_Triangulate does for convex polygons
+                for(size_t i = 2; i * 3 < polygon.size(); i++){
+                    chunk.m_Corners.insert(chunk.m_Corners.end(), polygon.begin(), polygon.begin() + 3);
+                    chunk.m_Corners.insert(chunk.m_Corners.end(), polygon.begin() + 3 * (i - 1), polygon.begin() + 3 * (i + 1));
+                }
+                
+            } else if(end - p > 6 && std::equal(p, p + 6, "usemtl") && isSpace(p[6])){
+                
+                chunk.m_SwitchCorners.push_back(chunk.m_Corners.size() / 3);
+                chunk.m_SwitchNames.push_back(restOfLine(p + 6, end));
+                
+            } else if(end - p > 6 && std::equal(p, p + 6, "mtllib") && isSpace(p[6])){
+                
+                chunk.m_Libraries.push_back(restOfLine(p + 6, end));
+            }
+            
+            p = skipLine(p, end);
+        }
+    }
+    
+    /**
+     * Runs function(i) for i in [0, count), each on its own thread, the calling thread included
+     */
+    template <class F> static void parallelFor(GLuint count, F function){
+        
+        std::vector<std::thread> threads;
+        
+        for(GLuint i = 1; i < count; i++){
+            threads.push_back(std::thread(function, i));
+        }
+        
+        if(count > 0)
+            function(0);
+        
+        for(std::thread& thread : threads){
+            thread.join();
+        }
+    }
+    
+    /**
+     * Turns an index of a chunk into an index of the file, MISSING if it is out of range
+     */
+    static inline int64_t resolveIndex(int64_t index, size_t base, size_t count){
+        
+        if(index == MISSING)
+            return MISSING;
+        
+        int64_t resolved = index >= 0 ? index : (int64_t) base + (index - RELATIVE);
+        
+        return resolved >= 0 && resolved < (int64_t) count ? resolved : MISSING;
+    }
+    
+    bool ObjLoader::load(const std::string& path){
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        
+        m_Directory = path.substr(0, path.find_last_of('/'));
+        m_Positions.clear();
+        m_TexCoords.clear();
+        m_Normals.clear();
+        m_Meshes.clear();
+        m_Materials.clear();
+        m_Libraries.clear();
+        m_FileSize = 0;
+        
+        // faces without a material and faces of unknown materials
+        m_Materials.push_back(Material());
+        m_Materials[0].m_TexturePaths.resize(Texture::TextureType_Max);
+        
+        int file = ::open(path.c_str(), O_RDONLY);
+        
+        if(file < 0)
+            return false;
+        
+        struct stat info;
+        
+        if(fstat(file, &info) != 0){
+            ::close(file);
+            return false;
+        }
+        
+        size_t size = (size_t) info.st_size;
+        void* data = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0) : nullptr;
+        
+        // the mapping stays valid after the descriptor is closed
+        ::close(file);
+        
+        if(data == MAP_FAILED)
+            return false;
+        
+        const char* text = (const char*) data;
+        const char* textEnd = text + size;
+        
+        m_FileSize = size;
+        
+        // chunks end at line ends so that no line is split
+        GLuint threads = std::min(std::max(std::thread::hardware_concurrency(), 1u), MAX_THREADS);
+        threads = (GLuint) std::max(std::min((size_t) threads, size / MIN_CHUNK_SIZE), (size_t) 1);
+        
+        std::vector<ObjChunk> chunks(threads);
+        const char* begin = text;
+        
+        for(GLuint i = 0; i < threads; i++){
+            
+            const char* end = i + 1 < threads ? std::max(text + size / threads * (i + 1), begin) : textEnd;
+            end = i + 1 < threads ? skipLine(end, textEnd) : end;
+            
+            chunks[i].m_Begin = begin;
+            chunks[i].m_End = end;
+            begin = end;
+        }
+        
+        parallelFor(threads, [&](GLuint i) {
+            parseChunk(chunks[i]);
+        });
+        
+        // attributes of the whole file, the index base of each chunk is the count before it
+        std::vector<size_t> positionBases(threads), texCoordBases(threads), normalBases(threads);
+        
+        for(GLuint i = 0; i < threads; i++){
+            
+            positionBases[i] = m_Positions.size();
+            texCoordBases[i] = m_TexCoords.size();
+            normalBases[i] = m_Normals.size();
+            
+            m_Positions.insert(m_Positions.end(), chunks[i].m_Positions.begin(), chunks[i].m_Positions.end());
+            m_TexCoords.insert(m_TexCoords.end(), chunks[i].m_TexCoords.begin(), chunks[i].m_TexCoords.end());
+            m_Normals.insert(m_Normals.end(), chunks[i].m_Normals.begin(), chunks[i].m_Normals.end());
+            
+            std::vector<glm::vec3>().swap(chunks[i].m_Positions);
+            std::vector<glm::vec2>().swap(chunks[i].m_TexCoords);
+            std::vector<glm::vec3>().swap(chunks[i].m_Normals);
+        }
+        
+        parallelFor(threads, [&](GLuint i) {
+            
+            std::vector<int64_t>& corners = chunks[i].m_Corners;
+            
+            for(size_t c = 0; c < corners.size(); c += 3){
+                corners[c] = resolveIndex(corners[c], positionBases[i], m_Positions.size());
+                corners[c + 1] = resolveIndex(corners[c + 1], texCoordBases[i], m_TexCoords.size());
+                corners[c + 2] = resolveIndex(corners[c + 2], normalBases[i], m_Normals.size());
+            }
+        });
+        
+        munmap(data, size);
+        
+        for(const ObjChunk& chunk : chunks){
+            for(const std::string& library : chunk.m_Libraries){
+                loadMaterials(m_Directory + '/' + library);
+            }
+        }
+        
+        // triangles gathered by material, the material of the latest usemtl carries over to the next chunk
+        std::vector<GLint> meshOfMaterial;
+        GLuint material = 0;
+        
+        for(ObjChunk& chunk : chunks){
+            
+            size_t triangles = chunk.m_Corners.size() / 9;
+            size_t triangle = 0;
+            
+            for(size_t s = 0; s <= chunk.m_SwitchCorners.size(); s++){
+                
+                size_t last = s < chunk.m_SwitchCorners.size() ? chunk.m_SwitchCorners[s] / 3 : triangles;
+                
+                if(triangle < last){
+                    
+                    meshOfMaterial.resize(m_Materials.size(), -1);
+                    
+                    if(meshOfMaterial[material] < 0){
+                        meshOfMaterial[material] = (GLint) m_Meshes.size();
+                        m_Meshes.push_back(ObjMesh());
+                        m_Meshes.back().m_Material = material;
+                    }
+                    
+                    ObjMesh& mesh = m_Meshes[meshOfMaterial[material]];
+                    
+                    for(; triangle < last; triangle++){
+                        
+                        const int64_t* c = &chunk.m_Corners[triangle * 9];
+                        
+                        // triangles referring to positions that do not exist are dropped
+                        if(c[0] == MISSING || c[3] == MISSING || c[6] == MISSING)
+                            continue;
+                        
+                        for(GLuint k = 0; k < 3; k++){
+                            
+                            Corner corner;
+                            corner.m_Position = (GLint) c[3 * k];
+                            corner.m_TexCoords = (GLint) c[3 * k + 1];
+                            corner.m_Normal = (GLint) c[3 * k + 2];
+                            
+                            mesh.m_HasNormals = mesh.m_HasNormals && corner.m_Normal != MISSING;
+                            mesh.m_Corners.push_back(corner);
+                        }
+                    }
+                }
+                
+                if(s < chunk.m_SwitchCorners.size())
+                    material = findMaterial(chunk.m_SwitchNames[s]);
+            }
+            
+            std::vector<int64_t>().swap(chunk.m_Corners);
+        }
+        
+        m_Meshes.erase(std::remove_if(m_Meshes.begin(), m_Meshes.end(), [](const ObjMesh& mesh) {
+            return mesh.m_Corners.empty();
+        }), m_Meshes.end());
+        
+        GLdouble ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        
+        std::cout << path << " parsed by ObjLoader on " << threads << " threads in " << ms << " ms, " << (GLdouble) size / (1024.0 * 1024.0) / (ms / 1000.0) << " MB/s" << std::endl;
+        
+        return true;
+    }
+    
+    void ObjLoader::indexCorners(GLuint mesh, std::vector<Corner>& corners, std::vector<GLuint>& indices) const {
+        
+        const std::vector<Corner>& source = m_Meshes[mesh].m_Corners;
+        
+        corners.clear();
+        indices.resize(source.size());
+        
+        // open addressing table of distinct corners, at most half full
+        size_t tableSize = 16;
+        while(tableSize < source.size() * 2){
+            tableSize *= 2;
+        }
+        
+        const GLuint EMPTY = ~0u;
+        std::vector<GLuint> table(tableSize, EMPTY);
+        
+        for(size_t i = 0; i < source.size(); i++){
+            
+            const Corner& corner = source[i];
+            
+            size_t slot = ((GLuint) corner.m_Position * 73856093u ^ (GLuint) corner.m_TexCoords * 19349663u ^ (GLuint) corner.m_Normal * 83492791u) & (tableSize - 1);
+            
+            while(table[slot] != EMPTY){
+                
+                const Corner& other = corners[table[slot]];
+                
+                if(other.m_Position == corner.m_Position && other.m_TexCoords == corner.m_TexCoords && other.m_Normal == corner.m_Normal)
+                    break;
+                
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            
+            if(table[slot] == EMPTY){
+                table[slot] = (GLuint) corners.size();
+                corners.push_back(corner);
+            }
+            
+            indices[i] = table[slot];
+        }
+    }
+    
+    void ObjLoader::loadMaterials(const std::string& path){
+        
+        // a missing library is listed too, the cache notices when it appears
+        m_Libraries.push_back(path);
+        
+        std::ifstream file(path);
+        
+        if(!file){
+            std::cout << "Could not read material library " << path << std::endl;
+            return;
+        }
+        
+        Material* material = nullptr;
+        std::vector<std::string> names;
+        std::string line;
+        
+        while(std::getline(file, line)){
+            
+            const char* p = skipSpaces(line.data(), line.data() + line.size());
+            const char* end = line.data() + line.size();
+            
+            const char* key = p;
+            while(p < end && !isSpace(*p)){
+                p++;
+            }
+            
+            std::string keyword(key, p);
+            
+            if(keyword == "newmtl"){
+                
+                std::string name = restOfLine(p, end);
+                
+                if(std::find(names.begin(), names.end(), name) != names.end() || findMaterial(name) != 0 || name.empty()){
+                    material = nullptr;
+                    continue;
+                }
+                
+                names.push_back(name);
+                m_Materials.push_back(Material());
+                material = &m_Materials.back();
+                material->m_Name = name;
+                material->m_TexturePaths.resize(Texture::TextureType_Max);
+                continue;
+            }
+            
+            GLint type = -1;
+            
+            // bump maps are normal maps here, as aiTextureType_HEIGHT is for the Assimp importer
+            if(keyword == "map_Kd"){
+                type = Texture::Diffuse;
+            } else if(keyword == "map_Ks"){
+                type = Texture::Specular;
+            } else if(keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump"){
+                type = Texture::Normal;
+            }
+            
+            if(material == nullptr || type < 0)
+                continue;
+            
+            // options like -bm 0.5 come before the file name
+            p = skipSpaces(p, end);
+            
+            while(p < end && *p == '-'){
+                
+                do {
+                    while(p < end && !isSpace(*p)){
+                        p++;
+                    }
+                    p = skipSpaces(p, end);
+                } while(isOptionValue(p, end));
+            }
+            
+            std::string fileName = restOfLine(p, end);
+            std::replace(fileName.begin(), fileName.end(), '\\', '/');
+            
+            if(!fileName.empty() && material->m_TexturePaths[type].empty())
+                material->m_TexturePaths[type] = m_Directory + '/' + fileName;
+        }
+    }
+    
+    GLuint ObjLoader::findMaterial(const std::string& name){
+        
+        for(GLuint i = 1; i < m_Materials.size(); i++){
+            if(m_Materials[i].m_Name == name)
+                return i;
+        }
+        
+        return 0;
+    }
+}
@@ -0,0 +1,172 @@
+//
+//  ObjLoader.h
+//  SDL-GLEW-App
+//
+
+#ifndef ObjLoader_h
+#define ObjLoader_h
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Texture.h"
+
+namespace Fox {
+    
+    /**
+     * Reader of Wavefront OBJ models and their MTL materials. The file is memory mapped and cut
+     * into chunks at line ends that are parsed on worker threads. Polygons are triangulated as
+     * fans and faces are gathered into one mesh per material
+     */
+    class ObjLoader {
+    
+    public:
+        
+        static const GLuint MAX_THREADS = 8; ///< upper limit of parsing threads
+        static const size_t MIN_CHUNK_SIZE = 1 << 20; ///< smaller files are not worth a thread per chunk
+        
+        /**
+         * Corner of a triangle, indices into the attributes of the file, -1 if missing
+         */
+        class Corner {
+        public:
+            GLint m_Position;
+            GLint m_TexCoords;
+            GLint m_Normal;
+        };
+        
+        ObjLoader() : m_FileSize(0) {}
+        
+        /**
+         * Reads a model and the material libraries it uses
+         *
+         * @param path Path of the OBJ file
+         * @return false if the file could not be read
+         */
+        bool load(const std::string& path);
+        
+        inline GLuint getMeshCount() const {
+            return (GLuint) m_Meshes.size();
+        }
+        
+        /**
+         * Returns true if every corner of a mesh has a normal
+         *
+         * @param mesh Mesh index
+         */
+        inline bool hasNormals(GLuint mesh) const {
+            return m_Meshes[mesh].m_HasNormals;
+        }
+        
+        /**
+         * Returns path of the texture of each Texture::TextureType of a mesh, empty if there is none
+         *
+         * @param mesh Mesh index
+         */
+        inline const std::vector<std::string>& getTexturePaths(GLuint mesh) const {
+            return m_Materials[m_Meshes[mesh].m_Material].m_TexturePaths;
+        }
+        
+        /**
+         * Returns paths of the material libraries the latest file uses
+         */
+        inline const std::vector<std::string>& getLibraries() const {
+            return m_Libraries;
+        }
+        
+        /**
+         * Returns size of the latest file read, in bytes
+         */
+        inline size_t getFileSize() const {
+            return m_FileSize;
+        }
+        
+        /**
+         * Collects the distinct corners of a mesh and the triangle list indexing them
+         *
+         * @param mesh Mesh index
+         * @param corners Receives the distinct corners in order of first use
+         * @param indices Receives the triangle list
+         */
+        void indexCorners(GLuint mesh, std::vector<Corner>& corners, std::vector<GLuint>& indices) const;
+        
+        /**
+         * Builds the vertices and indices of a mesh, identical corners share one vertex.
+         * Texture coordinates are flipped vertically like with aiProcess_FlipUVs
+         *
+         * @param mesh Mesh index
+         * @param vertices Receives vertices with m_Position, m_Normal and m_TexCoords set
+         * @param indices Receives the triangle list
+         */
+        template <class V> void getMesh(GLuint mesh, std::vector<V>& vertices, std::vector<GLuint>& indices) const {
+            
+            std::vector<Corner> corners;
+            indexCorners(mesh, corners, indices);
+            
+            vertices.resize(corners.size());
+            
+            for(GLuint i = 0; i < corners.size(); i++){
+                
+                const Corner& corner = corners[i];
+                V& vertex = vertices[i];
+                
+                vertex.m_Position = m_Positions[corner.m_Position];
+                vertex.m_Normal = corner.m_Normal >= 0 ? m_Normals[corner.m_Normal] : glm::vec3(0.0f);
+                vertex.m_TexCoords = corner.m_TexCoords >= 0 ? glm::vec2(m_TexCoords[corner.m_TexCoords].x, 1.0f - m_TexCoords[corner.m_TexCoords].y) : glm::vec2(0.0f);
+            }
+        }
+    
+    private:
+        
+        /**
+         * Material of an MTL library
+         */
+        class Material {
+        public:
+            std::string m_Name;
+            std::vector<std::string> m_TexturePaths; ///< texture path of each Texture::TextureType
+        };
+        
+        /**
+         * Triangles of one material
+         */
+        class ObjMesh {
+        public:
+            ObjMesh() : m_Material(0), m_HasNormals(true) {}
+            
+            std::vector<Corner> m_Corners; ///< three corners per triangle
+            GLuint m_Material; ///< index into m_Materials
+            bool m_HasNormals; ///< every corner has a normal
+        };
+        
+        /**
+         * Reads an MTL library, materials already known keep their first definition
+         *
+         * @param path Path of the library
+         */
+        void loadMaterials(const std::string& path);
+        
+        /**
+         * Returns index of a material by name, unknown names get a material without textures
+         *
+         * @param name Material name
+         */
+        GLuint findMaterial(const std::string& name);
+        
+        std::string m_Directory; ///< directory of the OBJ file, paths in the file are relative to it
+        size_t m_FileSize; ///< size of the latest file read
+        std::vector<glm::vec3> m_Positions;
+        std::vector<glm::vec2> m_TexCoords;
+        std::vector<glm::vec3> m_Normals;
+        std::vector<Material> m_Materials; ///< the first one is used by faces without a material
+        std::vector<ObjMesh> m_Meshes; ///< meshes in order of first use of their material
+        std::vector<std::string> m_Libraries; ///< material libraries of the latest file read
+    };
+}
+
+#endif /* ObjLoader_h */
@@ -0,0 +1,56 @@
+//
+//  ObjectMap.cpp
+//  SDL-GLEW-App
+//
+
+#include <iostream>
+
+#include "ObjectMap.h"
+#include "Texture.h"
+
+namespace Fox {
+    
+    bool ObjectMap::load(const GLchar* filePath) {
+        
+        // decoded to ARGB8888 whatever the file format, so pixels can be read as 32 bit values
+        GLboolean hasAlpha;
+        SDL_Surface* image = Texture::decode(filePath, hasAlpha);
+        
+        if(!image)
+            return false;
+        
+        m_Width = (GLuint) image->w;
+        m_Depth = (GLuint) image->h;
+        
+        m_Occupancy.assign(((size_t) m_Width * m_Depth + 63) / 64, 0);
+        m_Objects.clear();
+        
+        for(GLuint z = 0; z < m_Depth; z++){
+            
+            const Uint32* row = (const Uint32*) ((const Uint8*) image->pixels + z * image->pitch);
+            
+            for(GLuint x = 0; x < m_Width; x++){
+                
+                // full green marks an object
+                if(((row[x] >> 8) & 0xff) == 0xff){
+                    
+                    size_t bit = (size_t) z * m_Width + x;
+                    m_Occupancy[bit / 64] |= (uint64_t) 1 << (bit % 64);
+                    
+                    m_Objects.push_back(ObjectCell(x, z));
+                }
+            }
+        }
+        
+        Texture::freeTexture(image);
+        
+        m_Objects.shrink_to_fit();
+        
+        // the map used to be a fixed 1000 x 1000 int array next to a float height array
+        size_t fixedLayout = 1000 * 1000 * (sizeof(GLint) + sizeof(GLfloat));
+        
+        std::cout << filePath << " " << m_Width << " x " << m_Depth << " object map, " << m_Objects.size() << " objects in " << getMemoryFootprint() / 1024 << " KB, fixed arrays took " << fixedLayout / 1024 << " KB" << std::endl;
+        
+        return true;
+    }
+}
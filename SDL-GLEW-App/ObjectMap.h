@@ -0,0 +1,95 @@
+//
+//  ObjectMap.h
+//  SDL-GLEW-App
+//
+
+#ifndef ObjectMap_h
+#define ObjectMap_h
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Fox {
+    
+    /**
+     * Cell of an object map holding an object
+     */
+    class ObjectCell {
+    public:
+        
+        ObjectCell() : m_X(0), m_Z(0) {}
+        
+        ObjectCell(GLuint x, GLuint z) : m_X(x), m_Z(z) {}
+        
+        GLuint m_X; ///< column in the map
+        GLuint m_Z; ///< row in the map
+    };
+    
+    /**
+     * Placement of objects read from an image, a pixel with full green holds an object.
+     * Occupancy is kept as one bit per cell and the occupied cells as a list, so the size
+     * follows the image and placing objects does not scan the whole map
+     */
+    class ObjectMap {
+    
+    public:
+        
+        ObjectMap() : m_Width(0), m_Depth(0) {}
+        
+        /**
+         * Reads an object map image
+         *
+         * @param filePath File path of the image
+         * @return false if the image could not be read
+         */
+        bool load(const GLchar* filePath);
+        
+        /**
+         * Returns true if a cell holds an object, false outside the map
+         *
+         * @param x Column
+         * @param z Row
+         */
+        inline bool isOccupied(GLint x, GLint z) const {
+            
+            if(x < 0 || z < 0 || x >= (GLint) m_Width || z >= (GLint) m_Depth)
+                return false;
+            
+            size_t bit = (size_t) z * m_Width + x;
+            return (m_Occupancy[bit / 64] >> (bit % 64)) & 1;
+        }
+        
+        /**
+         * Returns the occupied cells, row after row
+         */
+        inline const std::vector<ObjectCell>& getObjects() const {
+            return m_Objects;
+        }
+        
+        inline GLuint getWidth() const {
+            return m_Width;
+        }
+        
+        inline GLuint getDepth() const {
+            return m_Depth;
+        }
+        
+        /**
+         * Returns the bytes held by the occupancy bits and the object list
+         */
+        size_t getMemoryFootprint() const {
+            return m_Occupancy.capacity() * sizeof(uint64_t) + m_Objects.capacity() * sizeof(ObjectCell);
+        }
+    
+    private:
+        
+        GLuint m_Width; ///< cells per row
+        GLuint m_Depth; ///< number of rows
+        std::vector<uint64_t> m_Occupancy; ///< one bit per cell, row after row
+        std::vector<ObjectCell> m_Objects; ///< occupied cells
+    };
+}
+
+#endif /* ObjectMap_h */
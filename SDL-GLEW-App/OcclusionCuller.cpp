@@ -0,0 +1,414 @@
+//
+//  OcclusionCuller.cpp
+//  SDL-GLEW-App
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "OcclusionCuller.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace Fox {
+    
+    static const GLfloat FAR_DEPTH = 1.0f; ///< depth of pixels without an occluder
+    
+    void OcclusionCuller::setOccluders(const HeightField& field){
+        
+        m_Vertices.clear();
+        m_Indices.clear();
+        m_Rendered = false;
+        
+        if(field.empty())
+            return;
+        
+        GLint width = field.getWidth();
+        GLint depth = field.getDepth();
+        GLint step = (GLint) OCCLUDER_STEP;
+        
+        GLuint columns = (GLuint) ((width - 1 + step - 1) / step) + 1;
+        GLuint rows = (GLuint) ((depth - 1 + step - 1) / step) + 1;
+        
+        m_Vertices.reserve(columns * rows);
+        
+        for(GLuint j = 0; j < rows; j++){
+            for(GLuint i = 0; i < columns; i++){
+                
+                GLint x = std::min((GLint) i * step, width - 1);
+                GLint z = std::min((GLint) j * step, depth - 1);
+                
+                // lowest sample of both cells on each side, the cells between vertices stay under the field
+                GLfloat height = std::numeric_limits<GLfloat>::max();
+                for(GLint sz = z - step; sz <= z + step; sz++){
+                    for(GLint sx = x - step; sx <= x + step; sx++){
+                        height = std::min(height, field.heightAt(sx, sz));
+                    }
+                }
+                
+                m_Vertices.push_back(glm::vec3((GLfloat) (x - width / 2), height, (GLfloat) (z - depth / 2)));
+            }
+        }
+        
+        m_Indices.reserve((columns - 1) * (rows - 1) * 6);
+        
+        for(GLuint j = 0; j + 1 < rows; j++){
+            for(GLuint i = 0; i + 1 < columns; i++){
+                
+                GLuint corner = j * columns + i;
+                
+                m_Indices.push_back(corner);
+                m_Indices.push_back(corner + columns);
+                m_Indices.push_back(corner + 1);
+                
+                m_Indices.push_back(corner + 1);
+                m_Indices.push_back(corner + columns);
+                m_Indices.push_back(corner + columns + 1);
+            }
+        }
+        
+        m_ClipVertices.resize(m_Vertices.size());
+    }
+    
+    GLuint OcclusionCuller::defaultWorkers(){
+        
+        GLuint threads = std::thread::hardware_concurrency();
+        GLuint workers = threads > 1 ? threads - 1 : 0;
+        
+        return workers < MAX_WORKERS ? workers : MAX_WORKERS;
+    }
+    
+    void OcclusionCuller::render(const glm::mat4& clip){
+        
+        m_Clip = clip;
+        m_Depth.resize(WIDTH * HEIGHT);
+        m_TileDepth.resize(TILES_X * TILES_Y);
+        
+        for(GLuint i = 0; i < m_Vertices.size(); i++){
+            m_ClipVertices[i] = clip * glm::vec4(m_Vertices[i], 1.0f);
+        }
+        
+        // start the rasterizing threads on first use, the caller renders a band as well
+        if(m_Workers.empty()){
+            for(GLuint i = 0; i < m_WorkerCount; i++){
+                m_Workers.push_back(std::thread(&OcclusionCuller::workerLoop, this, i + 1));
+            }
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Frame++;
+            m_Remaining = (GLuint) m_Workers.size();
+        }
+        
+        m_StartCondition.notify_all();
+        
+        renderBand(0);
+        
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_DoneCondition.wait(lock, [this]{ return m_Remaining == 0; });
+        
+        m_Rendered = true;
+    }
+    
+    void OcclusionCuller::workerLoop(GLuint band){
+        
+        GLuint frame = 0;
+        
+        while(true){
+            
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_StartCondition.wait(lock, [this, frame]{ return m_Stop || m_Frame != frame; });
+                
+                if(m_Stop)
+                    return;
+                
+                frame = m_Frame;
+            }
+            
+            renderBand(band);
+            
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Remaining--;
+            }
+            
+            m_DoneCondition.notify_one();
+        }
+    }
+    
+    void OcclusionCuller::stopWorkers(){
+        
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        
+        m_StartCondition.notify_all();
+        
+        for(std::thread& worker : m_Workers){
+            worker.join();
+        }
+        
+        m_Workers.clear();
+    }
+    
+    void OcclusionCuller::renderBand(GLuint band){
+        
+        // bands are whole rows of tiles, so each band also builds its own tiles
+        GLuint tileBegin = band * TILES_Y / m_Bands;
+        GLuint tileEnd = (band + 1) * TILES_Y / m_Bands;
+        
+        GLint rowBegin = (GLint) (tileBegin * TILE_SIZE);
+        GLint rowEnd = (GLint) (tileEnd * TILE_SIZE);
+        
+        std::fill(m_Depth.begin() + rowBegin * WIDTH, m_Depth.begin() + rowEnd * WIDTH, FAR_DEPTH);
+        
+        for(GLuint i = 0; i < m_Indices.size(); i += 3){
+            rasterizeClipped(m_ClipVertices[m_Indices[i]], m_ClipVertices[m_Indices[i + 1]], m_ClipVertices[m_Indices[i + 2]], rowBegin, rowEnd);
+        }
+        
+        for(GLuint ty = tileBegin; ty < tileEnd; ty++){
+            for(GLuint tx = 0; tx < TILES_X; tx++){
+                
+                GLfloat farthest = 0.0f;
+                
+                for(GLuint y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; y++){
+                    const GLfloat* row = &m_Depth[y * WIDTH + tx * TILE_SIZE];
+                    for(GLuint x = 0; x < TILE_SIZE; x++){
+                        farthest = std::max(farthest, row[x]);
+                    }
+                }
+                
+                m_TileDepth[ty * TILES_X + tx] = farthest;
+            }
+        }
+    }
+    
+    /**
+     * Maps a clip space position to pixel coordinates and NDC depth
+     */
+    static inline glm::vec3 toPixels(const glm::vec4& v){
+        
+        GLfloat invW = 1.0f / v.w;
+        return glm::vec3((v.x * invW * 0.5f + 0.5f) * OcclusionCuller::WIDTH, (v.y * invW * 0.5f + 0.5f) * OcclusionCuller::HEIGHT, v.z * invW);
+    }
+    
+    void OcclusionCuller::rasterizeClipped(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, GLint rowBegin, GLint rowEnd){
+        
+        // triangles outside one side of the frustum are dropped before any clipping
+        if((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+           (a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+           (a.z < -a.w && b.z < -b.w && c.z < -c.w))
+            return;
+        
+        if(a.z >= -a.w && b.z >= -b.w && c.z >= -c.w){
+            rasterize(toPixels(a), toPixels(b), toPixels(c), rowBegin, rowEnd);
+            return;
+        }
+        
+        // cut the part in front of the near plane, at most a quad is left
+        const glm::vec4* input[3] = {&a, &b, &c};
+        glm::vec4 polygon[4];
+        GLuint count = 0;
+        
+        for(GLuint i = 0; i < 3; i++){
+            
+            const glm::vec4& p = *input[i];
+            const glm::vec4& q = *input[(i + 1) % 3];
+            
+            GLfloat dp = p.z + p.w;
+            GLfloat dq = q.z + q.w;
+            
+            if(dp >= 0.0f)
+                polygon[count++] = p;
+            
+            if((dp >= 0.0f) != (dq >= 0.0f))
+                polygon[count++] = p + (q - p) * (dp / (dp - dq));
+        }
+        
+        glm::vec3 first = toPixels(polygon[0]);
+        for(GLuint i = 1; i + 1 < count; i++){
+            rasterize(first, toPixels(polygon[i]), toPixels(polygon[i + 1]), rowBegin, rowEnd);
+        }
+    }
+    
+    void OcclusionCuller::rasterize(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, GLint rowBegin, GLint rowEnd){
+        
+        GLfloat area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        
+        if(std::fabs(area) < 1e-8f)
+            return;
+        
+        // both windings occlude, back facing slopes hide what is behind them too
+        const glm::vec3& p1 = area > 0.0f ? b : c;
+        const glm::vec3& p2 = area > 0.0f ? c : b;
+        area = std::fabs(area);
+        
+        GLint minY = std::max(rowBegin, (GLint) std::floor(std::min(a.y, std::min(p1.y, p2.y))));
+        GLint maxY = std::min(rowEnd - 1, (GLint) std::ceil(std::max(a.y, std::max(p1.y, p2.y))));
+        GLint minX = std::max(0, (GLint) std::floor(std::min(a.x, std::min(p1.x, p2.x))));
+        GLint maxX = std::min((GLint) WIDTH - 1, (GLint) std::ceil(std::max(a.x, std::max(p1.x, p2.x))));
+        
+        if(minX > maxX || minY > maxY)
+            return;
+        
+        // four pixels at a time from a multiple of four, lanes outside the triangle fail the edge tests
+        minX &= ~3;
+        
+        // edge functions, positive inside
+        GLfloat edgeA[3], edgeB[3], edgeC[3];
+        const glm::vec3* from[3] = {&a, &p1, &p2};
+        const glm::vec3* to[3] = {&p1, &p2, &a};
+        
+        for(GLuint i = 0; i < 3; i++){
+            edgeA[i] = -(to[i]->y - from[i]->y);
+            edgeB[i] = to[i]->x - from[i]->x;
+            edgeC[i] = -(edgeA[i] * from[i]->x + edgeB[i] * from[i]->y);
+        }
+        
+        // depth plane
+        GLfloat dzdx = ((p1.z - a.z) * (p2.y - a.y) - (p2.z - a.z) * (p1.y - a.y)) / area;
+        GLfloat dzdy = ((p2.z - a.z) * (p1.x - a.x) - (p1.z - a.z) * (p2.x - a.x)) / area;
+        GLfloat z0 = a.z - dzdx * a.x - dzdy * a.y;
+
+#if defined(__SSE__)
+        
+        const __m128 lanes = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        const __m128 zero = _mm_setzero_ps();
+        
+        __m128 stepEdge[3], stepDepth = _mm_set1_ps(4.0f * dzdx);
+        for(GLuint i = 0; i < 3; i++){
+            stepEdge[i] = _mm_set1_ps(4.0f * edgeA[i]);
+        }
+        
+        for(GLint y = minY; y <= maxY; y++){
+            
+            GLfloat py = (GLfloat) y + 0.5f;
+            __m128 px = _mm_add_ps(_mm_set1_ps((GLfloat) minX), lanes);
+            
+            __m128 edge[3];
+            for(GLuint i = 0; i < 3; i++){
+                edge[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[i]), px), _mm_set1_ps(edgeB[i] * py + edgeC[i]));
+            }
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(dzdy * py + z0));
+            
+            GLfloat* row = &m_Depth[y * WIDTH];
+            
+            for(GLint x = minX; x <= maxX; x += 4){
+                
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge[0], zero), _mm_cmpge_ps(edge[1], zero)), _mm_cmpge_ps(edge[2], zero));
+                
+                if(_mm_movemask_ps(inside) != 0){
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(current, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+                }
+                
+                for(GLuint i = 0; i < 3; i++){
+                    edge[i] = _mm_add_ps(edge[i], stepEdge[i]);
+                }
+                z = _mm_add_ps(z, stepDepth);
+            }
+        }
+
+#else
+        
+        for(GLint y = minY; y <= maxY; y++){
+            
+            GLfloat py = (GLfloat) y + 0.5f;
+            GLfloat* row = &m_Depth[y * WIDTH];
+            
+            for(GLint x = minX; x <= maxX; x++){
+                
+                GLfloat px = (GLfloat) x + 0.5f;
+                
+                if(edgeA[0] * px + edgeB[0] * py + edgeC[0] >= 0.0f &&
+                   edgeA[1] * px + edgeB[1] * py + edgeC[1] >= 0.0f &&
+                   edgeA[2] * px + edgeB[2] * py + edgeC[2] >= 0.0f)
+                    row[x] = std::min(row[x], dzdx * px + dzdy * py + z0);
+            }
+        }
+
+#endif
+    }
+    
+    bool OcclusionCuller::isVisible(const glm::vec3& min, const glm::vec3& max) const {
+        
+        if(!m_Rendered)
+            return true;
+        
+        GLfloat minX = std::numeric_limits<GLfloat>::max(), minY = minX, nearest = minX;
+        GLfloat maxX = -minX, maxY = -minX;
+        
+        for(GLuint i = 0; i < 8; i++){
+            
+            glm::vec4 corner = m_Clip * glm::vec4(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.0f);
+            
+            // boxes reaching the near plane surround the camera
+            if(corner.z < -corner.w || corner.w <= 0.0f)
+                return true;
+            
+            glm::vec3 pixel = toPixels(corner);
+            minX = std::min(minX, pixel.x);
+            maxX = std::max(maxX, pixel.x);
+            minY = std::min(minY, pixel.y);
+            maxY = std::max(maxY, pixel.y);
+            nearest = std::min(nearest, pixel.z);
+        }
+        
+        // pixels touched by the rectangle and one more on each side against rasterization error
+        GLint x0 = std::max(0, (GLint) std::floor(minX) - 1);
+        GLint x1 = std::min((GLint) WIDTH - 1, (GLint) std::ceil(maxX));
+        GLint y0 = std::max(0, (GLint) std::floor(minY) - 1);
+        GLint y1 = std::min((GLint) HEIGHT - 1, (GLint) std::ceil(maxY));
+        
+        // outside the view, that is up to the frustum test
+        if(x0 > x1 || y0 > y1 || nearest > FAR_DEPTH)
+            return true;
+        
+        for(GLint ty = y0 / (GLint) TILE_SIZE; ty <= y1 / (GLint) TILE_SIZE; ty++){
+            for(GLint tx = x0 / (GLint) TILE_SIZE; tx <= x1 / (GLint) TILE_SIZE; tx++){
+                
+                // every pixel of the tile has an occluder in front of the box
+                if(nearest > m_TileDepth[ty * TILES_X + tx])
+                    continue;
+                
+                GLint ya = std::max(y0, ty * (GLint) TILE_SIZE), yb = std::min(y1, (ty + 1) * (GLint) TILE_SIZE - 1);
+                GLint xa = std::max(x0, tx * (GLint) TILE_SIZE), xb = std::min(x1, (tx + 1) * (GLint) TILE_SIZE - 1);
+                
+                for(GLint y = ya; y <= yb; y++){
+                    for(GLint x = xa; x <= xb; x++){
+                        if(nearest <= m_Depth[y * WIDTH + x])
+                            return true;
+                    }
+                }
+            }
+        }
+        
+        return false;
+    }
+    
+    void OcclusionCuller::cull(const std::vector<glm::vec3>& positions, const BoundingSphere& bounds, std::vector<GLuint>& visible){
+        
+        glm::vec3 extent(bounds.m_Radius);
+        GLuint kept = 0;
+        
+        for(GLuint i : visible){
+            
+            glm::vec3 center = positions[i] + bounds.m_Center;
+            
+            if(isVisible(center - extent, center + extent))
+                visible[kept++] = i;
+        }
+        
+        m_Statistics.m_Visible += kept;
+        m_Statistics.m_Occluded += (GLuint) visible.size() - kept;
+        
+        visible.resize(kept);
+    }
+}
@@ -0,0 +1,226 @@
+//
+//  OcclusionCuller.h
+//  SDL-GLEW-App
+//
+
+#ifndef OcclusionCuller_h
+#define OcclusionCuller_h
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "glm/glm.hpp"
+
+#include "HeightField.h"
+#include "BoundingVolume.h"
+
+namespace Fox {
+    
+    /**
+     * Occlusion culling on the CPU against the terrain. A coarse version of the height field is
+     * rasterized into a small depth buffer, bands of rows on worker threads and four pixels at a
+     * time, and the farthest depth of each tile gives a hierarchical level. Instances are tested
+     * with the screen rectangle and nearest depth of their bounding box.
+     *
+     * The coarse terrain never rises above the height field, so with the camera above the ground
+     * whatever it hides is hidden by the real terrain as well
+     */
+    class OcclusionCuller {
+    
+    public:
+        
+        static const GLuint WIDTH = 256; ///< columns of the depth buffer
+        static const GLuint HEIGHT = 128; ///< rows of the depth buffer
+        static const GLuint TILE_SIZE = 8; ///< pixels on a side of a tile of the hierarchical level
+        static const GLuint TILES_X = WIDTH / TILE_SIZE;
+        static const GLuint TILES_Y = HEIGHT / TILE_SIZE;
+        static const GLuint OCCLUDER_STEP = 8; ///< height samples on a side of a coarse terrain cell
+        static const GLuint MAX_WORKERS = 3; ///< upper limit of rasterizing threads besides the caller
+        
+        static_assert(WIDTH % TILE_SIZE == 0 && HEIGHT % TILE_SIZE == 0, "tiles must cover the depth buffer");
+        static_assert(WIDTH % 4 == 0, "rows are rasterized four pixels at a time");
+        
+        /**
+         * Counters of the culled instances, reset with resetStatistics
+         */
+        class Statistics {
+        public:
+            
+            Statistics() {
+                reset();
+            }
+            
+            void reset() {
+                m_Visible = 0;
+                m_Occluded = 0;
+            }
+            
+            GLuint m_Visible; ///< instances that passed the test
+            GLuint m_Occluded; ///< instances hidden behind the terrain
+        };
+        
+        /**
+         * @param workers Rasterizing threads besides the caller, at most TILES_Y - 1
+         */
+        OcclusionCuller(GLuint workers = defaultWorkers()) : m_WorkerCount(std::min(workers, TILES_Y - 1)), m_Stop(false), m_Frame(0), m_Remaining(0), m_Rendered(false) {
+            m_Bands = m_WorkerCount + 1;
+        }
+        
+        ~OcclusionCuller(){
+            stopWorkers();
+        }
+        
+        /**
+         * Builds the coarse terrain. Each coarse vertex takes the lowest height of the samples
+         * around it, so the coarse surface stays under the height field
+         *
+         * @param field Height field of the terrain
+         */
+        void setOccluders(const HeightField& field);
+        
+        /**
+         * Rasterizes the coarse terrain for a view and builds the hierarchical level
+         *
+         * @param clip Projection times view matrix
+         */
+        void render(const glm::mat4& clip);
+        
+        /**
+         * Tests a world space box against the depth of the latest render
+         *
+         * @param min Minimum corner of the box
+         * @param max Maximum corner of the box
+         * @return false if the terrain hides the whole box
+         */
+        bool isVisible(const glm::vec3& min, const glm::vec3& max) const;
+        
+        /**
+         * Removes the instances hidden by the terrain from a list of visible instances, e.g. the
+         * result of a frustum cull. Nothing is removed before the first render
+         *
+         * @param positions Positions of all instances
+         * @param bounds Object space bounding sphere of the instanced mesh
+         * @param visible Indices of the instances to test, the hidden ones are removed in place
+         */
+        void cull(const std::vector<glm::vec3>& positions, const BoundingSphere& bounds, std::vector<GLuint>& visible);
+        
+        /**
+         * Returns the depth of a pixel of the latest render, NDC depth with 1 for no occluder
+         */
+        inline GLfloat getDepth(GLuint x, GLuint y) const {
+            return m_Depth[y * WIDTH + x];
+        }
+        
+        /**
+         * Returns one worker per hardware thread besides the caller, up to MAX_WORKERS
+         */
+        static GLuint defaultWorkers();
+        
+        /**
+         * Returns the world space vertices of the coarse terrain
+         */
+        inline const std::vector<glm::vec3>& getOccluderVertices() const {
+            return m_Vertices;
+        }
+        
+        /**
+         * Returns the triangle list of the coarse terrain
+         */
+        inline const std::vector<GLuint>& getOccluderIndices() const {
+            return m_Indices;
+        }
+        
+        /**
+         * Returns the depth buffer of the latest render, WIDTH times HEIGHT pixels row by row
+         * from the bottom
+         */
+        inline const GLfloat* getDepthBuffer() const {
+            return m_Depth.data();
+        }
+        
+        /**
+         * Returns the farthest depth of each tile, TILES_X times TILES_Y tiles in the order of
+         * the depth buffer
+         */
+        inline const GLfloat* getTileDepth() const {
+            return m_TileDepth.data();
+        }
+        
+        /**
+         * Returns the clip matrix of the latest render
+         */
+        inline const glm::mat4& getClip() const {
+            return m_Clip;
+        }
+        
+        /**
+         * Returns true once a view has been rendered
+         */
+        inline bool isRendered() const {
+            return m_Rendered;
+        }
+        
+        inline const Statistics& getStatistics() const {
+            return m_Statistics;
+        }
+        
+        inline void resetStatistics() {
+            m_Statistics.reset();
+        }
+    
+    private:
+        
+        /**
+         * Rasterizes all occluders into the rows of a band and builds its tiles
+         *
+         * @param band Band index, bands are whole rows of tiles
+         */
+        void renderBand(GLuint band);
+        
+        /**
+         * Rasterizes a triangle given in clip space into the rows of a band, clipped to the near plane
+         */
+        void rasterizeClipped(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, GLint rowBegin, GLint rowEnd);
+        
+        /**
+         * Rasterizes a triangle given in pixel coordinates with NDC depth into the rows of a band
+         */
+        void rasterize(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, GLint rowBegin, GLint rowEnd);
+        
+        /**
+         * Waits for frames and renders the band of a worker
+         *
+         * @param band Band index of the worker
+         */
+        void workerLoop(GLuint band);
+        
+        void stopWorkers();
+        
+        std::vector<glm::vec3> m_Vertices; ///< world space vertices of the coarse terrain
+        std::vector<GLuint> m_Indices; ///< triangle list of the coarse terrain
+        std::vector<glm::vec4> m_ClipVertices; ///< vertices of the current frame in clip space
+        std::vector<GLfloat> m_Depth; ///< nearest occluder of each pixel
+        std::vector<GLfloat> m_TileDepth; ///< farthest depth of each tile
+        glm::mat4 m_Clip; ///< clip matrix of the latest render
+        
+        GLuint m_WorkerCount; ///< rasterizing threads besides the caller
+        std::vector<std::thread> m_Workers; ///< rasterizing threads, started on first render
+        std::mutex m_Mutex; ///< guards the frame counter and the remaining bands
+        std::condition_variable m_StartCondition; ///< signals a new frame or stop
+        std::condition_variable m_DoneCondition; ///< signals finished bands
+        bool m_Stop;
+        GLuint m_Frame; ///< frames started
+        GLuint m_Remaining; ///< worker bands of the current frame still running
+        GLuint m_Bands; ///< bands of a frame, one per worker and one for the caller
+        bool m_Rendered; ///< the depth buffer holds a view
+        
+        Statistics m_Statistics; ///< counters
+    };
+}
+
+#endif /* OcclusionCuller_h */
@@ -0,0 +1,165 @@
+//
+//  QuadTree.cpp
+//  SDL-GLEW-App
+//
+
+#include <algorithm>
+
+#include "QuadTree.h"
+
+namespace Fox {
+    
+    void QuadTree::build(const BoundingSphereSet& spheres) {
+        
+        m_Nodes.clear();
+        m_Indices.clear();
+        m_Spheres.clear();
+        m_VisitedNodes = 0;
+        
+        if(spheres.size() == 0)
+            return;
+        
+        std::vector<GLuint> order(spheres.size());
+        for(GLuint i = 0; i < order.size(); i++){
+            order[i] = i;
+        }
+        
+        // root contains every instance
+        Node root;
+        root.m_Begin = 0;
+        root.m_End = (GLuint) order.size();
+        root.m_FirstChild = 0;
+        root.m_NumChildren = 0;
+        computeBounds(root, order, spheres);
+        m_Nodes.push_back(root);
+        
+        split(0, order, spheres, 0);
+        
+        // store spheres in tree order so that every node is a contiguous range
+        m_Indices = order;
+        for(GLuint i : order){
+            m_Spheres.add(glm::vec3(spheres.m_X[i], spheres.m_Y[i], spheres.m_Z[i]), spheres.m_Radius[i]);
+        }
+    }
+    
+    void QuadTree::split(GLuint nodeIndex, std::vector<GLuint>& order, const BoundingSphereSet& spheres, GLuint depth) {
+        
+        Node node = m_Nodes[nodeIndex];
+        
+        if(node.m_End - node.m_Begin <= LEAF_SIZE || depth >= MAX_DEPTH)
+            return;
+        
+        // split at the center of the box on the xz plane
+        GLfloat centerX = 0.5f * (node.m_Min.x + node.m_Max.x);
+        GLfloat centerZ = 0.5f * (node.m_Min.z + node.m_Max.z);
+        
+        std::vector<GLuint>::iterator begin = order.begin() + node.m_Begin;
+        std::vector<GLuint>::iterator end = order.begin() + node.m_End;
+        
+        std::vector<GLuint>::iterator middle = std::partition(begin, end, [&](GLuint i){ return spheres.m_X[i] < centerX; });
+        std::vector<GLuint>::iterator lowerMiddle = std::partition(begin, middle, [&](GLuint i){ return spheres.m_Z[i] < centerZ; });
+        std::vector<GLuint>::iterator upperMiddle = std::partition(middle, end, [&](GLuint i){ return spheres.m_Z[i] < centerZ; });
+        
+        std::vector<GLuint>::iterator bounds[5] = {begin, lowerMiddle, middle, upperMiddle, end};
+        
+        // all instances at the same spot, cannot split
+        for(GLuint i = 0; i < 4; i++){
+            if(bounds[i + 1] - bounds[i] == node.m_End - node.m_Begin)
+                return;
+        }
+        
+        // create non-empty children as consecutive nodes
+        GLuint firstChild = (GLuint) m_Nodes.size();
+        GLuint numChildren = 0;
+        
+        for(GLuint i = 0; i < 4; i++){
+            
+            if(bounds[i] == bounds[i + 1])
+                continue;
+            
+            Node child;
+            child.m_Begin = (GLuint) (bounds[i] - order.begin());
+            child.m_End = (GLuint) (bounds[i + 1] - order.begin());
+            child.m_FirstChild = 0;
+            child.m_NumChildren = 0;
+            computeBounds(child, order, spheres);
+            
+            m_Nodes.push_back(child);
+            numChildren++;
+        }
+        
+        m_Nodes[nodeIndex].m_FirstChild = firstChild;
+        m_Nodes[nodeIndex].m_NumChildren = numChildren;
+        
+        for(GLuint i = 0; i < numChildren; i++){
+            split(firstChild + i, order, spheres, depth + 1);
+        }
+    }
+    
+    void QuadTree::computeBounds(Node& node, const std::vector<GLuint>& order, const BoundingSphereSet& spheres) {
+        
+        GLuint first = order[node.m_Begin];
+        glm::vec3 radius = glm::vec3(spheres.m_Radius[first]);
+        glm::vec3 center = glm::vec3(spheres.m_X[first], spheres.m_Y[first], spheres.m_Z[first]);
+        
+        node.m_Min = center - radius;
+        node.m_Max = center + radius;
+        
+        for(GLuint k = node.m_Begin + 1; k < node.m_End; k++){
+            
+            GLuint i = order[k];
+            radius = glm::vec3(spheres.m_Radius[i]);
+            center = glm::vec3(spheres.m_X[i], spheres.m_Y[i], spheres.m_Z[i]);
+            
+            node.m_Min = glm::min(node.m_Min, center - radius);
+            node.m_Max = glm::max(node.m_Max, center + radius);
+        }
+    }
+    
+    void QuadTree::cull(const Frustum& frustum, std::vector<GLuint>& visible) const {
+        
+        visible.clear();
+        m_VisitedNodes = 0;
+        
+        if(m_Nodes.empty())
+            return;
+        
+        m_Stack.clear();
+        m_Stack.push_back(0);
+        
+        while(!m_Stack.empty()){
+            
+            const Node& node = m_Nodes[m_Stack.back()];
+            m_Stack.pop_back();
+            m_VisitedNodes++;
+            
+            Frustum::Containment containment = frustum.classifyBox(node.m_Min, node.m_Max);
+            
+            // whole cell rejected
+            if(containment == Frustum::OUTSIDE)
+                continue;
+            
+            // whole cell accepted without testing instances
+            if(containment == Frustum::INSIDE){
+                visible.insert(visible.end(), m_Indices.begin() + node.m_Begin, m_Indices.begin() + node.m_End);
+                continue;
+            }
+            
+            // partially visible leaf, test instances in batches
+            if(node.m_NumChildren == 0){
+                
+                m_Scratch.clear();
+                frustum.cullSpheres(m_Spheres, node.m_Begin, node.m_End, m_Scratch);
+                
+                for(GLuint k : m_Scratch){
+                    visible.push_back(m_Indices[k]);
+                }
+                continue;
+            }
+            
+            for(GLuint i = 0; i < node.m_NumChildren; i++){
+                m_Stack.push_back(node.m_FirstChild + i);
+            }
+        }
+    }
+}
@@ -0,0 +1,110 @@
+//
+//  QuadTree.h
+//  SDL-GLEW-App
+//
+
+#ifndef QuadTree_h
+#define QuadTree_h
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "BoundingVolume.h"
+#include "Frustum.h"
+
+namespace Fox {
+    
+    /**
+     * Quadtree over instance bounding spheres on the xz plane. Every node stores the bounding box
+     * of its instances, so that whole cells are accepted or rejected with a single frustum test
+     */
+    class QuadTree {
+        
+    public:
+        
+        static const GLuint LEAF_SIZE = 64; ///< maximum number of instances in a leaf
+        static const GLuint MAX_DEPTH = 12; ///< maximum depth of the tree
+        
+        QuadTree() : m_VisitedNodes(0) {}
+        
+        /**
+         * Builds the tree from instance bounding spheres
+         *
+         * @param spheres World space bounding spheres of the instances
+         */
+        QuadTree(const BoundingSphereSet& spheres) : m_VisitedNodes(0) {
+            build(spheres);
+        }
+        
+        /**
+         * Builds the tree from instance bounding spheres
+         *
+         * @param spheres World space bounding spheres of the instances
+         */
+        void build(const BoundingSphereSet& spheres);
+        
+        /**
+         * Collects the instances inside the frustum
+         *
+         * @param frustum Frustum in world space
+         * @param visible Receives indices of the visible instances, grouped by cell
+         */
+        void cull(const Frustum& frustum, std::vector<GLuint>& visible) const;
+        
+        /**
+         * Returns number of instances in the tree
+         */
+        inline GLuint size() const {
+            return m_Spheres.size();
+        }
+        
+        /**
+         * Returns number of nodes visited by the latest cull
+         */
+        inline GLuint getVisitedNodes() const {
+            return m_VisitedNodes;
+        }
+        
+    private:
+        
+        /**
+         * Node of the tree, instances of a node are the range [m_Begin, m_End) of the tree order
+         */
+        class Node {
+        public:
+            glm::vec3 m_Min; ///< minimum corner of the bounding box
+            glm::vec3 m_Max; ///< maximum corner of the bounding box
+            GLuint m_Begin; ///< first instance
+            GLuint m_End; ///< one past the last instance
+            GLuint m_FirstChild; ///< index of the first child, 0 for leaves
+            GLuint m_NumChildren; ///< number of consecutive children
+        };
+        
+        /**
+         * Splits a node recursively
+         *
+         * @param nodeIndex Index of the node to split
+         * @param order Instance indices, reordered in place
+         * @param spheres Bounding spheres of the instances
+         * @param depth Depth of the node
+         */
+        void split(GLuint nodeIndex, std::vector<GLuint>& order, const BoundingSphereSet& spheres, GLuint depth);
+        
+        /**
+         * Computes the bounding box of a range of instances
+         */
+        static void computeBounds(Node& node, const std::vector<GLuint>& order, const BoundingSphereSet& spheres);
+        
+        std::vector<Node> m_Nodes; ///< all nodes, root first
+        std::vector<GLuint> m_Indices; ///< original instance index for each position in tree order
+        BoundingSphereSet m_Spheres; ///< bounding spheres in tree order
+        mutable std::vector<GLuint> m_Stack; ///< traversal stack
+        mutable std::vector<GLuint> m_Scratch; ///< visible positions of a partially visible leaf
+        mutable GLuint m_VisitedNodes; ///< statistics of the latest cull
+    };
+}
+
+#endif /* QuadTree_h */
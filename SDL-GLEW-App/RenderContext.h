@@ -75,6 +75,13 @@ namespace Fox {
             m_Frustum.updateFrustum(m_Projection, m_Camera.view(), model);
         }
         
+        /**
+         * Updates world space view frustum, call once per frame before culling
+         */
+        void updateFrustum(){
+            m_Frustum.updateFrustum(m_Projection * m_Camera.view());
+        }
+        
         Camera m_Camera; ///< camera of this render context
         Frustum m_Frustum; ///< frustum culling
         
@@ -0,0 +1,179 @@
+//
+//  RenderQueue.cpp
+//  SDL-GLEW-App
+//
+
+#include <algorithm>
+
+#include "RenderQueue.h"
+#include "Mesh.h"
+
+namespace Fox {
+    
+    static const uint64_t DEPTH_BITS = 24;
+    static const uint64_t SHADER_BITS = 8;
+    static const uint64_t MATERIAL_BITS = 16;
+    static const uint64_t VERTEX_ARRAY_BITS = 16;
+    
+    static const GLuint UNKNOWN_BINDING = 0xFFFFFFFF; ///< forces the first bind of a pass
+    
+    void RenderQueue::begin(SortMode mode, const glm::mat4& viewProjection) {
+        m_SortMode = mode;
+        m_ViewProjection = viewProjection;
+        m_Packets.clear();
+        m_Order.clear();
+    }
+    
+    void RenderQueue::setShaderSetup(GLuint shader, const std::function<void(GLContext*)>& setup) {
+        
+        if(shader >= m_ShaderSetups.size()){
+            m_ShaderSetups.resize(shader + 1);
+        }
+        
+        m_ShaderSetups[shader] = setup;
+    }
+    
+    void RenderQueue::submit(GLuint shader, MeshBase* mesh, GLuint data, const glm::vec3& center) {
+        
+        DrawPacket packet;
+        packet.m_Shader = shader;
+        packet.m_Mesh = mesh;
+        packet.m_Data = data;
+        packet.m_HasModel = false;
+        
+        m_Order.push_back(std::make_pair(makeKey(packet, center), (GLuint) m_Packets.size()));
+        m_Packets.push_back(packet);
+    }
+    
+    void RenderQueue::submit(GLuint shader, MeshBase* mesh, GLuint data, const glm::vec3& center, const glm::mat4& model) {
+        
+        DrawPacket packet;
+        packet.m_Shader = shader;
+        packet.m_Mesh = mesh;
+        packet.m_Data = data;
+        packet.m_HasModel = true;
+        packet.m_Model = model;
+        
+        m_Order.push_back(std::make_pair(makeKey(packet, center), (GLuint) m_Packets.size()));
+        m_Packets.push_back(packet);
+    }
+    
+    uint64_t RenderQueue::makeKey(const DrawPacket& packet, const glm::vec3& center) {
+        
+        // small material id, stable between frames
+        const void* material = &packet.m_Mesh->m_Material;
+        auto element = m_MaterialIds.find(material);
+        
+        if(element == m_MaterialIds.end()){
+            element = m_MaterialIds.insert(std::make_pair(material, (GLuint) m_MaterialIds.size())).first;
+        }
+        
+        // normalized device depth, monotonic for both perspective and orthographic projections
+        glm::vec4 clip = m_ViewProjection * glm::vec4(center, 1.0f);
+        GLfloat depth = clip.w > 0.0f ? glm::clamp(clip.z / clip.w * 0.5f + 0.5f, 0.0f, 1.0f) : 0.0f;
+        
+        uint64_t depthBits = (uint64_t) (depth * (GLfloat) ((1 << DEPTH_BITS) - 1));
+        uint64_t shaderBits = packet.m_Shader & ((1 << SHADER_BITS) - 1);
+        uint64_t materialBits = element->second & ((1 << MATERIAL_BITS) - 1);
+        uint64_t vertexArrayBits = packet.m_Mesh->getVertexArray() & ((1 << VERTEX_ARRAY_BITS) - 1);
+        
+        uint64_t state = (shaderBits << (MATERIAL_BITS + VERTEX_ARRAY_BITS)) | (materialBits << VERTEX_ARRAY_BITS) | vertexArrayBits;
+        
+        if(m_SortMode == SORT_BY_STATE)
+            return (state << DEPTH_BITS) | depthBits;
+        
+        return (depthBits << (SHADER_BITS + MATERIAL_BITS + VERTEX_ARRAY_BITS)) | state;
+    }
+    
+    void RenderQueue::execute(GLContext* gl) {
+        
+        std::sort(m_Order.begin(), m_Order.end());
+        
+        GLuint shader = UNKNOWN_BINDING;
+        MeshBase::Material* material = nullptr;
+        const glm::mat4* model = nullptr;
+        
+        for(const std::pair<uint64_t, GLuint>& entry : m_Order){
+            
+            const DrawPacket& packet = m_Packets[entry.second];
+            
+            // shader and its per pass uniforms
+            if(packet.m_Shader != shader){
+                
+                shader = packet.m_Shader;
+                gl->useShader(shader);
+                m_Statistics.m_ShaderChanges++;
+                
+                if(shader < m_ShaderSetups.size() && m_ShaderSetups[shader])
+                    m_ShaderSetups[shader](gl);
+                
+                ShaderProgram* program = gl->getCurrentShader();
+                
+                // samplers always use the unit of their texture type
+                for(GLuint i = 0; i < Texture::TextureType_Max; i++){
+                    if(textureToUniform[i] != NO_UNIFORM && program->hasUniform(textureToUniform[i]))
+                        gl->setUniformSampler2D(i, textureToUniform[i]);
+                }
+                
+                if(program->hasUniform(UNIFORM_SHADOW_MAP))
+                    gl->setUniformSampler2D(SHADOW_MAP_UNIT, UNIFORM_SHADOW_MAP);
+                
+                // the model matrix belongs to the program, send it again. Textures and the
+                // material uniform block are context state and stay bound
+                model = nullptr;
+            }
+            
+            // textures and material constants
+            if(&packet.m_Mesh->m_Material != material){
+                
+                material = &packet.m_Mesh->m_Material;
+                m_Statistics.m_MaterialChanges++;
+                
+                for(GLuint i = 0; i < material->m_Textures.size(); i++){
+                    
+                    GLuint id = material->m_Textures[i] != nullptr ? material->m_Textures[i]->m_Id : 0;
+                    
+                    // the GLContext state cache drops bindings that are already in place
+                    if(gl->bindTexture2D(i, id)){
+                        m_Statistics.m_TextureBinds++;
+                    } else {
+                        m_Statistics.m_SkippedChanges++;
+                    }
+                }
+                
+                if(material->bindUniforms(gl)){
+                    m_Statistics.m_UniformUpdates++;
+                } else {
+                    m_Statistics.m_SkippedChanges++;
+                }
+            } else {
+                m_Statistics.m_SkippedChanges++;
+            }
+            
+            // model matrix
+            if(packet.m_HasModel){
+                
+                if(model == nullptr || *model != packet.m_Model){
+                    gl->setMatrix4fUniform(packet.m_Model, UNIFORM_MODEL);
+                    model = &packet.m_Model;
+                    m_Statistics.m_UniformUpdates++;
+                } else {
+                    m_Statistics.m_SkippedChanges++;
+                }
+            }
+            
+            // geometry
+            if(gl->bindVertexArray(packet.m_Mesh->getVertexArray())){
+                m_Statistics.m_VertexArrayBinds++;
+            } else {
+                m_Statistics.m_SkippedChanges++;
+            }
+            
+            packet.m_Mesh->drawGeometry(gl, packet.m_Data);
+            m_Statistics.m_DrawCalls++;
+        }
+        
+        m_Packets.clear();
+        m_Order.clear();
+    }
+}
@@ -0,0 +1,155 @@
+//
+//  RenderQueue.h
+//  SDL-GLEW-App
+//
+
+#ifndef RenderQueue_h
+#define RenderQueue_h
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "GLContext.h"
+
+namespace Fox {
+    
+    class MeshBase;
+    
+    /**
+     * Collects the draw packets of a pass, sorts them by 64-bit keys and executes them
+     * so that shader, texture, uniform and vertex array changes happen only when needed
+     */
+    class RenderQueue {
+        
+    public:
+        
+        /**
+         * Order of the packets of a pass
+         */
+        enum SortMode {
+            SORT_BY_STATE, ///< shader, material, vertex array, then front to back
+            SORT_FRONT_TO_BACK ///< front to back for early depth rejection, then state
+        };
+        
+        /**
+         * Counters of the executed passes, reset with resetStatistics
+         */
+        class Statistics {
+        public:
+            
+            Statistics() {
+                reset();
+            }
+            
+            void reset() {
+                m_DrawCalls = 0;
+                m_ShaderChanges = 0;
+                m_MaterialChanges = 0;
+                m_TextureBinds = 0;
+                m_VertexArrayBinds = 0;
+                m_UniformUpdates = 0;
+                m_SkippedChanges = 0;
+            }
+            
+            GLuint m_DrawCalls;
+            GLuint m_ShaderChanges;
+            GLuint m_MaterialChanges;
+            GLuint m_TextureBinds;
+            GLuint m_VertexArrayBinds;
+            GLuint m_UniformUpdates; ///< model matrices sent
+            GLuint m_SkippedChanges; ///< redundant binds and uniforms that were not sent
+        };
+        
+        RenderQueue() : m_SortMode(SORT_BY_STATE) {}
+        
+        /**
+         * Starts collecting a new pass
+         *
+         * @param mode Sort order of the pass
+         * @param viewProjection Matrix used to measure depth of the packets
+         */
+        void begin(SortMode mode, const glm::mat4& viewProjection);
+        
+        /**
+         * Sets a function that sends per pass uniforms whenever the shader is taken into use
+         *
+         * @param shader Shader index in GLContext
+         * @param setup Function setting the uniforms
+         */
+        void setShaderSetup(GLuint shader, const std::function<void(GLContext*)>& setup);
+        
+        /**
+         * Adds a draw packet to the pass
+         *
+         * @param shader Shader index in GLContext
+         * @param mesh Mesh providing material, vertex array and the draw call
+         * @param data Passed to MeshBase::drawGeometry, e.g. instance count or chunk index
+         * @param center World space center used for depth sorting
+         */
+        void submit(GLuint shader, MeshBase* mesh, GLuint data, const glm::vec3& center);
+        
+        /**
+         * Adds a draw packet with a model matrix to the pass
+         *
+         * @param shader Shader index in GLContext
+         * @param mesh Mesh providing material, vertex array and the draw call
+         * @param data Passed to MeshBase::drawGeometry
+         * @param center World space center used for depth sorting
+         * @param model Model matrix sent to the model uniform
+         */
+        void submit(GLuint shader, MeshBase* mesh, GLuint data, const glm::vec3& center, const glm::mat4& model);
+        
+        /**
+         * Sorts and draws the packets of the pass, then empties the queue
+         *
+         * @param gl GLContext
+         */
+        void execute(GLContext* gl);
+        
+        inline const Statistics& getStatistics() const {
+            return m_Statistics;
+        }
+        
+        inline void resetStatistics() {
+            m_Statistics.reset();
+        }
+        
+    private:
+        
+        /**
+         * Everything needed to issue one draw call
+         */
+        class DrawPacket {
+        public:
+            GLuint m_Shader;
+            MeshBase* m_Mesh;
+            GLuint m_Data;
+            GLboolean m_HasModel;
+            glm::mat4 m_Model;
+        };
+        
+        /**
+         * Builds the sort key of a packet
+         */
+        uint64_t makeKey(const DrawPacket& packet, const glm::vec3& center);
+        
+        SortMode m_SortMode; ///< order of the current pass
+        glm::mat4 m_ViewProjection; ///< depth of the current pass
+        
+        std::vector<DrawPacket> m_Packets; ///< packets of the current pass
+        std::vector<std::pair<uint64_t, GLuint>> m_Order; ///< sort key and packet index
+        
+        std::vector<std::function<void(GLContext*)>> m_ShaderSetups; ///< per shader uniform setup
+        std::unordered_map<const void*, GLuint> m_MaterialIds; ///< small ids of materials for the keys
+        
+        Statistics m_Statistics; ///< counters
+    };
+}
+
+#endif /* RenderQueue_h */
@@ -0,0 +1,150 @@
+//
+//  ShaderCache.cpp
+//  SDL-GLEW-App
+//
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "ShaderCache.h"
+
+namespace Fox {
+    
+    /**
+     * Continues a 64 bit FNV-1a hash over a block of bytes
+     */
+    static uint64_t hashBytes(const void* data, size_t size, uint64_t hash){
+        
+        const unsigned char* bytes = (const unsigned char*) data;
+        
+        for(size_t i = 0; i < size; i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        
+        return hash;
+    }
+    
+    /**
+     * Continues a hash over a driver string, a missing string hashes as empty
+     */
+    static uint64_t hashString(GLenum name, uint64_t hash){
+        
+        const GLubyte* string = glGetString(name);
+        
+        if(string == nullptr)
+            return hash;
+        
+        // include the terminator so that neighbouring strings do not run together
+        return hashBytes(string, strlen((const char*) string) + 1, hash);
+    }
+    
+    uint64_t ShaderCache::key(const GLchar* const* sources, const GLint* sizes, GLuint count) {
+        
+        if(m_DriverHash == 0){
+            m_DriverHash = 14695981039346656037ull;
+            m_DriverHash = hashString(GL_VENDOR, m_DriverHash);
+            m_DriverHash = hashString(GL_RENDERER, m_DriverHash);
+            m_DriverHash = hashString(GL_VERSION, m_DriverHash);
+        }
+        
+        uint64_t hash = m_DriverHash;
+        
+        for(GLuint i = 0; i < count; i++){
+            hash = hashBytes(&sizes[i], sizeof(GLint), hash);
+            hash = hashBytes(sources[i], sizes[i], hash);
+        }
+        
+        return hash;
+    }
+    
+    std::string ShaderCache::path(uint64_t key) const {
+        
+        std::ostringstream stream;
+        stream << m_Directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+        
+        return stream.str();
+    }
+    
+    ShaderProgram* ShaderCache::load(uint64_t key) {
+        
+        FILE* file = fopen(path(key).c_str(), "rb");
+        
+        if(file == nullptr)
+            return nullptr;
+        
+        Header header;
+        std::vector<GLubyte> binary;
+        
+        bool valid = fread(&header, sizeof(Header), 1, file) == 1 && header.m_Magic == MAGIC && header.m_Version == VERSION && header.m_Key == key;
+        
+        if(valid){
+            binary.resize(header.m_Length);
+            valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+        }
+        
+        fclose(file);
+        
+        if(!valid)
+            return nullptr;
+        
+        ShaderProgram* program = new ShaderProgram((GLenum) header.m_Format, binary.data(), (GLsizei) binary.size());
+        
+        // the driver may refuse binaries of an older build even when the version string is the same
+        if(!program->isLinked()){
+            delete program;
+            return nullptr;
+        }
+        
+        return program;
+    }
+    
+    GLboolean ShaderCache::store(uint64_t key, const ShaderProgram* program) {
+        
+        GLint length = 0;
+        glGetProgramiv(program->m_Id, GL_PROGRAM_BINARY_LENGTH, &length);
+        
+        // drivers without binary formats report zero
+        if(length <= 0)
+            return false;
+        
+        std::vector<GLubyte> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program->m_Id, length, &length, &format, binary.data());
+        
+        Header header;
+        header.m_Magic = MAGIC;
+        header.m_Version = VERSION;
+        header.m_Key = key;
+        header.m_Format = format;
+        header.m_Length = (GLuint) length;
+        
+        mkdir(m_Directory.c_str(), 0755);
+        
+        // write next to the final file and rename so that a crash never leaves a partial cache
+        std::string filePath = path(key);
+        std::string tempPath = filePath + ".tmp";
+        
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        
+        if(file == nullptr)
+            return false;
+        
+        bool written = fwrite(&header, sizeof(Header), 1, file) == 1 && fwrite(binary.data(), 1, length, file) == (size_t) length;
+        
+        fclose(file);
+        
+        if(!written || rename(tempPath.c_str(), filePath.c_str()) != 0){
+            remove(tempPath.c_str());
+            return false;
+        }
+        
+        return true;
+    }
+}
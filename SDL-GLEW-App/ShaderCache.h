@@ -0,0 +1,83 @@
+//
+//  ShaderCache.h
+//  SDL-GLEW-App
+//
+
+#ifndef ShaderCache_h
+#define ShaderCache_h
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+#include "ShaderProgram.hpp"
+
+namespace Fox {
+    
+    /**
+     * On-disk cache of linked shader program binaries. A program is stored under a key made of its
+     * sources and the vendor, renderer and version of the driver, so that a driver update or an
+     * edited shader falls back to compiling from source
+     */
+    class ShaderCache {
+    
+    public:
+        
+        static const GLuint MAGIC = 0x53584F46; ///< "FOXS"
+        static const GLuint VERSION = 1; ///< bump when the layout changes
+        
+        /**
+         * Beginning of a cache file, the program binary follows
+         */
+        class Header {
+        public:
+            GLuint m_Magic;
+            GLuint m_Version;
+            uint64_t m_Key; ///< key the binary was stored under
+            GLuint m_Format; ///< binary format given by the driver
+            GLuint m_Length; ///< length of the binary
+        };
+        
+        ShaderCache() : m_Directory("ShaderCache"), m_DriverHash(0) {}
+        
+        /**
+         * Computes the key of a program from its sources and the current driver
+         *
+         * @param sources Sources of all shader stages
+         * @param sizes Sizes of the sources
+         * @param count Number of stages
+         * @return cache key
+         */
+        uint64_t key(const GLchar* const* sources, const GLint* sizes, GLuint count);
+        
+        /**
+         * Creates a program from a cached binary
+         *
+         * @param key Key from key()
+         * @return linked program, nullptr if there is no binary or the driver rejects it
+         */
+        ShaderProgram* load(uint64_t key);
+        
+        /**
+         * Stores the binary of a linked program
+         *
+         * @param key Key from key()
+         * @param program Program linked from source
+         * @return false if the driver gives no binary or the file could not be written
+         */
+        GLboolean store(uint64_t key, const ShaderProgram* program);
+    
+    private:
+        
+        /**
+         * Returns path of the cache file of a key
+         */
+        std::string path(uint64_t key) const;
+        
+        std::string m_Directory; ///< directory of the cache files
+        uint64_t m_DriverHash; ///< hash of vendor, renderer and version, computed on first use
+    };
+}
+
+#endif /* ShaderCache_h */
@@ -6,100 +6,207 @@
 //  Copyright © 2017 Olli Kettunen. All rights reserved.
 //
 
+#include <string>
+
 #include "ShaderProgram.hpp"
 
 namespace Fox
 {
     
-    ShaderProgram::ShaderProgram(const GLchar* vertexShaderSource, GLint vfSize, const GLchar* fragmentShaderSource, GLint ffSize) {
-
+    ShaderProgram::ShaderProgram(const GLchar* vertexShaderSource, GLint vfSize, const GLchar* fragmentShaderSource, GLint ffSize, GLboolean deferred) {
+        
         // create vertex and fragment shader
         m_VertexShader = createGLShader(GL_VERTEX_SHADER, vertexShaderSource, vfSize);
+        m_GeometryShader = 0;
         m_FragmentShader = createGLShader(GL_FRAGMENT_SHADER, fragmentShaderSource, ffSize);
+        m_ComputeShader = 0;
         
-        // create shader program
-        m_Id = glCreateProgram();
+        link();
         
-        // attach vertex and fragment shaders
-        glAttachShader(m_Id, m_VertexShader);
-        glAttachShader(m_Id, m_FragmentShader);
-        
-        // link shader program
-        glLinkProgram(m_Id);
-        
-        GLint success;
-        GLchar infoLog[512];
-        
-        // check if shader program linking succeeded
-        glGetProgramiv(m_Id, GL_LINK_STATUS, &success);
-        
-        // if not, print out error message
-        if(!success) {
-            glGetProgramInfoLog(m_Id, 512, NULL, infoLog);
-            std::cout << "Shader program linking failed" << std::endl;
-        }
-        // delete unnecessary shaders
-        glDeleteShader(m_VertexShader);
-        glDeleteShader(m_FragmentShader);
-    
+        if(!deferred)
+            finish();
     }
     
-    ShaderProgram::ShaderProgram(const GLchar* vertexShaderSource, GLint vfSize, const GLchar* geometryShaderSource, GLint gfSize, const GLchar* fragmentShaderSource, GLint ffSize) {
+    ShaderProgram::ShaderProgram(const GLchar* vertexShaderSource, GLint vfSize, const GLchar* geometryShaderSource, GLint gfSize, const GLchar* fragmentShaderSource, GLint ffSize, GLboolean deferred) {
         
         // create vertex, geometry and fragment shader
         m_VertexShader = createGLShader(GL_VERTEX_SHADER, vertexShaderSource, vfSize);
         m_GeometryShader = createGLShader(GL_GEOMETRY_SHADER, geometryShaderSource, gfSize);
         m_FragmentShader = createGLShader(GL_FRAGMENT_SHADER, fragmentShaderSource, ffSize);
+        m_ComputeShader = 0;
+        
+        link();
+        
+        if(!deferred)
+            finish();
+        
+        std::cout << "Create program" << std::endl;
+    }
     
+    ShaderProgram::ShaderProgram(const GLchar* computeShaderSource, GLint cfSize) {
+        
+        // a compute program has no other stages
+        m_VertexShader = m_GeometryShader = m_FragmentShader = 0;
+        m_ComputeShader = createGLShader(GL_COMPUTE_SHADER, computeShaderSource, cfSize);
+        
+        link();
+        finish();
+    }
+    
+    void ShaderProgram::link() {
+        
         // create shader program
         m_Id = glCreateProgram();
+        m_Linked = false;
+        
+        // keep the linked binary available for the shader cache
+        glProgramParameteri(m_Id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         
-        // attach vertex and fragment shaders
-        glAttachShader(m_Id, m_VertexShader);
-        glAttachShader(m_Id, m_GeometryShader);
-        glAttachShader(m_Id, m_FragmentShader);
+        // attach all shaders
+        GLuint shaders[] = {m_VertexShader, m_GeometryShader, m_FragmentShader, m_ComputeShader};
+        for(GLuint shader : shaders){
+            if(shader != 0)
+                glAttachShader(m_Id, shader);
+        }
         
-        // link shader program
+        // link shader program, the result is not asked for here so that the driver can work
+        // on it while other programs are submitted
         glLinkProgram(m_Id);
+    }
+    
+    GLboolean ShaderProgram::finish() {
         
         GLint success;
         GLchar infoLog[512];
         
         // check if shader program linking succeeded
         glGetProgramiv(m_Id, GL_LINK_STATUS, &success);
+        m_Linked = success == GL_TRUE;
         
-        // if not, print out error message
+        // if not, print out error messages of the shaders and the program
         if(!success) {
+            printCompileLog(m_VertexShader, "Vertex");
+            printCompileLog(m_GeometryShader, "Geometry");
+            printCompileLog(m_FragmentShader, "Fragment");
+            printCompileLog(m_ComputeShader, "Compute");
+            
             glGetProgramInfoLog(m_Id, 512, NULL, infoLog);
-            std::cout << "Shader program linking failed" << std::endl;
+            std::cout << "Shader program linking failed\n" << infoLog << std::endl;
         }
+        
         // delete unnecessary shaders
-        glDeleteShader(m_VertexShader);
-        glDeleteShader(m_GeometryShader);
-        glDeleteShader(m_FragmentShader);
+        GLuint shaders[] = {m_VertexShader, m_GeometryShader, m_FragmentShader, m_ComputeShader};
+        for(GLuint shader : shaders){
+            if(shader != 0){
+                glDetachShader(m_Id, shader);
+                glDeleteShader(shader);
+            }
+        }
+        m_VertexShader = m_GeometryShader = m_FragmentShader = m_ComputeShader = 0;
         
-        std::cout << "Create program" << std::endl;
+        reflectUniforms();
+        
+        return m_Linked;
     }
     
-    GLuint ShaderProgram::createGLShader(GLenum type, const GLchar* shaderSource, GLint fSize) {
-    
-        GLuint shaderId;
-        shaderId = glCreateShader(type);
-        glShaderSource(shaderId, 1, &shaderSource, &fSize);
-        glCompileShader(shaderId);
+    void ShaderProgram::printCompileLog(GLuint shader, const GLchar* stage) {
+        
+        if(shader == 0)
+            return;
         
-        // check if shader compilation succeeded
         GLint success;
         GLchar infoLog[512];
-        glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
         
-        // if not, print out error message
         if(!success)
         {
-            glGetShaderInfoLog(shaderId, 512, NULL, infoLog);
-            std::cout << "Vertex shader compilation failed\n" << infoLog << std::endl;
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cout << stage << " shader compilation failed\n" << infoLog << std::endl;
+        }
+    }
+    
+    ShaderProgram::ShaderProgram(GLenum binaryFormat, const GLvoid* binary, GLsizei length) {
+        
+        m_VertexShader = m_GeometryShader = m_FragmentShader = m_ComputeShader = 0;
+        
+        m_Id = glCreateProgram();
+        glProgramBinary(m_Id, binaryFormat, binary, length);
+        
+        // a rejected binary leaves the program unlinked
+        GLint success;
+        glGetProgramiv(m_Id, GL_LINK_STATUS, &success);
+        m_Linked = success == GL_TRUE;
+        
+        reflectUniforms();
+    }
+    
+    void ShaderProgram::reflectUniforms() {
+        
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(m_Id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(m_Id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        
+        // keep the table at most half full, arrays take two slots
+        GLuint size = 16;
+        while(size < 4 * (GLuint) count)
+            size *= 2;
+        
+        UniformSlot empty = {NO_UNIFORM, -1};
+        m_UniformTable.assign(size, empty);
+        m_UniformMask = size - 1;
+        
+        std::vector<GLchar> name(maxLength + 1);
+        
+        for(GLint i = 0; i < count; i++){
+            
+            GLsizei length = 0;
+            GLint arraySize = 0;
+            GLenum type;
+            glGetActiveUniform(m_Id, (GLuint) i, (GLsizei) name.size(), &length, &arraySize, &type, name.data());
+            
+            GLint location = glGetUniformLocation(m_Id, name.data());
+            
+            // members of uniform blocks have no location
+            if(location < 0)
+                continue;
+            
+            // arrays are reported as name[0], also allow the plain name
+            if(length > 3 && std::string(name.data() + length - 3) == "[0]"){
+                addUniform(name.data(), location);
+                name[length - 3] = '\0';
+            }
+            
+            addUniform(name.data(), location);
         }
+    }
+    
+    void ShaderProgram::addUniform(const GLchar* name, GLint location) {
+        
+        UniformId uniform = uniformId(name);
+        
+        GLuint i = uniform & m_UniformMask;
+        while(m_UniformTable[i].m_Id != NO_UNIFORM){
+            
+            if(m_UniformTable[i].m_Id == uniform){
+                std::cout << "Uniform " << name << " collides with another uniform name" << std::endl;
+                return;
+            }
+            
+            i = (i + 1) & m_UniformMask;
+        }
+        
+        m_UniformTable[i].m_Id = uniform;
+        m_UniformTable[i].m_Location = location;
+    }
+    
+    GLuint ShaderProgram::createGLShader(GLenum type, const GLchar* shaderSource, GLint fSize) {
+        
+        GLuint shaderId;
+        shaderId = glCreateShader(type);
+        glShaderSource(shaderId, 1, &shaderSource, &fSize);
+        glCompileShader(shaderId);
         
+        // compile status is checked by finish only if linking fails, asking for it here would wait for the compiler
         return shaderId;
     }
 }
@@ -12,7 +12,9 @@
 #include <GL/glew.h>
 
 #include <iostream>
-#include <unordered_map>
+#include <vector>
+
+#include "UniformId.h"
 
 namespace Fox {
 
@@ -26,8 +28,9 @@ public:
      * @param vfSize Vertex file size
      * @param fragmentShaderSource Source for fragment shader
      * @param ffSize Fragment shader file size
+     * @param deferred If true, compile and link are only submitted and finish must be called before use
      */
-    ShaderProgram(const GLchar* vertexShaderSource, GLint vfSize, const GLchar* fragmentShaderSource, GLint ffSize);
+    ShaderProgram(const GLchar* vertexShaderSource, GLint vfSize, const GLchar* fragmentShaderSource, GLint ffSize, GLboolean deferred = false);
     
     /**
      * Creates a shader program from given vertex, geometry and fragment shader sources
@@ -38,8 +41,26 @@ public:
      * @param gfSize Geometry shader file size
      * @param fragmentShaderSource Source for fragment shader
      * @param ffSize Fragment shader file size
+     * @param deferred If true, compile and link are only submitted and finish must be called before use
+     */
+    ShaderProgram(const GLchar* vertexShaderSource, GLint vfSize, const GLchar* geometryShaderSource, GLint gfSize, const GLchar* fragmentShaderSource, GLint ffSize, GLboolean deferred = false);
+    
+    /**
+     * Creates a compute program from given compute shader source, needs OpenGL 4.3
+     *
+     * @param computeShaderSource Source for compute shader
+     * @param cfSize Compute shader file size
      */
-    ShaderProgram(const GLchar* vertexShaderSource, GLint vfSize, const GLchar* geometryShaderSource, GLint gfSize, const GLchar* fragmentShaderSource, GLint ffSize);
+    ShaderProgram(const GLchar* computeShaderSource, GLint cfSize);
+    
+    /**
+     * Creates a shader program from a binary given by glGetProgramBinary, the program is finished
+     *
+     * @param binaryFormat Format of the binary
+     * @param binary Program binary
+     * @param length Length of the binary
+     */
+    ShaderProgram(GLenum binaryFormat, const GLvoid* binary, GLsizei length);
     
     /**
      * Destroys this shader program
@@ -48,6 +69,13 @@ public:
         glDeleteProgram(m_Id);
     }
     
+    /**
+     * Waits for the submitted link, prints errors, releases the shaders and reads the active uniforms
+     *
+     * @return true if the program linked
+     */
+    GLboolean finish();
+    
     /**
      * Creates an OpenGL shader of given type from the source
      * 
@@ -59,37 +87,91 @@ public:
     GLuint createGLShader(GLenum type, const GLchar* shaderSource, GLint fSize);
     
     /**
-     * Adds an uniform variable to shader
+     * Attaches an uniform block of this program to a binding point
      *
-     * @param name Name of the uniform
-     * @return identifier for the uniform
+     * @param blockName Name of the uniform block
+     * @param binding Binding point
+     * @return false if the program has no such block
      */
-    GLint addUniform(const GLchar* name){
-        GLint uniform = glGetUniformLocation(m_Id, name);
-        uniforms[name] = uniform;
-        return uniform;
+    bool bindUniformBlock(const GLchar* blockName, GLuint binding){
+        GLuint index = glGetUniformBlockIndex(m_Id, blockName);
+        if(index == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(m_Id, index, binding);
+        return true;
     }
     
-    bool hasUniform(const GLchar* uniformName){
-        return uniforms.find(uniformName) != uniforms.end();
+    bool hasUniform(UniformId uniform) const {
+        return getLocation(uniform) != -1;
     }
     
     /**
-     * Returns a location of an uniform
+     * Returns a location of an uniform, -1 if the program has no such uniform
      *
-     * @param uniformName Name for uniform
+     * @param uniform Identifier of the uniform, see uniformId
      * @return GLint location of the uniform
      */
-    inline GLint getLocation(const GLchar* uniformName) const{
-        return uniforms.find(uniformName)->second;
+    inline GLint getLocation(UniformId uniform) const{
+        
+        // open addressing, the table is at most half full so an empty slot ends the probe
+        for(GLuint i = uniform & m_UniformMask; ; i = (i + 1) & m_UniformMask){
+            const UniformSlot& slot = m_UniformTable[i];
+            if(slot.m_Id == uniform)
+                return slot.m_Location;
+            if(slot.m_Id == NO_UNIFORM)
+                return -1;
+        }
     }
     
-    GLuint m_Id; // id of the shader program
+    /**
+     * Returns true if the program linked, a binary rejected by the driver does not
+     */
+    inline bool isLinked() const {
+        return m_Linked;
+    }
     
+    GLuint m_Id; // id of the shader program
+
 private:
     
-    GLuint m_VertexShader, m_GeometryShader, m_FragmentShader; ///< ids for all shader types
-    std::unordered_map<const GLchar*, GLint> uniforms; ///< uniform map
+    /**
+     * Location of an uniform in the uniform table
+     */
+    struct UniformSlot {
+        UniformId m_Id; ///< hashed name, NO_UNIFORM for an empty slot
+        GLint m_Location; ///< uniform location
+    };
+    
+    /**
+     * Creates the program from the compiled shaders and submits the link
+     */
+    void link();
+    
+    /**
+     * Prints the compile log of a shader that failed to compile
+     *
+     * @param shader Shader id, 0 is skipped
+     * @param stage Name of the stage for the message
+     */
+    void printCompileLog(GLuint shader, const GLchar* stage);
+    
+    /**
+     * Fills the uniform table with all active uniforms of the linked program
+     */
+    void reflectUniforms();
+    
+    /**
+     * Adds an uniform to the uniform table
+     *
+     * @param name Name of the uniform
+     * @param location Location of the uniform
+     */
+    void addUniform(const GLchar* name, GLint location);
+    
+    GLuint m_VertexShader, m_GeometryShader, m_FragmentShader, m_ComputeShader; ///< ids for all shader types
+    bool m_Linked; ///< link status
+    std::vector<UniformSlot> m_UniformTable; ///< uniform locations by hashed name
+    GLuint m_UniformMask; ///< table size - 1, the size is a power of two
 };
     
 }
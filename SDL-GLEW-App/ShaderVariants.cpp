@@ -0,0 +1,98 @@
+//
+//  ShaderVariants.cpp
+//  SDL-GLEW-App
+//
+
+#include <sstream>
+
+#include "ShaderVariants.h"
+#include "ResourceManager.h"
+
+namespace Fox {
+    
+    void ShaderVariants::load(char* vertexShaderFile, char* fragmentShaderFile) {
+        
+        GLint vertexShaderFileSize;
+        char* vertexShaderData = ResourceManager::loadFile(vertexShaderFile, vertexShaderFileSize);
+        
+        GLint fragmentShaderFileSize;
+        char* fragmentShaderData = ResourceManager::loadFile(fragmentShaderFile, fragmentShaderFileSize);
+        
+        m_VertexSource.assign(vertexShaderData, vertexShaderFileSize);
+        m_FragmentSource.assign(fragmentShaderData, fragmentShaderFileSize);
+        m_Name = vertexShaderFile;
+        
+        delete[] vertexShaderData;
+        delete[] fragmentShaderData;
+        
+        m_Variants.clear();
+    }
+    
+    GLuint ShaderVariants::getShader(GLContext* gl, GLuint features) {
+        
+        features = reduce(features);
+        
+        auto variant = m_Variants.find(features);
+        
+        if(variant != m_Variants.end())
+            return variant->second;
+        
+        std::string header = preamble(features);
+        std::string vertexSource = header + m_VertexSource;
+        std::string fragmentSource = header + m_FragmentSource;
+        
+        std::ostringstream name;
+        name << m_Name << " (features 0x" << std::hex << features << ")";
+        
+        // the source of each variant differs, so each one gets its own binary cache entry
+        GLuint shader = gl->addShaderProgram(vertexSource.c_str(), (GLint) vertexSource.size(), fragmentSource.c_str(), (GLint) fragmentSource.size(), name.str());
+        
+        m_Variants[features] = shader;
+        
+        return shader;
+    }
+    
+    GLuint ShaderVariants::reduce(GLuint features) {
+        
+        // the terrain patch has no tangents, is never instanced and has its own vertex format
+        if(features & TERRAIN)
+            features &= ~(NORMAL_MAP | INSTANCED | QUANTIZED);
+        
+        // depth only variants only need the geometry inputs, packed positions need no decoding
+        if(features & DEPTH_ONLY)
+            features &= ~(NORMAL_MAP | SPOT_LIGHT | SHADOWS | POINT_LIGHT_MASK | QUANTIZED);
+        
+        if(((features & POINT_LIGHT_MASK) >> POINT_LIGHT_SHIFT) > MAX_POINT_LIGHTS)
+            features = (features & ~POINT_LIGHT_MASK) | pointLights(MAX_POINT_LIGHTS);
+        
+        return features;
+    }
+    
+    std::string ShaderVariants::preamble(GLuint features) {
+        
+        std::ostringstream stream;
+        stream << "#version 330 core\n";
+        
+        if(features & NORMAL_MAP)
+            stream << "#define NORMAL_MAP\n";
+        if(features & SPOT_LIGHT)
+            stream << "#define SPOT_LIGHT\n";
+        if(features & SHADOWS)
+            stream << "#define SHADOWS\n";
+        if(features & INSTANCED)
+            stream << "#define INSTANCED\n";
+        if(features & TERRAIN)
+            stream << "#define TERRAIN\n";
+        if(features & DEPTH_ONLY)
+            stream << "#define DEPTH_ONLY\n";
+        if(features & QUANTIZED)
+            stream << "#define QUANTIZED\n";
+        
+        stream << "#define NR_POINT_LIGHTS " << ((features & POINT_LIGHT_MASK) >> POINT_LIGHT_SHIFT) << "\n";
+        
+        // keep line numbers of compile errors pointing into the uber source
+        stream << "#line 1\n";
+        
+        return stream.str();
+    }
+}
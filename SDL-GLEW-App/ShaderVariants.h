@@ -0,0 +1,102 @@
+//
+//  ShaderVariants.h
+//  SDL-GLEW-App
+//
+
+#ifndef ShaderVariants_h
+#define ShaderVariants_h
+
+#include <GL/glew.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "GLContext.h"
+#include "Texture.h"
+#include "UniformBuffer.h"
+
+namespace Fox {
+    
+    static const GLuint SHADOW_MAP_UNIT = Texture::TextureType_Max; ///< texture unit of the shadow map, after the material units
+    
+    /**
+     * Permutations of one uber shader. Each feature set is compiled with its features as
+     * #defines on first use and kept by its feature mask, so a draw only pays for the lights
+     * and inputs it asks for
+     */
+    class ShaderVariants {
+    
+    public:
+        
+        /**
+         * Feature bits, the number of point lights is stored above them, see pointLights
+         */
+        enum Feature {
+            NORMAL_MAP = 1 << 0, ///< tangent space normal map, needs tangents in the vertices
+            SPOT_LIGHT = 1 << 1, ///< spot light of the light uniforms
+            SHADOWS = 1 << 2, ///< directional light shadowed by the shadow map
+            INSTANCED = 1 << 3, ///< model matrix from the instance buffer
+            TERRAIN = 1 << 4, ///< shared terrain patch displaced by the height map
+            DEPTH_ONLY = 1 << 5, ///< light space depth only, for the shadow map
+            QUANTIZED = 1 << 6 ///< octahedral normals and tangents of packed vertices, see VertexQPNT
+        };
+        
+        static const GLuint POINT_LIGHT_SHIFT = 8; ///< first bit of the point light count
+        static const GLuint POINT_LIGHT_MASK = 7 << POINT_LIGHT_SHIFT; ///< bits of the point light count
+        
+        /**
+         * Returns the feature bits of a number of point lights
+         *
+         * @param count Number of point lights, clamped to MAX_POINT_LIGHTS
+         */
+        static GLuint pointLights(GLuint count){
+            return (count < MAX_POINT_LIGHTS ? count : MAX_POINT_LIGHTS) << POINT_LIGHT_SHIFT;
+        }
+        
+        ShaderVariants() {}
+        
+        /**
+         * Reads the uber shader sources, no variant is compiled yet
+         *
+         * @param vertexShaderFile File containing vertex shader source
+         * @param fragmentShaderFile File containing fragment shader source
+         */
+        void load(char* vertexShaderFile, char* fragmentShaderFile);
+        
+        /**
+         * Returns the variant of a feature set, compiling it on first use. Features that do not
+         * apply together are dropped first, so equivalent requests share one program
+         *
+         * @param gl GLContext
+         * @param features Feature bits
+         * @return shader index in GLContext
+         */
+        GLuint getShader(GLContext* gl, GLuint features);
+        
+        /**
+         * Returns the number of compiled variants
+         */
+        inline GLuint size() const {
+            return (GLuint) m_Variants.size();
+        }
+    
+    private:
+        
+        /**
+         * Drops the features a variant cannot use, e.g. lighting of depth only variants
+         */
+        static GLuint reduce(GLuint features);
+        
+        /**
+         * Builds #version and the #defines of a feature set
+         */
+        static std::string preamble(GLuint features);
+        
+        std::string m_VertexSource; ///< uber vertex shader without #version
+        std::string m_FragmentSource; ///< uber fragment shader without #version
+        std::string m_Name; ///< vertex shader file for messages
+        std::unordered_map<GLuint, GLuint> m_Variants; ///< shader index of each compiled feature mask
+    };
+}
+
+#endif /* ShaderVariants_h */
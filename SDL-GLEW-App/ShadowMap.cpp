@@ -56,8 +56,7 @@ namespace Fox {
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
     }
     
-    void ShadowMap::renderToDepthBuffer(GLContext* gl){
-    
+    void ShadowMap::updateLightSpaceMatrix(GLContext* gl){
         
         RenderContext& rc = gl->getCurrentRenderContext();
         
@@ -69,13 +68,16 @@ namespace Fox {
         lightView = glm::lookAt(glm::vec3(-2.0f, 3.0f, -3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
        // lightView = glm::lookAt(glm::vec3(-2.0, 4.0f, -1.0f), glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
         lightSpaceMatrix = lightProjection * lightView;
-        
-        // render scene from light's point of view
-        gl->useShader(4);
-        gl->setMatrix4fUniform(lightSpaceMatrix, "lightSpaceMatrix");
-        
+        m_LightSpaceMatrix = lightSpaceMatrix;
+        m_Frustum.updateFrustum(lightSpaceMatrix);
+    }
+    
+    void ShadowMap::renderToDepthBuffer(GLContext* gl){
+    
+        // render scene from light's point of view, the depth only variants read the light space
+        // matrix from the frame uniforms
         // change viewport to match the shadow map
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+        gl->viewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
         
         // switch to depth map buffer
         glBindFramebuffer(GL_FRAMEBUFFER, m_DepthMapFBO);
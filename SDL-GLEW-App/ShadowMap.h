@@ -23,30 +23,58 @@ namespace Fox {
     
     public:
         
-        ShadowMap(){
+        ShadowMap() : m_VisualizeShaderIndex(0) {
             init();
         }
         
         void init();
         
+        /**
+         * Computes the light space matrix and frustum for the current render context
+         *
+         * @param gl GLContext
+         */
+        void updateLightSpaceMatrix(GLContext* gl);
+        
         void renderToDepthBuffer(GLContext* gl);
         
+        /**
+         * Returns the light space matrix computed by updateLightSpaceMatrix
+         */
+        const glm::mat4& getLightSpaceMatrix() const {
+            return m_LightSpaceMatrix;
+        }
+        
+        /**
+         * Returns the frustum of the light used by the latest depth pass
+         */
+        const Frustum& getFrustum() const {
+            return m_Frustum;
+        }
+        
+        /**
+         * Returns the depth map texture, bound to SHADOW_MAP_UNIT for shadowed lighting
+         */
+        GLuint getDepthMap() const {
+            return m_DepthMap;
+        }
+        
         void switchToBackBuffer() {
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
         }
         
         void visualizeDepthBuffer(GLContext* gl){
             
-            gl->useShader(5);
+            gl->useShader(m_VisualizeShaderIndex);
             
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, m_DepthMap);
+            gl->bindTexture2D(0, m_DepthMap);
             
-            glBindVertexArray(m_QuadVao);
+            gl->bindVertexArray(m_QuadVao);
             glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-            glBindVertexArray(0);
         }
         
+        GLuint m_VisualizeShaderIndex; ///< shader index of the depth map visualization
+        
     private:
         
         GLuint m_DepthMapFBO; ///< depth map frame buffer object
@@ -54,6 +82,9 @@ namespace Fox {
         
         GLuint m_QuadVao; ///< quad for visualizing the depth map
         GLuint m_QuadVbo; ///< vertex buffer object for visualizing the depth map
+        
+        glm::mat4 m_LightSpaceMatrix; ///< projection * view of the light
+        Frustum m_Frustum; ///< world space frustum of the light for culling shadow casters
     };
     
     
@@ -32,23 +32,21 @@ namespace Fox {
         
         void draw(GLContext* gl){
         
-            glDepthFunc(GL_LEQUAL);
+            gl->depthFunc(GL_LEQUAL);
             gl->useShader(m_SkyboxShaderIndex);
         
-            gl->setProjectionUniform("projection");
-            gl->setViewUniformForSkybox("view");
+            // view and projection come from the frame uniforms
 
             // skybox cube
-            glBindVertexArray(m_SkyboxVao);
+            gl->bindVertexArray(m_SkyboxVao);
             
             // bind cubemap texture to unit 0
-            glActiveTexture(GL_TEXTURE0);
-            gl->setUniformSampler2D(0, "skybox");
+            gl->activeTexture(0);
+            gl->setUniformSampler2D(0, UNIFORM_SKYBOX);
             glBindTexture(GL_TEXTURE_CUBE_MAP, m_CubemapId);
             
             glDrawArrays(GL_TRIANGLES, 0, 36);
-            glBindVertexArray(0);
-            glDepthFunc(GL_LESS);
+            gl->depthFunc(GL_LESS);
         
         }
         
@@ -0,0 +1,316 @@
+//
+//  Terrain.cpp
+//  SDL-GLEW-App
+//
+
+#include <algorithm>
+
+#include "Terrain.h"
+
+namespace Fox {
+    
+    static const GLfloat LOD_DISTANCE = 2.5f * Terrain::CHUNK_SIZE; ///< distance where the first level change happens
+    
+    Terrain::Terrain(const HeightField& heightField) : m_DrawnChunks(0), m_DrawnTriangles(0) {
+        
+        GLint w = heightField.getWidth();
+        GLint h = heightField.getDepth();
+        
+        // terrain is rounded up to whole chunks, edge samples are repeated
+        m_ChunksX = (w + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        m_ChunksZ = (h + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        
+        const GLuint side = CHUNK_SIZE + 1;
+        
+        // bounding boxes use the same grid and height mapping as the vertex shader
+        for(GLuint cx = 0; cx < m_ChunksX; cx++){
+            for(GLuint cz = 0; cz < m_ChunksZ; cz++){
+                
+                Chunk chunk;
+                chunk.m_Level = 0;
+                
+                GLint x0 = std::min((GLint) (cx * CHUNK_SIZE), w);
+                GLint z0 = std::min((GLint) (cz * CHUNK_SIZE), h);
+                GLint x1 = std::min((GLint) (cx * CHUNK_SIZE + CHUNK_SIZE), w);
+                GLint z1 = std::min((GLint) (cz * CHUNK_SIZE + CHUNK_SIZE), h);
+                
+                GLfloat low = heightField.heightAt(x0, z0), high = low;
+                
+                for(GLint x = x0; x <= x1; x++){
+                    for(GLint z = z0; z <= z1; z++){
+                        GLfloat value = heightField.heightAt(x, z);
+                        low = std::min(low, value);
+                        high = std::max(high, value);
+                    }
+                }
+                
+                chunk.m_Min = glm::vec3(x0 - w/2, low, z0 - h/2);
+                chunk.m_Max = glm::vec3(x1 - w/2, high, z1 - h/2);
+                
+                m_Chunks.push_back(chunk);
+            }
+        }
+        
+        // heights in world units, sampled with texelFetch
+        m_HeightMap = new Texture;
+        m_HeightMap->m_Type = Texture::Displacement;
+        m_HeightMap->m_Loaded = true;
+        
+        glGenTextures(1, &m_HeightMap->m_Id);
+        glBindTexture(GL_TEXTURE_2D, m_HeightMap->m_Id);
+        
+        // heights go back to the luminance levels they were decoded from, one byte per sample
+        std::vector<GLubyte> luminance((size_t) w * h);
+        
+        for(size_t i = 0; i < luminance.size(); i++){
+            GLfloat level = (heightField.data()[i] - HeightField::HEIGHT_OFFSET) / HeightField::HEIGHT_SCALE * 255.0f;
+            luminance[i] = (GLubyte) std::max(0.0f, std::min(level + 0.5f, 255.0f));
+        }
+        
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, luminance.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        
+        glBindTexture(GL_TEXTURE_2D, 0);
+        
+        addTexture(m_HeightMap);
+        
+        // shared patch, the vertex shader displaces it for every chunk
+        std::vector<glm::vec2> vertices;
+        vertices.reserve(side * side);
+        
+        for(GLuint u = 0; u < side; u++){
+            for(GLuint v = 0; v < side; v++){
+                vertices.push_back(glm::vec2((GLfloat) u, (GLfloat) v));
+            }
+        }
+        
+        std::vector<GLushort> indices;
+        buildPatterns(indices);
+        
+        // generate vertex and index buffer objects
+        glGenBuffers(1, &m_Vbo);
+        glGenBuffers(1, &m_Ibo);
+        
+        // create vertex array object
+        glGenVertexArrays(1, &m_Vao);
+        
+        glBindVertexArray(m_Vao);
+        
+        glBindBuffer(GL_ARRAY_BUFFER, m_Vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Ibo);
+        
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2) * vertices.size(), (const GLvoid*) vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * indices.size(), (const GLvoid*) indices.data(), GL_STATIC_DRAW);
+        
+        glVertexAttribPointer(0, 2, GL_FLOAT, false, sizeof(glm::vec2), (GLvoid*) 0);
+        glEnableVertexAttribArray(0);
+        
+        glBindVertexArray(0);
+    }
+    
+    void Terrain::buildPatterns(std::vector<GLushort>& indices) {
+        
+        const GLuint side = CHUNK_SIZE + 1;
+        
+        for(GLuint level = 0; level < LOD_LEVELS; level++){
+            
+            GLuint step = 1 << level;
+            GLuint coarse = 2 * step;
+            
+            for(GLuint mask = 0; mask < NUM_MASKS; mask++){
+                
+                // there is no coarser neighbor for the coarsest level
+                GLuint stitched = level + 1 < LOD_LEVELS ? mask : 0;
+                
+                m_PatternOffset[level][mask] = (GLuint) indices.size();
+                
+                // vertices on stitched sides collapse onto the vertices of the coarser neighbor
+                auto index = [&](GLuint u, GLuint v) -> GLushort {
+                    
+                    if(((stitched & NEGATIVE_X) && u == 0) || ((stitched & POSITIVE_X) && u == CHUNK_SIZE))
+                        v = v / coarse * coarse;
+                    
+                    if(((stitched & NEGATIVE_Z) && v == 0) || ((stitched & POSITIVE_Z) && v == CHUNK_SIZE))
+                        u = u / coarse * coarse;
+                    
+                    return (GLushort) (u * side + v);
+                };
+                
+                // adds a triangle unless it collapsed
+                auto triangle = [&](GLushort a, GLushort b, GLushort c) {
+                    
+                    if(a == b || b == c || a == c)
+                        return;
+                    
+                    indices.push_back(a);
+                    indices.push_back(b);
+                    indices.push_back(c);
+                };
+                
+                for(GLuint i = 0; i < CHUNK_SIZE; i += step){
+                    for(GLuint j = 0; j < CHUNK_SIZE; j += step){
+                        
+                        // same winding as getPlaneIndices
+                        triangle(index(i, j), index(i + step, j + step), index(i + step, j));
+                        triangle(index(i, j), index(i, j + step), index(i + step, j + step));
+                    }
+                }
+                
+                m_PatternCount[level][mask] = (GLuint) indices.size() - m_PatternOffset[level][mask];
+                
+                // row order leaves little in the vertex cache, every chunk draws one of these patterns
+                MeshOptimizer::optimizeVertexCache(indices.data() + m_PatternOffset[level][mask], m_PatternCount[level][mask], side * side);
+            }
+        }
+    }
+    
+    void Terrain::selectLevels(const glm::vec3& eye) {
+        
+        // level by distance to the closest point of the chunk
+        for(Chunk& chunk : m_Chunks){
+            
+            GLfloat distance = glm::length(glm::clamp(eye, chunk.m_Min, chunk.m_Max) - eye);
+            
+            GLuint level = 0;
+            GLfloat limit = LOD_DISTANCE;
+            
+            while(distance > limit && level + 1 < LOD_LEVELS){
+                level++;
+                limit *= 2.0f;
+            }
+            
+            chunk.m_Level = level;
+        }
+        
+        // restrict neighbors to one level difference so that stitching one level is enough
+        bool changed = true;
+        
+        while(changed){
+            
+            changed = false;
+            
+            for(GLint x = 0; x < (GLint) m_ChunksX; x++){
+                for(GLint z = 0; z < (GLint) m_ChunksZ; z++){
+                    
+                    Chunk& chunk = m_Chunks[x * m_ChunksZ + z];
+                    
+                    GLuint finest = std::min(std::min(levelAt(x - 1, z), levelAt(x + 1, z)), std::min(levelAt(x, z - 1), levelAt(x, z + 1)));
+                    
+                    if(chunk.m_Level > finest + 1){
+                        chunk.m_Level = finest + 1;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+    
+    void Terrain::drawChunk(GLContext* gl, GLint x, GLint z) {
+        
+        const Chunk& chunk = m_Chunks[x * m_ChunksZ + z];
+        
+        // stitch sides facing a coarser neighbor
+        GLuint mask = 0;
+        
+        if(x > 0 && levelAt(x - 1, z) > chunk.m_Level) mask |= NEGATIVE_X;
+        if(x + 1 < (GLint) m_ChunksX && levelAt(x + 1, z) > chunk.m_Level) mask |= POSITIVE_X;
+        if(z > 0 && levelAt(x, z - 1) > chunk.m_Level) mask |= NEGATIVE_Z;
+        if(z + 1 < (GLint) m_ChunksZ && levelAt(x, z + 1) > chunk.m_Level) mask |= POSITIVE_Z;
+        
+        GLuint count = m_PatternCount[chunk.m_Level][mask];
+        GLuint offset = m_PatternOffset[chunk.m_Level][mask];
+        
+        gl->setVec2(glm::vec2((GLfloat) (x * CHUNK_SIZE), (GLfloat) (z * CHUNK_SIZE)), UNIFORM_CHUNK_OFFSET);
+        
+        glDrawElements(GL_TRIANGLES, (GLsizei) count, GL_UNSIGNED_SHORT, (GLvoid*) (offset * sizeof(GLushort)));
+        
+        m_DrawnChunks++;
+        m_DrawnTriangles += count / 3;
+    }
+    
+    void Terrain::drawChunks(GLContext* gl, const Frustum* frustum) {
+        
+        m_DrawnChunks = 0;
+        m_DrawnTriangles = 0;
+        
+        gl->bindVertexArray(m_Vao);
+        
+        for(GLint x = 0; x < (GLint) m_ChunksX; x++){
+            for(GLint z = 0; z < (GLint) m_ChunksZ; z++){
+                
+                const Chunk& chunk = m_Chunks[x * m_ChunksZ + z];
+                
+                if(frustum != nullptr && frustum->classifyBox(chunk.m_Min, chunk.m_Max) == Frustum::OUTSIDE)
+                    continue;
+                
+                drawChunk(gl, x, z);
+            }
+        }
+    }
+    
+    void Terrain::submit(RenderQueue& queue, GLuint shader, const glm::vec3& eye, const Frustum* frustum) {
+        
+        m_DrawnChunks = 0;
+        m_DrawnTriangles = 0;
+        
+        selectLevels(eye);
+        
+        for(GLuint i = 0; i < m_Chunks.size(); i++){
+            
+            const Chunk& chunk = m_Chunks[i];
+            
+            if(frustum != nullptr && frustum->classifyBox(chunk.m_Min, chunk.m_Max) == Frustum::OUTSIDE)
+                continue;
+            
+            queue.submit(shader, this, i, (chunk.m_Min + chunk.m_Max) * 0.5f);
+        }
+    }
+    
+    void Terrain::drawGeometry(GLContext* gl, GLuint data) {
+        drawChunk(gl, (GLint) (data / m_ChunksZ), (GLint) (data % m_ChunksZ));
+    }
+    
+    void Terrain::draw(GLContext* gl) {
+        
+        RenderContext& rc = gl->getCurrentRenderContext();
+        
+        // bind all existing textures, including the height map
+        bindMaterial(gl);
+        
+        selectLevels(rc.m_Camera.m_Position);
+        drawChunks(gl, &rc.m_Frustum);
+    }
+    
+    void Terrain::drawToDepthBuffer(GLContext* gl) {
+        drawToDepthBuffer(gl, nullptr);
+    }
+    
+    void Terrain::drawToDepthBuffer(GLContext* gl, const Frustum& frustum) {
+        drawToDepthBuffer(gl, &frustum);
+    }
+    
+    void Terrain::drawToDepthBuffer(GLContext* gl, const Frustum* frustum) {
+        
+        GLuint unit = (GLuint) Texture::Displacement;
+        gl->bindTexture(m_HeightMap->m_Id, GL_TEXTURE0 + unit, textureToUniform[unit], unit);
+        
+        selectLevels(gl->getCurrentRenderContext().m_Camera.m_Position);
+        drawChunks(gl, frustum);
+    }
+    
+    void Terrain::drawWireframe(GLContext* gl) {
+        // enable wireframe mode
+        gl->polygonMode(GL_LINE);
+        
+        draw(gl);
+        
+        // disable wireframe mode
+        gl->polygonMode(GL_FILL);
+    }
+}
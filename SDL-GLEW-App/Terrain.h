@@ -0,0 +1,191 @@
+//
+//  Terrain.h
+//  SDL-GLEW-App
+//
+
+#ifndef Terrain_h
+#define Terrain_h
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "GLContext.h"
+#include "Mesh.h"
+#include "Frustum.h"
+#include "HeightField.h"
+
+namespace Fox {
+    
+    /**
+     * Height map terrain split into square chunks. Chunks are frustum culled and drawn with
+     * geomipmapping: the level of detail halves with distance and edges facing a coarser
+     * neighbor are stitched to the neighbor's vertices so that no cracks appear.
+     * Every chunk draws the same grid patch, which the vertex shader displaces by sampling
+     * the height map texture, so the only per sample storage on the GPU is one byte of the texture
+     */
+    class Terrain : public MeshBase {
+        
+    public:
+        
+        static const GLuint CHUNK_SIZE = 40; ///< quads per chunk side, divisible by the coarsest step
+        static const GLuint LOD_LEVELS = 4; ///< vertex steps 1, 2, 4 and 8
+        static const GLuint NUM_MASKS = 16; ///< combinations of stitched sides
+        
+        /**
+         * Chunk sides, used as bits telling which sides are stitched to a coarser neighbor
+         */
+        enum Side {
+            NEGATIVE_X = 1,
+            POSITIVE_X = 2,
+            NEGATIVE_Z = 4,
+            POSITIVE_Z = 8
+        };
+        
+        Terrain() : m_ChunksX(0), m_ChunksZ(0), m_DrawnChunks(0), m_DrawnTriangles(0), m_HeightMap(nullptr) {}
+        
+        /**
+         * Creates a terrain over a height field, one grid point per sample
+         *
+         * @param heightField Heights of the terrain
+         */
+        Terrain(const HeightField& heightField);
+        
+        /**
+         * Draws visible chunks using camera and world space frustum of the current render context.
+         * Current shader must displace the patch with heightMap and chunkOffset uniforms
+         *
+         * @param gl GLContext
+         */
+        void draw(GLContext* gl);
+        
+        /**
+         * Draws all chunks to the depth buffer, detail is chosen by the camera of the current render context
+         *
+         * @param gl GLContext
+         */
+        void drawToDepthBuffer(GLContext* gl);
+        
+        /**
+         * Draws chunks inside a frustum to the depth buffer, detail is chosen by the camera of the current render context
+         *
+         * @param gl GLContext
+         * @param frustum World space frustum, e.g. frustum of the light
+         */
+        void drawToDepthBuffer(GLContext* gl, const Frustum& frustum);
+        
+        void drawWireframe(GLContext* gl);
+        
+        /**
+         * Submits visible chunks to a render queue, one packet per chunk
+         *
+         * @param queue Render queue
+         * @param shader Shader index in GLContext
+         * @param eye Camera position choosing the level of detail
+         * @param frustum World space frustum, nullptr to submit all chunks
+         */
+        void submit(RenderQueue& queue, GLuint shader, const glm::vec3& eye, const Frustum* frustum);
+        
+        GLuint getVertexArray() const {
+            return m_Vao;
+        }
+        
+        /**
+         * Draws one chunk, data is the chunk index
+         */
+        void drawGeometry(GLContext* gl, GLuint data);
+        
+        /**
+         * Returns number of chunks drawn by the latest draw
+         */
+        inline GLuint getDrawnChunks() const {
+            return m_DrawnChunks;
+        }
+        
+        /**
+         * Returns number of triangles drawn by the latest draw
+         */
+        inline GLuint getDrawnTriangles() const {
+            return m_DrawnTriangles;
+        }
+        
+    private:
+        
+        /**
+         * Square piece of the terrain
+         */
+        class Chunk {
+        public:
+            glm::vec3 m_Min; ///< minimum corner of the bounding box
+            glm::vec3 m_Max; ///< maximum corner of the bounding box
+            GLuint m_Level; ///< level of detail of the current frame
+        };
+        
+        /**
+         * Draws chunks inside a frustum to the depth buffer
+         *
+         * @param gl GLContext
+         * @param frustum Frustum for culling, nullptr to draw all chunks
+         */
+        void drawToDepthBuffer(GLContext* gl, const Frustum* frustum);
+        
+        /**
+         * Generates index patterns shared by every chunk for each level and stitch combination
+         *
+         * @param indices Receives all patterns
+         */
+        void buildPatterns(std::vector<GLushort>& indices);
+        
+        /**
+         * Chooses level of detail of every chunk, neighbors differ by one level at most
+         *
+         * @param eye Camera position
+         */
+        void selectLevels(const glm::vec3& eye);
+        
+        /**
+         * Draws chunks with the levels chosen by selectLevels, the height map must be bound
+         *
+         * @param gl GLContext
+         * @param frustum Frustum for culling, nullptr to draw all chunks
+         */
+        void drawChunks(GLContext* gl, const Frustum* frustum);
+        
+        /**
+         * Draws one chunk with the level chosen by selectLevels, the vertex array must be bound
+         *
+         * @param gl GLContext
+         * @param x Chunk x coordinate
+         * @param z Chunk z coordinate
+         */
+        void drawChunk(GLContext* gl, GLint x, GLint z);
+        
+        /**
+         * Returns level of chunk at given chunk coordinates, or the coarsest level outside the terrain
+         */
+        inline GLuint levelAt(GLint x, GLint z) const {
+            if(x < 0 || z < 0 || x >= (GLint) m_ChunksX || z >= (GLint) m_ChunksZ)
+                return LOD_LEVELS - 1;
+            return m_Chunks[x * m_ChunksZ + z].m_Level;
+        }
+        
+        std::vector<Chunk> m_Chunks; ///< chunks, x major
+        GLuint m_ChunksX, m_ChunksZ; ///< number of chunks along x and z
+        
+        GLuint m_PatternOffset[LOD_LEVELS][NUM_MASKS]; ///< first index of each pattern
+        GLuint m_PatternCount[LOD_LEVELS][NUM_MASKS]; ///< number of indices of each pattern
+        
+        GLuint m_DrawnChunks; ///< statistics of the latest draw
+        GLuint m_DrawnTriangles; ///< statistics of the latest draw
+        
+        Texture* m_HeightMap; ///< height map, bound with the material as the displacement texture
+        
+        GLuint m_Vao; ///< vertex array id
+        GLuint m_Vbo; ///< vertex buffer object of the shared patch
+        GLuint m_Ibo; ///< index buffer object
+    };
+}
+
+#endif /* Terrain_h */
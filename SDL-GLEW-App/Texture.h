@@ -33,7 +33,7 @@ namespace Fox {
             TextureType_Max
         };
         
-        Texture(){}
+        Texture() : m_Id(0), m_Loaded(false) {}
         
         /**
          * Destroy loaded texture
@@ -63,31 +63,41 @@ namespace Fox {
         }
         
         /**
-         * Loads the texture from file path
+         * Decodes an image to 32-bit BGRA pixels in memory. Does not touch GL, may be called from any thread
          *
          * @param filePath File path
+         * @param hasAlpha Set to true if the source image has an alpha channel
+         * @return decoded image or nullptr, free with freeTexture
          */
-        void load(const GLchar* filePath) {
-        
-            SDL_Surface* image;
+        static SDL_Surface* decode(const GLchar* filePath, GLboolean& hasAlpha){
             
-            // load image from file
-            image = IMG_Load(filePath);
+            SDL_Surface* image = readTexture(filePath);
             
-            // if image loading failed
-            if(!image) {
-                std::cout << "IMG_Load: " << IMG_GetError() << std::endl;
+            if(!image)
+                return nullptr;
+            
+            hasAlpha = image->format->BytesPerPixel == 4;
+            
+            // ARGB8888 is BGRA in memory, matches GL_BGRA upload
+            if(image->format->format != SDL_PIXELFORMAT_ARGB8888){
+                SDL_Surface* converted = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0);
+                SDL_FreeSurface(image);
+                image = converted;
             }
             
-            // create texture
-            glGenTextures(1, &m_Id);
-            glBindTexture(GL_TEXTURE_2D, m_Id);
+            return image;
+        }
+        
+        /**
+         * Creates the texture object with a single texel placeholder until the image is uploaded
+         */
+        void create() {
             
-            GLint mode = GL_RGB;
+            // grey placeholder
+            static const GLubyte placeholder[4] = {128, 128, 128, 255};
             
-            if(image->format->BytesPerPixel == 4) {
-                mode = GL_RGBA;
-            }
+            glGenTextures(1, &m_Id);
+            glBindTexture(GL_TEXTURE_2D, m_Id);
             
             // set parameters
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -96,14 +106,58 @@ namespace Fox {
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
             
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_BGRA, GL_UNSIGNED_BYTE, placeholder);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            
+            glBindTexture(GL_TEXTURE_2D, 0);
+            
+            m_Loaded = false;
+        }
+        
+        /**
+         * Replaces the texture image with decoded pixels and generates mipmaps
+         *
+         * @param width Image width
+         * @param height Image height
+         * @param hasAlpha Whether to keep the alpha channel
+         * @param pixels BGRA pixels, or an offset into the bound pixel unpack buffer
+         */
+        void upload(GLint width, GLint height, GLboolean hasAlpha, const GLvoid* pixels) {
+            
+            glBindTexture(GL_TEXTURE_2D, m_Id);
+            
             // note BGRA instead of RGBA
-            glTexImage2D(GL_TEXTURE_2D, 0, mode, image->w, image->h, 0, GL_BGRA, GL_UNSIGNED_BYTE, image->pixels);
+            glTexImage2D(GL_TEXTURE_2D, 0, hasAlpha ? GL_RGBA : GL_RGB, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
             
             // generate mipmaps
             glGenerateMipmap(GL_TEXTURE_2D);
             
-          //  SDL_FreeSurface(image);
             glBindTexture(GL_TEXTURE_2D, 0);
+            
+            m_Loaded = true;
+        }
+        
+        /**
+         * Loads the texture from file path
+         *
+         * @param filePath File path
+         */
+        void load(const GLchar* filePath) {
+            
+            create();
+            
+            GLboolean hasAlpha;
+            SDL_Surface* image = decode(filePath, hasAlpha);
+            
+            // keep the placeholder if image loading failed
+            if(!image)
+                return;
+            
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, image->pitch / 4);
+            upload(image->w, image->h, hasAlpha, image->pixels);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            
+            SDL_FreeSurface(image);
         }
         
         /**
@@ -111,7 +165,7 @@ namespace Fox {
          *
          * @param filePath File path to texture file
          */
-        Texture(const GLchar* filePath) {
+        Texture(const GLchar* filePath) : m_Id(0), m_Loaded(false) {
             
             load(filePath);
            // std::cout << "load " << m_Id << std::endl;
@@ -119,6 +173,7 @@ namespace Fox {
         
         GLuint m_Id; ///< texture id
         TextureType m_Type; ///< texture type
+        GLboolean m_Loaded; ///< false while the placeholder is shown
     };
 }
 
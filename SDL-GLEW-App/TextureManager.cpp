@@ -6,10 +6,186 @@
 //  Copyright © 2017 Olli Kettunen. All rights reserved.
 //
 
+#include <chrono>
+#include <cstring>
+
 #include "TextureManager.h"
 
 namespace Fox {
 
 TextureManager* TextureManager::m_Singleton = nullptr;
+    
+    void TextureManager::requestDecode(Texture* texture, const std::string& filePath) {
+        
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            
+            DecodeRequest request;
+            request.m_Texture = texture;
+            request.m_FilePath = filePath;
+            
+            m_Requests.push_back(request);
+            m_Pending++;
+        }
+        
+        m_RequestCondition.notify_one();
+        
+        // start the decoding threads on first use, leave one core for the render thread
+        if(m_Workers.empty()){
+            
+            GLuint workers = std::thread::hardware_concurrency();
+            workers = workers > 1 ? workers - 1 : 1;
+            workers = workers < MAX_WORKERS ? workers : MAX_WORKERS;
+            
+            for(GLuint i = 0; i < workers; i++){
+                m_Workers.push_back(std::thread(&TextureManager::decodeLoop, this));
+            }
+        }
+    }
+    
+    void TextureManager::decodeLoop() {
+        
+        while(true){
+            
+            DecodeRequest request;
+            
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_RequestCondition.wait(lock, [this]{ return m_Stop || !m_Requests.empty(); });
+                
+                if(m_Stop)
+                    return;
+                
+                request = m_Requests.front();
+                m_Requests.pop_front();
+            }
+            
+            DecodedImage decoded;
+            decoded.m_Texture = request.m_Texture;
+            decoded.m_HasAlpha = false;
+            decoded.m_Image = Texture::decode(request.m_FilePath.c_str(), decoded.m_HasAlpha);
+            
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Decoded.push_back(decoded);
+            }
+            
+            m_DecodedCondition.notify_all();
+        }
+    }
+    
+    void TextureManager::stopWorkers() {
+        
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        
+        m_RequestCondition.notify_all();
+        
+        for(std::thread& worker : m_Workers){
+            worker.join();
+        }
+        
+        m_Workers.clear();
+        
+        for(DecodedImage& decoded : m_Decoded){
+            if(decoded.m_Image != nullptr){
+                Texture::freeTexture(decoded.m_Image);
+            }
+        }
+        
+        m_Decoded.clear();
+        m_Requests.clear();
+        m_Pending = 0;
+        
+        if(m_UploadBuffers[0] != 0){
+            glDeleteBuffers(NUM_UPLOAD_BUFFERS, m_UploadBuffers);
+        }
+    }
+    
+    void TextureManager::uploadImage(const DecodedImage& decoded) {
+        
+        // failed images keep the placeholder
+        if(decoded.m_Image == nullptr)
+            return;
+        
+        SDL_Surface* image = decoded.m_Image;
+        GLsizeiptr size = (GLsizeiptr) image->pitch * image->h;
+        
+        if(m_UploadBuffers[0] == 0){
+            glGenBuffers(NUM_UPLOAD_BUFFERS, m_UploadBuffers);
+        }
+        
+        // use buffers in turns so that filling one does not wait for the transfer from the other
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_UploadBuffers[m_NextUploadBuffer]);
+        m_NextUploadBuffer = (m_NextUploadBuffer + 1) % NUM_UPLOAD_BUFFERS;
+        
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        GLvoid* pixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        
+        if(pixels != nullptr){
+            
+            std::memcpy(pixels, image->pixels, (size_t) size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            
+            // source is the bound buffer, the transfer continues after this returns
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, image->pitch / 4);
+            decoded.m_Texture->upload(image->w, image->h, decoded.m_HasAlpha, (const GLvoid*) 0);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        }
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        
+        Texture::freeTexture(image);
+    }
+    
+    void TextureManager::update(GLfloat budget) {
+        
+        auto start = std::chrono::steady_clock::now();
+        
+        while(true){
+            
+            DecodedImage decoded;
+            
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                
+                if(m_Decoded.empty())
+                    return;
+                
+                decoded = m_Decoded.front();
+                m_Decoded.pop_front();
+            }
+            
+            uploadImage(decoded);
+            
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Pending--;
+            }
+            
+            if(std::chrono::duration<GLfloat, std::milli>(std::chrono::steady_clock::now() - start).count() > budget)
+                return;
+        }
+    }
+    
+    void TextureManager::finish() {
+        
+        while(true){
+            
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                
+                if(m_Pending == 0)
+                    return;
+                
+                m_DecodedCondition.wait(lock, [this]{ return !m_Decoded.empty(); });
+            }
+            
+            // no time limit
+            update(1e9f);
+        }
+    }
 
 }
@@ -12,21 +12,37 @@
 #include <GL/glew.h>
 
 #include <unordered_map>
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "Texture.h"
 
 namespace Fox {
     
     /**
-     * Texture manager for texture handling
+     * Texture manager for texture handling. Images are decoded by a pool of background threads
+     * and uploaded through pixel buffer objects on the GL thread by update, textures show a
+     * placeholder until then
      */
 class TextureManager{
     
 public:
     
-    TextureManager(){}
+    static const GLuint NUM_UPLOAD_BUFFERS = 2; ///< pixel buffer objects used in turns
+    static const GLuint MAX_WORKERS = 4; ///< upper limit of decoding threads
+    
+    TextureManager() : m_Stop(false), m_Pending(0), m_NextUploadBuffer(0) {
+        for(GLuint i = 0; i < NUM_UPLOAD_BUFFERS; i++){
+            m_UploadBuffers[i] = 0;
+        }
+    }
     
     ~TextureManager(){
+        stopWorkers();
         freeAll();
     }
     
@@ -59,7 +75,8 @@ public:
     }
     
     /**
-     * Loads a texture of type type from filePath
+     * Loads a texture of type type from filePath. The image is decoded in the background,
+     * the returned texture shows a placeholder until update has uploaded it
      *
      * @param filePath file path to texture
      * @param type Texture type
@@ -72,9 +89,12 @@ public:
         // if texture has not been loaded yet, load it
         if(element == m_Textures.end()){
             
-            Texture* texture = new Texture(filePath);
+            Texture* texture = new Texture;
+            texture->create();
             texture->m_Type = type;
             m_Textures[filePath] = texture;
+            
+            requestDecode(texture, filePath);
             return texture;
         }
         
@@ -82,6 +102,26 @@ public:
         return element->second; //m_Textures.find(filePath)->second;//m_Textures[filePath];
     }
     
+    /**
+     * Uploads decoded images, call once per frame on the GL thread
+     *
+     * @param budget Milliseconds that may be spent on uploads, at least one image is uploaded
+     */
+    void update(GLfloat budget = 2.0f);
+    
+    /**
+     * Waits until all requested textures are decoded and uploads them
+     */
+    void finish();
+    
+    /**
+     * Returns number of textures still showing the placeholder
+     */
+    GLuint getPendingCount(){
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Pending;
+    }
+    
     /**
      * Accesses certain texture
      */
@@ -103,8 +143,60 @@ public:
     }
     
 private:
+    
+    /**
+     * Image waiting to be decoded
+     */
+    class DecodeRequest {
+    public:
+        Texture* m_Texture;
+        std::string m_FilePath;
+    };
+    
+    /**
+     * Decoded image waiting to be uploaded
+     */
+    class DecodedImage {
+    public:
+        Texture* m_Texture;
+        SDL_Surface* m_Image; ///< nullptr if decoding failed
+        GLboolean m_HasAlpha;
+    };
+    
+    /**
+     * Queues an image for the decoding threads, starts the threads on first use
+     */
+    void requestDecode(Texture* texture, const std::string& filePath);
+    
+    /**
+     * Decoding thread main loop
+     */
+    void decodeLoop();
+    
+    /**
+     * Stops and joins decoding threads, releases images that were not uploaded
+     */
+    void stopWorkers();
+    
+    /**
+     * Uploads one decoded image through a pixel buffer object
+     */
+    void uploadImage(const DecodedImage& decoded);
+    
     static TextureManager* m_Singleton; ///< texture manager
     
+    std::vector<std::thread> m_Workers; ///< decoding threads
+    std::mutex m_Mutex; ///< guards the queues and the pending count
+    std::condition_variable m_RequestCondition; ///< signals new requests or stop
+    std::condition_variable m_DecodedCondition; ///< signals decoded images
+    std::deque<DecodeRequest> m_Requests; ///< images to decode
+    std::deque<DecodedImage> m_Decoded; ///< images to upload
+    bool m_Stop; ///< tells the decoding threads to quit
+    GLuint m_Pending; ///< requested but not yet uploaded textures
+    
+    GLuint m_UploadBuffers[NUM_UPLOAD_BUFFERS]; ///< pixel unpack buffers
+    GLuint m_NextUploadBuffer; ///< next pixel unpack buffer to fill
+    
     //std::unordered_map<const GLchar*, Texture*> m_Textures; ///< all textures
     std::unordered_map<std::string, Texture*> m_Textures;
 };
@@ -0,0 +1,169 @@
+//
+//  UniformBuffer.h
+//  SDL-GLEW-App
+//
+
+#ifndef UniformBuffer_h
+#define UniformBuffer_h
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+
+namespace Fox {
+    
+    /**
+     * Fixed binding points of the uniform blocks shared by every shader program
+     */
+    enum UniformBinding {
+        FRAME_UNIFORMS_BINDING = 0,
+        LIGHT_UNIFORMS_BINDING = 1,
+        MATERIAL_UNIFORMS_BINDING = 2
+    };
+    
+    /**
+     * Camera and shadow data of a frame, layout of the FrameUniforms block (std140)
+     */
+    struct FrameUniforms {
+        glm::mat4 m_View; ///< view matrix
+        glm::mat4 m_Projection; ///< projection matrix
+        glm::mat4 m_LightSpaceMatrix; ///< projection * view of the shadow casting light
+        glm::vec3 m_ViewPos; ///< camera position
+        GLfloat m_Padding;
+    };
+    
+    /**
+     * Directional light, layout of the DirLight struct (std140)
+     */
+    struct DirLightUniforms {
+        glm::vec3 m_Direction;
+        GLfloat m_Padding0;
+        glm::vec3 m_Ambient;
+        GLfloat m_Padding1;
+        glm::vec3 m_Diffuse;
+        GLfloat m_Padding2;
+        glm::vec3 m_Specular;
+        GLfloat m_Padding3;
+    };
+    
+    /**
+     * Spot light, layout of the SpotLight struct (std140)
+     */
+    struct SpotLightUniforms {
+        glm::vec3 m_Position;
+        GLfloat m_Padding0;
+        glm::vec3 m_Direction;
+        GLfloat m_CutOff;
+        GLfloat m_OuterCutOff;
+        GLfloat m_Constant;
+        GLfloat m_Linear;
+        GLfloat m_Quadratic;
+        glm::vec3 m_Ambient;
+        GLfloat m_Padding1;
+        glm::vec3 m_Diffuse;
+        GLfloat m_Padding2;
+        glm::vec3 m_Specular;
+        GLfloat m_Padding3;
+    };
+    
+    /**
+     * Point light, layout of the PointLight struct (std140)
+     */
+    struct PointLightUniforms {
+        glm::vec3 m_Position;
+        GLfloat m_Constant;
+        GLfloat m_Linear;
+        GLfloat m_Quadratic;
+        GLfloat m_Padding0[2];
+        glm::vec3 m_Ambient;
+        GLfloat m_Padding1;
+        glm::vec3 m_Diffuse;
+        GLfloat m_Padding2;
+        glm::vec3 m_Specular;
+        GLfloat m_Padding3;
+    };
+    
+    static const GLuint MAX_POINT_LIGHTS = 4; ///< size of the point light array, MAX_POINT_LIGHTS in uber.frag
+    
+    /**
+     * Lights of a frame, layout of the LightUniforms block (std140). Shader variants only read the
+     * point lights they were compiled for
+     */
+    struct LightUniforms {
+        DirLightUniforms m_DirLight; ///< directional light
+        SpotLightUniforms m_SpotLight; ///< spot light
+        PointLightUniforms m_PointLights[MAX_POINT_LIGHTS]; ///< point lights
+    };
+    
+    /**
+     * Material constants, layout of the MaterialUniforms block (std140)
+     */
+    struct MaterialUniforms {
+        GLfloat m_Shininess; ///< specular exponent
+        GLfloat m_Padding[3];
+    };
+    
+    static_assert(sizeof(FrameUniforms) == 208, "FrameUniforms does not match std140 layout");
+    static_assert(sizeof(DirLightUniforms) == 64, "DirLightUniforms does not match std140 layout");
+    static_assert(sizeof(SpotLightUniforms) == 96, "SpotLightUniforms does not match std140 layout");
+    static_assert(sizeof(PointLightUniforms) == 80, "PointLightUniforms does not match std140 layout");
+    static_assert(sizeof(LightUniforms) == 480, "LightUniforms does not match std140 layout");
+    static_assert(sizeof(MaterialUniforms) == 16, "MaterialUniforms does not match std140 layout");
+    
+    /**
+     * Uniform buffer object attached to a fixed binding point
+     */
+    class UniformBuffer {
+    
+    public:
+        
+        UniformBuffer() : m_Id(0), m_Size(0), m_Binding(0) {}
+        
+        /**
+         * Creates the buffer and attaches all of it to a binding point
+         *
+         * @param size Size of the buffer in bytes
+         * @param binding Binding point of the uniform block
+         */
+        void create(GLsizeiptr size, GLuint binding){
+            
+            m_Size = size;
+            m_Binding = binding;
+            
+            glGenBuffers(1, &m_Id);
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Id);
+            glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            
+            glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_Id);
+        }
+        
+        /**
+         * Replaces the whole contents of the buffer, the previous storage is orphaned so that
+         * draws still reading it do not stall the upload
+         *
+         * @param data New contents, m_Size bytes
+         */
+        void update(const GLvoid* data){
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Id);
+            glBufferData(GL_UNIFORM_BUFFER, m_Size, NULL, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, m_Size, data);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        
+        /**
+         * Releases the buffer
+         */
+        void destroy(){
+            if(m_Id != 0)
+                glDeleteBuffers(1, &m_Id);
+            m_Id = 0;
+        }
+        
+        GLuint m_Id; ///< buffer id
+        GLsizeiptr m_Size; ///< size in bytes
+        GLuint m_Binding; ///< binding point
+    };
+}
+
+#endif /* UniformBuffer_h */
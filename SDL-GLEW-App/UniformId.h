@@ -0,0 +1,52 @@
+//
+//  UniformId.h
+//  SDL-GLEW-App
+//
+
+#ifndef UniformId_h
+#define UniformId_h
+
+#include <GL/glew.h>
+
+#include <cstdint>
+
+namespace Fox {
+    
+    typedef uint32_t UniformId; ///< FNV-1a hash of an uniform name
+    
+    static const UniformId NO_UNIFORM = 0; ///< marks an empty slot, no name hashes to it in practice
+    
+    /**
+     * Hashes an uniform name with 32 bit FNV-1a, evaluated by the compiler for constant names
+     *
+     * @param name Name of the uniform in shader
+     * @param hash Hash of the preceding characters
+     * @return identifier of the uniform
+     */
+    constexpr UniformId uniformId(const GLchar* name, UniformId hash = 2166136261u){
+        return *name == '\0' ? hash : uniformId(name + 1, (hash ^ (UniformId) (unsigned char) *name) * 16777619u);
+    }
+    
+    // uniforms set by the engine, plain uniforms only since block members are not set one by one
+    static constexpr UniformId UNIFORM_MODEL = uniformId("model");
+    static constexpr UniformId UNIFORM_VIEW = uniformId("view");
+    static constexpr UniformId UNIFORM_PROJECTION = uniformId("projection");
+    static constexpr UniformId UNIFORM_VIEW_POS = uniformId("viewPos");
+    static constexpr UniformId UNIFORM_MATERIAL_DIFFUSE = uniformId("material.diffuse");
+    static constexpr UniformId UNIFORM_MATERIAL_SPECULAR = uniformId("material.specular");
+    static constexpr UniformId UNIFORM_MATERIAL_NORMAL_MAP = uniformId("material.normalMap");
+    static constexpr UniformId UNIFORM_HEIGHT_MAP = uniformId("heightMap");
+    static constexpr UniformId UNIFORM_CHUNK_OFFSET = uniformId("chunkOffset");
+    static constexpr UniformId UNIFORM_SKYBOX = uniformId("skybox");
+    static constexpr UniformId UNIFORM_DEPTH_MAP = uniformId("depthMap");
+    static constexpr UniformId UNIFORM_SHADOW_MAP = uniformId("shadowMap");
+    static constexpr UniformId UNIFORM_FRUSTUM_PLANES = uniformId("frustumPlanes");
+    static constexpr UniformId UNIFORM_BOUNDING_SPHERE = uniformId("boundingSphere");
+    static constexpr UniformId UNIFORM_DEQUANTIZE = uniformId("dequantize");
+    static constexpr UniformId UNIFORM_INSTANCE_COUNT = uniformId("instanceCount");
+    static constexpr UniformId UNIFORM_OCCLUSION = uniformId("occlusion");
+    static constexpr UniformId UNIFORM_OCCLUSION_CLIP = uniformId("occlusionClip");
+    static constexpr UniformId UNIFORM_OCCLUSION_DEPTH = uniformId("occlusionDepth");
+}
+
+#endif /* UniformId_h */
@@ -9,6 +9,8 @@
 #ifndef Vertex_h
 #define Vertex_h
 
+#include <GL/glew.h>
+
 #include "glm/glm.hpp"
 
 namespace Fox {
@@ -98,7 +100,57 @@ namespace Fox {
     
     };
     
+    /**
+     * VertexPNT packed for the GPU, 16 bytes instead of 32. Position is normalized into the
+     * bounds of its mesh, see VertexQuantizer, the normal is octahedral encoded and the
+     * texture coordinates are half floats
+     */
+    class VertexQPNT {
+    public:
+        
+        GLshort m_Position[4]; ///< snorm16 position, w is padding
+        GLshort m_Normal[2]; ///< snorm16 octahedral normal
+        GLushort m_TexCoords[2]; ///< half float texture coordinates
+    };
+    
+    /**
+     * VertexPNTTB packed for the GPU, 20 bytes instead of 56. The bitangent is rebuilt from
+     * the normal and the tangent, only its handedness is kept in the w of the position
+     */
+    class VertexQPNTTB {
+    public:
+        
+        GLshort m_Position[4]; ///< snorm16 position, w is the bitangent sign
+        GLshort m_Normal[2]; ///< snorm16 octahedral normal
+        GLushort m_TexCoords[2]; ///< half float texture coordinates
+        GLshort m_Tangent[2]; ///< snorm16 octahedral tangent
+    };
+    
+    static_assert(sizeof(VertexQPNT) == 16, "VertexQPNT is not tightly packed");
+    static_assert(sizeof(VertexQPNTTB) == 20, "VertexQPNTTB is not tightly packed");
+    
     typedef VertexPNT Vertex;
+    
+    /**
+     * Compile time properties of a vertex format
+     */
+    template <class V> class VertexTraits {
+    public:
+        static const bool HAS_TANGENTS = false; ///< tangent at attribute 3, needed by normal mapping
+        static const bool IS_QUANTIZED = false; ///< uploaded by Mesh in its packed format, e.g. VertexQPNT
+    };
+    
+    template <> class VertexTraits<VertexPNT> {
+    public:
+        static const bool HAS_TANGENTS = false;
+        static const bool IS_QUANTIZED = true;
+    };
+    
+    template <> class VertexTraits<VertexPNTTB> {
+    public:
+        static const bool HAS_TANGENTS = true;
+        static const bool IS_QUANTIZED = true;
+    };
 }
 
 #endif /* Vertex_h */
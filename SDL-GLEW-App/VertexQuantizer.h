@@ -0,0 +1,200 @@
+//
+//  VertexQuantizer.h
+//  SDL-GLEW-App
+//
+
+#ifndef VertexQuantizer_h
+#define VertexQuantizer_h
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "Vertex.h"
+
+namespace Fox {
+    
+    /**
+     * Converts a float to a signed normalized 16 bit integer
+     *
+     * @param value Value in [-1, 1], clamped
+     */
+    static inline GLshort toSnorm16(GLfloat value){
+        value = std::max(-1.0f, std::min(1.0f, value));
+        return (GLshort) std::floor(value * 32767.0f + 0.5f);
+    }
+    
+    /**
+     * Converts a float to a half float, rounded to nearest. Values out of the half range
+     * become infinity
+     *
+     * @param value Value to convert
+     * @return bits of the half float
+     */
+    static inline GLushort toHalf(GLfloat value){
+        
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        
+        GLushort sign = (GLushort) ((bits >> 16) & 0x8000);
+        GLint exponent = (GLint) ((bits >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = bits & 0x7fffff;
+        
+        // infinity and nan
+        if(((bits >> 23) & 0xff) == 0xff)
+            return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+        
+        if(exponent >= 31)
+            return sign | 0x7c00;
+        
+        // denormal half, the implicit one of the float becomes explicit
+        if(exponent <= 0){
+            
+            if(exponent < -10)
+                return sign;
+            
+            mantissa |= 0x800000;
+            GLuint shift = (GLuint) (14 - exponent);
+            GLushort half = (GLushort) (mantissa >> shift);
+            
+            if((mantissa >> (shift - 1)) & 1)
+                half++;
+            
+            return sign | half;
+        }
+        
+        GLushort half = sign | (GLushort) (exponent << 10) | (GLushort) (mantissa >> 13);
+        
+        // a carry out of the mantissa correctly moves to the next exponent
+        if(mantissa & 0x1000)
+            half++;
+        
+        return half;
+    }
+    
+    /**
+     * Maps a unit vector onto the octahedron and unfolds it into a square, two components
+     * are enough for a direction. The inverse is octDecode in uber.vert
+     *
+     * @param direction Unit vector
+     * @param encoded Two snorm16 components
+     */
+    static inline void octEncode(const glm::vec3& direction, GLshort* encoded){
+        
+        GLfloat length = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+        
+        if(length == 0.0f){
+            encoded[0] = 0;
+            encoded[1] = 0;
+            return;
+        }
+        
+        GLfloat x = direction.x / length;
+        GLfloat y = direction.y / length;
+        
+        // fold the lower half over the diagonals
+        if(direction.z < 0.0f){
+            GLfloat foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            GLfloat foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldedX;
+            y = foldedY;
+        }
+        
+        encoded[0] = toSnorm16(x);
+        encoded[1] = toSnorm16(y);
+    }
+    
+    /**
+     * Packs float vertices of one mesh into 16 bit formats. Positions are normalized into
+     * the bounding box of the mesh with one scale for all axes, so the dequantization is a
+     * uniform scale that leaves the normal matrix valid
+     */
+    class VertexQuantizer {
+    
+    public:
+        
+        /**
+         * Computes the bounds of the vertices, each vertex must start with its position
+         *
+         * @param vertices Vertices of the mesh
+         * @param count Number of vertices
+         */
+        template <class V> VertexQuantizer(const V* vertices, GLuint count) : m_Center(0.0f), m_Extent(1.0f) {
+            
+            if(count == 0)
+                return;
+            
+            glm::vec3 min = vertices[0].m_Position;
+            glm::vec3 max = vertices[0].m_Position;
+            
+            for(GLuint i = 1; i < count; i++){
+                const glm::vec3& p = vertices[i].m_Position;
+                min = glm::vec3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+                max = glm::vec3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+            }
+            
+            m_Center = (min + max) * 0.5f;
+            
+            glm::vec3 half = (max - min) * 0.5f;
+            m_Extent = std::max(half.x, std::max(half.y, half.z));
+            
+            if(m_Extent <= 0.0f)
+                m_Extent = 1.0f;
+        }
+        
+        /**
+         * Returns the matrix taking quantized positions back to object space, to be applied
+         * before the model matrix
+         */
+        glm::mat4 getDequantization() const {
+            return glm::scale(glm::translate(glm::mat4(), m_Center), glm::vec3(m_Extent));
+        }
+        
+        VertexQPNT quantize(const VertexPNT& vertex) const {
+            
+            VertexQPNT packed;
+            quantizePosition(vertex.m_Position, packed.m_Position);
+            packed.m_Position[3] = 0;
+            octEncode(vertex.m_Normal, packed.m_Normal);
+            packed.m_TexCoords[0] = toHalf(vertex.m_TexCoords.x);
+            packed.m_TexCoords[1] = toHalf(vertex.m_TexCoords.y);
+            
+            return packed;
+        }
+        
+        VertexQPNTTB quantize(const VertexPNTTB& vertex) const {
+            
+            VertexQPNTTB packed;
+            quantizePosition(vertex.m_Position, packed.m_Position);
+            octEncode(vertex.m_Normal, packed.m_Normal);
+            octEncode(vertex.m_Tangent, packed.m_Tangent);
+            packed.m_TexCoords[0] = toHalf(vertex.m_TexCoords.x);
+            packed.m_TexCoords[1] = toHalf(vertex.m_TexCoords.y);
+            
+            // the shader rebuilds the bitangent as cross(N, T), mirrored uv keep their side
+            GLfloat handedness = glm::dot(glm::cross(vertex.m_Normal, vertex.m_Tangent), vertex.m_Bitangent);
+            packed.m_Position[3] = handedness < 0.0f ? -32767 : 32767;
+            
+            return packed;
+        }
+        
+        glm::vec3 m_Center; ///< center of the bounding box
+        GLfloat m_Extent; ///< half of the longest side of the bounding box
+    
+    private:
+        
+        void quantizePosition(const glm::vec3& position, GLshort* packed) const {
+            glm::vec3 normalized = (position - m_Center) / m_Extent;
+            packed[0] = toSnorm16(normalized.x);
+            packed[1] = toSnorm16(normalized.y);
+            packed[2] = toSnorm16(normalized.z);
+        }
+    };
+}
+
+#endif /* VertexQuantizer_h */
@@ -1,11 +0,0 @@
-#version 330 core
-
-out vec4 color;
-
-uniform vec3 objectColor;
-uniform vec3 lightColor;
-
-void main()
-{
-    color = vec4(lightColor * objectColor, 1.0f);
-}
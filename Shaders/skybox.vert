@@ -3,13 +3,19 @@
 layout (location = 0) in vec3 position;
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+// camera and shadow data shared by all shaders
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 lightSpaceMatrix;
+    vec3 viewPos;
+};
 
 
 void main()
 {
-    vec4 pos = projection * view * vec4(position, 1.0);
+    // remove translation component from view matrix
+    vec4 pos = projection * mat4(mat3(view)) * vec4(position, 1.0);
     gl_Position = pos.xyww;
     TexCoords = position;
 }
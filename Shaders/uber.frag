@@ -1,10 +1,32 @@
-#version 330 core
+// #version and the feature defines are prepended by ShaderVariants
+//
+// NORMAL_MAP       normal from the tangent space normal map
+// SPOT_LIGHT       adds the spot light
+// NR_POINT_LIGHTS  number of point lights to add, up to MAX_POINT_LIGHTS
+// SHADOWS          directional light is shadowed by the shadow map
+// DEPTH_ONLY       writes depth only
+
+#ifdef DEPTH_ONLY
+
+void main()
+{
+}
+
+#else
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 0
+#endif
+
+// size of the point light array in LightUniforms, matches MAX_POINT_LIGHTS in UniformBuffer.h
+#define MAX_POINT_LIGHTS 4
 
 struct Material {
     sampler2D diffuse;
     sampler2D specular;
+#ifdef NORMAL_MAP
     sampler2D normalMap;
-    float shininess;
+#endif
 };
 
 struct DirLight {
@@ -42,46 +64,77 @@ struct SpotLight {
     vec3 specular;
 };
 
-#define NR_POINT_LIGHTS 0
-
 in vec3 FragPosition;
 in vec3 Normal;
 in vec2 TexCoords;
+#ifdef NORMAL_MAP
 in mat3 TBN;
+#endif
+#ifdef SHADOWS
+in vec4 FragPositionLightSpace;
+#endif
 
 out vec4 color;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-//uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
+// camera and shadow data shared by all shaders
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 lightSpaceMatrix;
+    vec3 viewPos;
+};
+
+// lights of the frame, always declared in full so that the layout is the same in every variant
+layout (std140) uniform LightUniforms {
+    DirLight dirLight;
+    SpotLight spotLight;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
+
+// material constants, the samplers stay plain uniforms
+layout (std140) uniform MaterialUniforms {
+    float shininess;
+};
+
 uniform Material material;
 
+#ifdef SHADOWS
+uniform sampler2D shadowMap;
+#endif
+
 // Function prototypes
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+float CalcShadow(vec3 normal);
 
 void main()
 {
+#ifdef NORMAL_MAP
     // sample normal map
     vec3 norm = texture(material.normalMap, TexCoords).rgb;
     
     // transform sampled normal to range [-1, 1]
-    norm = normalize(norm * 2.0 - vec3(1.0f, 1.0f, 1.0f));//1.0);
+    norm = normalize(norm * 2.0 - vec3(1.0f, 1.0f, 1.0f));
     
     // transform normals from tangent space to world space
     norm = normalize(TBN * norm);
+#else
+    vec3 norm = normalize(Normal);
+#endif
     
-   // vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPosition);
     
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    
-    //  for(int i = 0; i < NR_POINT_LIGHTS; i++)
-    //      result += CalcPointLight(pointLights[i], norm, FragPosition, viewDir);
-    
-    //result += CalcSpotLight(spotLight, norm, FragPosition, viewDir);
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, CalcShadow(norm));
+
+#if NR_POINT_LIGHTS > 0
+    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+        result += CalcPointLight(pointLights[i], norm, FragPosition, viewDir);
+#endif
+
+#ifdef SPOT_LIGHT
+    result += CalcSpotLight(spotLight, norm, FragPosition, viewDir);
+#endif
     
     // gamma correction
     result = pow(result, vec3(1.0/2.2));
@@ -89,8 +142,29 @@ void main()
     color = vec4(result, 1.0);
 }
 
+// Returns 0 where the fragment is in the shadow of the directional light, 1 elsewhere
+float CalcShadow(vec3 normal)
+{
+#ifdef SHADOWS
+    // perspective divide and transform to range [0, 1]
+    vec3 projected = FragPositionLightSpace.xyz / FragPositionLightSpace.w * 0.5 + 0.5;
+    
+    // outside of the light frustum
+    if(projected.z > 1.0)
+        return 1.0;
+    
+    // slope scaled bias against shadow acne
+    float bias = max(0.005 * (1.0 - dot(normal, normalize(-dirLight.direction))), 0.0005);
+    float closest = texture(shadowMap, projected.xy).r;
+    
+    return projected.z - bias > closest ? 0.0 : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
 // Calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     const float Pi = 3.14159f;
     
@@ -99,18 +173,12 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     float diff = 1/Pi * max(dot(normal, lightDir), 0.0);
     // Specular shading (Blinn-Phong)
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = ( 8.0 + material.shininess ) / ( 8.0 * Pi ) * pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = ( 8.0 + shininess ) / ( 8.0 * Pi ) * pow(max(dot(normal, halfwayDir), 0.0), shininess);
     // Combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    return (ambient + diffuse + specular);
-    
-   //   return diffuse;
-    
-   // return vec3(texture(material.normalMap, TexCoords));
-   // return vec3(texture(material.diffuse, TexCoords));
-   // return vec3(texture(material.specular, TexCoords));
+    return (ambient + shadow * (diffuse + specular));
 }
 
 // Calculates the color when using a point light.
@@ -123,7 +191,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float diff = 1/Pi * max(dot(normal, lightDir), 0.0);
     // Specular shading (Blinn-Phong)
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = ( 8.0 + material.shininess ) / ( 8.0 * Pi ) * pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = ( 8.0 + shininess ) / ( 8.0 * Pi ) * pow(max(dot(normal, halfwayDir), 0.0), shininess);
     // Attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
@@ -147,7 +215,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float diff = 1/Pi * max(dot(normal, lightDir), 0.0);
     // Specular shading (Blinn-Phong)
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = ( 8.0 + material.shininess ) / ( 8.0 * Pi ) * pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = ( 8.0 + shininess ) / ( 8.0 * Pi ) * pow(max(dot(normal, halfwayDir), 0.0), shininess);
     // Attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
@@ -164,3 +232,5 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     specular *= attenuation * intensity;
     return (ambient + diffuse + specular);
 }
+
+#endif
@@ -0,0 +1,140 @@
+// #version and the feature defines are prepended by ShaderVariants
+//
+// TERRAIN      displaces the shared terrain patch with the height map
+// INSTANCED    model matrix comes from the instance buffer
+// NORMAL_MAP   tangent space for normal mapping, needs tangents in the vertices
+// SHADOWS      light space position for the shadow map lookup
+// DEPTH_ONLY   light space position only, for the shadow map pass
+// QUANTIZED    octahedral normals and tangents of packed vertices, the positions are
+//              normalized shorts that the model matrix takes back to object space
+
+#ifdef TERRAIN
+layout (location = 0) in vec2 position; // grid position inside the shared patch
+#else
+layout (location = 0) in vec3 position;
+#ifdef QUANTIZED
+layout (location = 1) in vec2 normal; // octahedral
+#else
+layout (location = 1) in vec3 normal;
+#endif
+layout (location = 2) in vec2 texCoords;
+#endif
+
+#ifdef NORMAL_MAP
+#ifdef QUANTIZED
+layout (location = 3) in vec2 tangent; // octahedral
+layout (location = 4) in float bitangentSign; // handedness of the uv mapping
+#else
+layout (location = 3) in vec3 tangent;
+#endif
+#endif
+
+#ifdef INSTANCED
+layout (location = 5) in mat4 instanceModel; // model matrix per instance, locations 5-8
+#elif !defined(TERRAIN)
+uniform mat4 model;
+#endif
+
+// camera and shadow data shared by all shaders
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    mat4 lightSpaceMatrix;
+    vec3 viewPos;
+};
+
+#ifdef TERRAIN
+uniform sampler2D heightMap; // luminance of the height map, one texel per grid point
+uniform vec2 chunkOffset; // grid position of the chunk corner
+
+// luminance to world units, HEIGHT_SCALE and HEIGHT_OFFSET of HeightField
+float sampleHeight(ivec2 texel, ivec2 size) {
+    float luminance = texelFetch(heightMap, clamp(texel, ivec2(0), size - 1), 0).r;
+    return luminance * 100.0f - 100.0f;
+}
+#endif
+
+#ifdef QUANTIZED
+// inverse of octEncode in VertexQuantizer.h
+vec3 octDecode(vec2 encoded) {
+    vec3 direction = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    if(direction.z < 0.0f) {
+        direction.xy = (1.0f - abs(direction.yx)) * vec2(direction.x >= 0.0f ? 1.0f : -1.0f, direction.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return normalize(direction);
+}
+#endif
+
+#ifndef DEPTH_ONLY
+out vec3 Normal; // normal in world position
+out vec3 FragPosition; // fragment position in world coordinates
+out vec2 TexCoords;
+#ifdef NORMAL_MAP
+out mat3 TBN;
+#endif
+#ifdef SHADOWS
+out vec4 FragPositionLightSpace;
+#endif
+#endif
+
+void main() {
+
+#ifdef TERRAIN
+    ivec2 size = textureSize(heightMap, 0);
+    ivec2 grid = min(ivec2(chunkOffset + position), size);
+    vec2 ground = vec2(grid - size / 2);
+    vec4 world = vec4(ground.x, sampleHeight(grid, size), ground.y, 1.0f);
+#else
+#ifdef INSTANCED
+    mat4 modelMatrix = instanceModel;
+#else
+    mat4 modelMatrix = model;
+#endif
+    vec4 world = modelMatrix * vec4(position, 1.0f);
+#endif
+
+#ifdef DEPTH_ONLY
+    gl_Position = lightSpaceMatrix * world;
+#else
+    gl_Position = projection * view * world;
+    FragPosition = vec3(world);
+
+#ifdef TERRAIN
+    // normal from central differences of the height map
+    float left = sampleHeight(grid - ivec2(1, 0), size);
+    float right = sampleHeight(grid + ivec2(1, 0), size);
+    float down = sampleHeight(grid - ivec2(0, 1), size);
+    float up = sampleHeight(grid + ivec2(0, 1), size);
+    
+    Normal = normalize(vec3(left - right, 2.0f, down - up));
+    TexCoords = ground + 5.0f;
+#else
+    mat3 normalMatrix = transpose(inverse(mat3(modelMatrix)));
+#ifdef QUANTIZED
+    Normal = normalize(normalMatrix * octDecode(normal));
+#else
+    Normal = normalize(normalMatrix * normal);
+#endif
+    TexCoords = texCoords;
+#endif
+
+#ifdef NORMAL_MAP
+    // Gram-Schmidt, then retrieve perpendicular vector B with the cross product of T and N
+#ifdef QUANTIZED
+    vec3 T = normalize(normalMatrix * octDecode(tangent));
+#else
+    vec3 T = normalize(normalMatrix * tangent);
+#endif
+    T = normalize(T - dot(T, Normal) * Normal);
+    vec3 B = cross(Normal, T);
+#ifdef QUANTIZED
+    B *= sign(bitangentSign);
+#endif
+    TBN = mat3(T, B, Normal);
+#endif
+
+#ifdef SHADOWS
+    FragPositionLightSpace = lightSpaceMatrix * world;
+#endif
+#endif
+}
@@ -0,0 +1,369 @@
+//
+//  OcclusionCullerTest.cpp
+//  SDL-GLEW-App
+//
+//  Checks OcclusionCuller against brute force references: the depth buffer against a ray cast
+//  of every pixel, isVisible against a scan of every pixel of the box and its hidden boxes
+//  against a ray march of the height field. Runs with one band and with several bands
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "OcclusionCuller.h"
+
+using namespace Fox;
+
+static const GLint FIELD_SIZE = 257; ///< samples on a side of the test height field
+static const GLfloat NEAR = 0.5f;
+static const GLfloat FAR = 1000.0f;
+static const GLuint VIEWS = 6;
+static const GLuint BOXES_PER_VIEW = 400;
+static const GLfloat DISTANCE_TOLERANCE = 1e-3f; ///< relative view distance error of a matching pixel
+static const GLfloat MAX_EDGE_PIXELS = 0.01f; ///< share of pixels allowed to match only a neighbour
+static const GLuint MARCH_STEPS = 1024; ///< samples of a ray march
+
+static GLuint failures = 0;
+
+static void check(bool condition, const char* message, GLuint view){
+    
+    if(!condition){
+        std::printf("FAILED view %u: %s\n", view, message);
+        failures++;
+    }
+}
+
+/**
+ * Rolling hills with ridges steep enough to hide boxes behind them
+ */
+static HeightField createField(){
+    
+    std::vector<GLfloat> heights(FIELD_SIZE * FIELD_SIZE);
+    
+    for(GLint z = 0; z < FIELD_SIZE; z++){
+        for(GLint x = 0; x < FIELD_SIZE; x++){
+            heights[z * FIELD_SIZE + x] = 25.0f * std::sin(x * 0.05f) * std::cos(z * 0.04f) + 8.0f * std::sin(x * 0.13f + z * 0.09f);
+        }
+    }
+    
+    return HeightField(FIELD_SIZE, FIELD_SIZE, heights);
+}
+
+/**
+ * Returns the height field surface at a world position, bilinear between samples
+ */
+static GLfloat surfaceHeight(const HeightField& field, GLfloat worldX, GLfloat worldZ){
+    
+    GLfloat x = worldX + field.getWidth() / 2, z = worldZ + field.getDepth() / 2;
+    GLint x0 = (GLint) std::floor(x), z0 = (GLint) std::floor(z);
+    GLfloat fx = x - x0, fz = z - z0;
+    
+    GLfloat near = field.heightAt(x0, z0) * (1.0f - fx) + field.heightAt(x0 + 1, z0) * fx;
+    GLfloat far = field.heightAt(x0, z0 + 1) * (1.0f - fx) + field.heightAt(x0 + 1, z0 + 1) * fx;
+    
+    return near * (1.0f - fz) + far * fz;
+}
+
+/**
+ * Camera of a test view, the clip matrix is built from the same frustum the rays are cast through
+ */
+class View {
+public:
+    
+    View(const glm::vec3& eye, const glm::vec3& target) : m_Eye(eye) {
+        
+        m_Forward = glm::normalize(target - eye);
+        m_Right = glm::normalize(glm::cross(m_Forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+        m_Up = glm::cross(m_Right, m_Forward);
+        
+        m_Top = NEAR * 0.4f;
+        m_Side = m_Top * (GLfloat) OcclusionCuller::WIDTH / (GLfloat) OcclusionCuller::HEIGHT;
+        
+        m_Clip = glm::frustum(-m_Side, m_Side, -m_Top, m_Top, NEAR, FAR) * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    
+    /**
+     * Returns the direction through a pixel center, scaled to reach the near plane
+     */
+    glm::vec3 ray(GLuint x, GLuint y) const {
+        
+        GLfloat u = ((x + 0.5f) / OcclusionCuller::WIDTH) * 2.0f - 1.0f;
+        GLfloat v = ((y + 0.5f) / OcclusionCuller::HEIGHT) * 2.0f - 1.0f;
+        
+        return m_Forward * NEAR + m_Right * (u * m_Side) + m_Up * (v * m_Top);
+    }
+    
+    /**
+     * Returns the view distance of an NDC depth
+     */
+    static GLfloat distance(GLfloat depth){
+        return 2.0f * FAR * NEAR / ((FAR + NEAR) - depth * (FAR - NEAR));
+    }
+    
+    glm::vec3 m_Eye;
+    glm::vec3 m_Forward;
+    glm::vec3 m_Right;
+    glm::vec3 m_Up;
+    GLfloat m_Side; ///< half width of the near plane
+    GLfloat m_Top; ///< half height of the near plane
+    glm::mat4 m_Clip;
+};
+
+/**
+ * Casts a ray through every pixel against every occluder triangle and keeps the nearest hit
+ * beyond the near plane, one pixel and one triangle at a time
+ */
+static std::vector<GLfloat> castDepth(const OcclusionCuller& culler, const View& view){
+    
+    const std::vector<glm::vec3>& vertices = culler.getOccluderVertices();
+    const std::vector<GLuint>& indices = culler.getOccluderIndices();
+    
+    std::vector<GLfloat> depth(OcclusionCuller::WIDTH * OcclusionCuller::HEIGHT, 1.0f);
+    
+    for(GLuint y = 0; y < OcclusionCuller::HEIGHT; y++){
+        for(GLuint x = 0; x < OcclusionCuller::WIDTH; x++){
+            
+            glm::vec3 direction = view.ray(x, y);
+            GLfloat nearest = std::numeric_limits<GLfloat>::max();
+            
+            for(GLuint i = 0; i < indices.size(); i += 3){
+                
+                glm::vec3 a = vertices[indices[i]];
+                glm::vec3 ab = vertices[indices[i + 1]] - a, ac = vertices[indices[i + 2]] - a;
+                
+                glm::vec3 p = glm::cross(direction, ac);
+                GLfloat determinant = glm::dot(ab, p);
+                
+                if(std::fabs(determinant) < 1e-12f)
+                    continue;
+                
+                glm::vec3 s = view.m_Eye - a;
+                GLfloat u = glm::dot(s, p) / determinant;
+                glm::vec3 q = glm::cross(s, ab);
+                GLfloat v = glm::dot(direction, q) / determinant;
+                GLfloat t = glm::dot(ac, q) / determinant;
+                
+                // t is 1 on the near plane
+                if(u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 1.0f)
+                    nearest = std::min(nearest, t);
+            }
+            
+            if(nearest < std::numeric_limits<GLfloat>::max()){
+                glm::vec4 hit = view.m_Clip * glm::vec4(view.m_Eye + direction * nearest, 1.0f);
+                depth[y * OcclusionCuller::WIDTH + x] = std::min(1.0f, hit.z / hit.w);
+            }
+        }
+    }
+    
+    return depth;
+}
+
+static bool sameDistance(GLfloat a, GLfloat b){
+    
+    if(a >= 1.0f || b >= 1.0f)
+        return a >= 1.0f && b >= 1.0f;
+    
+    GLfloat da = View::distance(a), db = View::distance(b);
+    return std::fabs(da - db) <= DISTANCE_TOLERANCE * std::max(da, db);
+}
+
+/**
+ * Compares the depth buffer with the ray cast. A pixel on a triangle edge may take the depth
+ * of the neighbouring triangle, so each pixel must match the reference at itself or next to it
+ */
+static void checkDepth(const OcclusionCuller& culler, const View& view, GLuint index){
+    
+    std::vector<GLfloat> reference = castDepth(culler, view);
+    
+    GLuint edgePixels = 0;
+    GLuint wrongPixels = 0;
+    
+    for(GLint y = 0; y < (GLint) OcclusionCuller::HEIGHT; y++){
+        for(GLint x = 0; x < (GLint) OcclusionCuller::WIDTH; x++){
+            
+            GLfloat depth = culler.getDepth(x, y);
+            
+            if(sameDistance(depth, reference[y * OcclusionCuller::WIDTH + x]))
+                continue;
+            
+            edgePixels++;
+            bool neighbour = false;
+            
+            for(GLint ny = std::max(0, y - 1); ny <= std::min((GLint) OcclusionCuller::HEIGHT - 1, y + 1); ny++){
+                for(GLint nx = std::max(0, x - 1); nx <= std::min((GLint) OcclusionCuller::WIDTH - 1, x + 1); nx++){
+                    neighbour = neighbour || sameDistance(depth, reference[ny * OcclusionCuller::WIDTH + nx]);
+                }
+            }
+            
+            wrongPixels += neighbour ? 0 : 1;
+        }
+    }
+    
+    check(wrongPixels == 0, "depth matches no pixel of the ray cast next to it", index);
+    check(edgePixels <= MAX_EDGE_PIXELS * OcclusionCuller::WIDTH * OcclusionCuller::HEIGHT, "too many pixels differ from the ray cast", index);
+}
+
+/**
+ * isVisible without the tiles, every pixel of the expanded rectangle is compared
+ */
+static bool scanVisible(const OcclusionCuller& culler, const glm::vec3& min, const glm::vec3& max){
+    
+    GLfloat minX = std::numeric_limits<GLfloat>::max(), minY = minX, nearest = minX;
+    GLfloat maxX = -minX, maxY = -minX;
+    
+    for(GLuint i = 0; i < 8; i++){
+        
+        glm::vec4 corner = culler.getClip() * glm::vec4(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.0f);
+        
+        if(corner.z < -corner.w || corner.w <= 0.0f)
+            return true;
+        
+        GLfloat invW = 1.0f / corner.w;
+        minX = std::min(minX, (corner.x * invW * 0.5f + 0.5f) * OcclusionCuller::WIDTH);
+        maxX = std::max(maxX, (corner.x * invW * 0.5f + 0.5f) * OcclusionCuller::WIDTH);
+        minY = std::min(minY, (corner.y * invW * 0.5f + 0.5f) * OcclusionCuller::HEIGHT);
+        maxY = std::max(maxY, (corner.y * invW * 0.5f + 0.5f) * OcclusionCuller::HEIGHT);
+        nearest = std::min(nearest, corner.z * invW);
+    }
+    
+    GLint x0 = std::max(0, (GLint) std::floor(minX) - 1);
+    GLint x1 = std::min((GLint) OcclusionCuller::WIDTH - 1, (GLint) std::ceil(maxX));
+    GLint y0 = std::max(0, (GLint) std::floor(minY) - 1);
+    GLint y1 = std::min((GLint) OcclusionCuller::HEIGHT - 1, (GLint) std::ceil(maxY));
+    
+    if(x0 > x1 || y0 > y1 || nearest > 1.0f)
+        return true;
+    
+    for(GLint y = y0; y <= y1; y++){
+        for(GLint x = x0; x <= x1; x++){
+            if(nearest <= culler.getDepth(x, y))
+                return true;
+        }
+    }
+    
+    return false;
+}
+
+/**
+ * Returns true if the height field hides a point, some sample between the eye and the point
+ * is under the surface
+ */
+static bool marchHidden(const HeightField& field, const glm::vec3& eye, const glm::vec3& point){
+    
+    for(GLuint i = 1; i <= MARCH_STEPS; i++){
+        
+        glm::vec3 sample = eye + (point - eye) * ((GLfloat) i / MARCH_STEPS);
+        
+        if(sample.y < surfaceHeight(field, sample.x, sample.z))
+            return true;
+    }
+    
+    return false;
+}
+
+/**
+ * Tests random boxes near the ground. The tiled test must agree with the pixel scan, and the
+ * corners and center of a hidden box must be behind the real terrain wherever they are on screen
+ */
+static GLuint checkBoxes(const OcclusionCuller& culler, const HeightField& field, const View& view, GLuint index, std::mt19937& random){
+    
+    std::uniform_real_distribution<GLfloat> offset(-120.0f, 120.0f);
+    std::uniform_real_distribution<GLfloat> unit(0.0f, 1.0f);
+    
+    GLuint hidden = 0;
+    
+    for(GLuint b = 0; b < BOXES_PER_VIEW; b++){
+        
+        glm::vec3 center(view.m_Eye.x + offset(random), 0.0f, view.m_Eye.z + offset(random));
+        center.y = surfaceHeight(field, center.x, center.z) + 1.0f + 3.0f * unit(random);
+        glm::vec3 extent(0.5f + 2.0f * unit(random));
+        
+        glm::vec3 min = center - extent, max = center + extent;
+        bool visible = culler.isVisible(min, max);
+        
+        check(visible == scanVisible(culler, min, max), "isVisible differs from the pixel scan", index);
+        
+        if(visible)
+            continue;
+        
+        hidden++;
+        
+        for(GLuint i = 0; i < 9; i++){
+            
+            glm::vec3 point = i < 8 ? glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z) : center;
+            glm::vec4 clip = view.m_Clip * glm::vec4(point, 1.0f);
+            
+            // points off the screen can be seen by no one
+            if(clip.x < -clip.w || clip.x > clip.w || clip.y < -clip.w || clip.y > clip.w || clip.z > clip.w)
+                continue;
+            
+            check(marchHidden(field, view.m_Eye, point), "a hidden box has a point the height field does not hide", index);
+        }
+    }
+    
+    return hidden;
+}
+
+int main(){
+    
+    HeightField field = createField();
+    
+    // one band on the calling thread and the largest number of bands
+    OcclusionCuller single(0);
+    OcclusionCuller banded(OcclusionCuller::MAX_WORKERS);
+    single.setOccluders(field);
+    banded.setOccluders(field);
+    
+    std::mt19937 random(17);
+    std::uniform_real_distribution<GLfloat> position(-60.0f, 60.0f);
+    std::uniform_real_distribution<GLfloat> unit(-1.0f, 1.0f);
+    
+    GLuint hidden = 0;
+    
+    for(GLuint v = 0; v < VIEWS; v++){
+        
+        glm::vec3 eye(position(random), 0.0f, position(random));
+        eye.y = surfaceHeight(field, eye.x, eye.z) + 2.0f + 10.0f * (unit(random) + 1.0f);
+        
+        View view(eye, eye + glm::vec3(unit(random), 0.2f * unit(random), unit(random)));
+        
+        single.render(view.m_Clip);
+        banded.render(view.m_Clip);
+        
+        bool sameDepth = true;
+        
+        for(GLuint y = 0; y < OcclusionCuller::HEIGHT; y++){
+            for(GLuint x = 0; x < OcclusionCuller::WIDTH; x++){
+                sameDepth = sameDepth && single.getDepth(x, y) == banded.getDepth(x, y);
+            }
+        }
+        
+        check(sameDepth, "bands change the depth buffer", v);
+        
+        checkDepth(single, view, v);
+        checkDepth(banded, view, v);
+        
+        std::mt19937 boxes(v);
+        hidden += checkBoxes(single, field, view, v, boxes);
+        
+        boxes.seed(v);
+        checkBoxes(banded, field, view, v, boxes);
+    }
+    
+    std::printf("%u views, %u of %u boxes hidden, %u failures\n", VIEWS, hidden, VIEWS * BOXES_PER_VIEW, failures);
+    
+    // a test that hides nothing proves nothing
+    if(hidden == 0){
+        std::printf("FAILED: no box was hidden\n");
+        failures++;
+    }
+    
+    return failures == 0 ? 0 : 1;
+}